@@ -0,0 +1,241 @@
+//		./Isolines.cpp
+//
+//		This program is free software; you can redistribute it and/or modify
+//		it under the terms of the GNU General Public License as published by
+//		the Free Software Foundation; either version 2 of the License, or
+//		(at your option) any later version.
+//
+//		This program is distributed in the hope that it will be useful,
+//		but WITHOUT ANY WARRANTY; without even the implied warranty of
+//		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//		GNU General Public License for more details.
+//
+//		You should have received a copy of the GNU General Public License
+//		along with this program; if not, write to the Free Software
+//		Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//		MA 02110-1301, USA.
+
+#include <algorithm>
+#include "Isolines.hpp"
+#include "mymesh.hpp"
+
+namespace mylibs {
+
+IsolineStitcher::IsolineStitcher() : used(0) {
+	clear();
+}
+
+/** name: IsolineStitcher::clear
+ * Removes all segments.
+ */
+void IsolineStitcher::clear(){
+	Entry empty = {npos, {npos, npos}};
+	table.assign(64, empty);
+	used = 0;
+	keys.clear();
+	xyz.clear();
+}
+
+/** name: IsolineStitcher::reserve
+ * Allocates enough memory for nr_segments, so that no rehashing is needed.
+ */
+void IsolineStitcher::reserve(size_t nr_segments){
+	keys.reserve(2 * nr_segments);
+	xyz.reserve(6 * nr_segments);
+	size_t sz = table.size();
+	while (sz < 4 * nr_segments) sz *= 2;
+	if (sz > table.size()) rehash(sz);
+}
+
+size_t IsolineStitcher::hash(size_t key){
+	unsigned long long h = (unsigned long long) key * 0x9E3779B97F4A7C15ULL;
+	h ^= h >> 29;
+	return (size_t) h;
+}
+
+/** name: IsolineStitcher::slot
+ * Linear probing: returns the slot of the key or the empty slot where it
+ * would have to be inserted.
+ */
+size_t IsolineStitcher::slot(size_t key) const {
+	const size_t mask = table.size() - 1;
+	size_t s = hash(key) & mask;
+	while (table[s].key != npos and table[s].key != key) s = (s + 1) & mask;
+	return s;
+}
+
+void IsolineStitcher::rehash(size_t new_size){
+	vector<Entry> old;
+	old.swap(table);
+	Entry empty = {npos, {npos, npos}};
+	table.assign(new_size, empty);
+	for (size_t s = 0; s < old.size(); s++)
+		if (old[s].key != npos) table[slot(old[s].key)] = old[s];
+}
+
+void IsolineStitcher::insert(size_t key, size_t segment){
+	if (2 * (used + 1) > table.size()) rehash(2 * table.size());
+	Entry &e = table[slot(key)];
+	if (e.key == npos){
+		e.key = key;
+		used++;
+	}
+	// a third segment on one edge (non-manifold mesh) starts a new curve
+	if      (e.seg[0] == npos) e.seg[0] = segment;
+	else if (e.seg[1] == npos) e.seg[1] = segment;
+}
+
+/** name: IsolineStitcher::add
+ * Adds the segment from a (on edge key_a) to b (on edge key_b).
+ * \param a, b : coordinates x, y, z
+ */
+void IsolineStitcher::add(size_t key_a, const double *a, size_t key_b, const double *b){
+	if (key_a == key_b) return;
+	const size_t s = segments();
+	keys.push_back(key_a);
+	keys.push_back(key_b);
+	xyz.insert(xyz.end(), a, a + 3);
+	xyz.insert(xyz.end(), b, b + 3);
+	insert(key_a, s);
+	insert(key_b, s);
+}
+
+void IsolineStitcher::add(size_t key_a, const Point &a, size_t key_b, const Point &b){
+	const double pa[3] = {a.x, a.y, a.z}, pb[3] = {b.x, b.y, b.z};
+	add(key_a, pa, key_b, pb);
+}
+
+/** name: IsolineStitcher::add_polygon
+ * Adds the segments of a convex cell (triangle or square). Values above the
+ * level are on the left of the segments, seen from the normal of the
+ * counter-clockwise corners. For four crossings (saddle) the segments cut off
+ * the corners below the level if centre_above, otherwise those above.
+ *
+ * \param n            : number of corners (3 or 4)
+ * \param values       : value at each corner
+ * \param corners      : coordinates of the corners, x, y, z for each
+ * \param edge_keys    : key of edge k, which connects corner k and k+1
+ * \param level        : the iso value
+ * \param centre_above : the value in the centre of the cell is above the level
+ */
+void IsolineStitcher::add_polygon(size_t n, const double *values, const double *corners,
+								  const size_t *edge_keys, double level, bool centre_above){
+	size_t edge[4];
+	bool   leaving[4];
+	double p[4][3];
+	size_t m = 0;
+	for (size_t k = 0; k < n and m < 4; k++){
+		const size_t k1 = (k + 1) % n;
+		const bool a = values[k] > level, b = values[k1] > level;
+		if (a == b) continue;
+		const double f = (level - values[k]) / (values[k1] - values[k]);
+		edge[m]    = k;
+		leaving[m] = a;
+		for (int d = 0; d < 3; d++) p[m][d] = corners[3 * k + d] + (corners[3 * k1 + d] - corners[3 * k + d]) * f;
+		m++;
+	}
+	if (m < 2) return;
+	// the region above the level is on the left of its counter-clockwise
+	// border, so the isoline runs from a leaving to an entering crossing
+	for (size_t q = 0; q < m; q++){
+		if (not leaving[q]) continue;
+		const size_t e = (m == 2 or centre_above) ? (q + 1) % m : (q + m - 1) % m;
+		add(edge_keys[edge[q]], p[q], edge_keys[edge[e]], p[e]);
+	}
+}
+
+/** name: IsolineStitcher::stitch
+ * Joins the segments to curves, open curves first (they start at an edge used
+ * by only one segment), then the closed ones. The curves follow the
+ * orientation of their first segment.
+ * \param curves : the curves are appended
+ * \return the number of curves appended
+ */
+size_t IsolineStitcher::stitch(vector<PointCurve> &curves){
+	const size_t nr = segments();
+	vector<char> done(nr, 0);
+	const size_t before = curves.size();
+
+	for (int pass = 0; pass < 2; pass++)
+	for (size_t s0 = 0; s0 < nr; s0++){
+		if (done[s0]) continue;
+		// start at a free end in the first pass, anywhere in the second one
+		int enter = -1;
+		for (int end = 0; end < 2 and enter < 0; end++){
+			const Entry &e = table[slot(keys[2 * s0 + end])];
+			if (pass == 1 or e.seg[1] == npos or e.seg[0] == npos) enter = end;
+		}
+		if (enter < 0) continue;
+
+		curves.push_back(PointCurve());
+		PointCurve &c = curves.back();
+		const bool reverse = (enter == 1);
+		size_t s = s0;
+		c.push_back(point(2 * s + enter));
+		while (true){
+			done[s] = 1;
+			const int leave = 1 - enter;
+			c.push_back(point(2 * s + leave));
+			const size_t key = keys[2 * s + leave];
+			const Entry &e = table[slot(key)];
+			const size_t next = (e.seg[0] == s) ? e.seg[1] : e.seg[0];
+			if (next == npos or done[next]) break;
+			enter = (keys[2 * next] == key) ? 0 : 1;
+			s = next;
+		}
+		if (reverse) c.reverse();
+	}
+	return curves.size() - before;
+}
+
+/** name: isolines
+ * Marching triangles on a surface mesh with one value per node. Only faces
+ * with three nodes are used. A curve ends at the border of the mesh.
+ * \param mesh   : the mesh
+ * \param values : one value per node
+ * \param level  : the iso value
+ * \param curves : the curves are appended
+ * \return the number of curves appended
+ */
+size_t isolines(SurfaceMesh &mesh, const double *values, double level, vector<PointCurve> &curves){
+	const size_t N = mesh.points();
+	IsolineStitcher stitcher;
+	for (size_t i = 0; i < mesh.elements(); i++){
+		const vector<int> &v = mesh.f[i].v;
+		if (v.size() != 3) continue;
+		const double val[3] = {values[v[0]], values[v[1]], values[v[2]]};
+		const bool a = val[0] > level;
+		if (a == (val[1] > level) and a == (val[2] > level)) continue;
+		double c[9];
+		for (int k = 0; k < 3; k++){
+			const Point &pt = mesh.p[v[k]];
+			c[3 * k] = pt.x;
+			c[3 * k + 1] = pt.y;
+			c[3 * k + 2] = pt.z;
+		}
+		size_t keys[3];
+		for (int k = 0; k < 3; k++){
+			const size_t n0 = v[k], n1 = v[(k + 1) % 3];
+			keys[k] = min(n0, n1) * N + max(n0, n1);
+		}
+		stitcher.add_polygon(3, val, c, keys, level, false);
+	}
+	return stitcher.stitch(curves);
+}
+
+/** name: isolines
+ * Marching triangles for several levels (e.g. isochrones of activation
+ * times), the levels are processed in parallel.
+ * \param curves : curves[i] receives the curves of levels[i]
+ * \return the total number of curves
+ */
+size_t isolines(SurfaceMesh &mesh, const double *values, const vector<double> &levels,
+				vector< vector<PointCurve> > &curves){
+	curves.assign(levels.size(), vector<PointCurve>());
+	long total = 0;
+	#pragma omp parallel for reduction(+:total) schedule(dynamic)
+	for (long l = 0; l < (long) levels.size(); l++) total += isolines(mesh, values, levels[l], curves[l]);
+	return total;
+}
+
+} // end of namespace mylibs
@@ -0,0 +1,153 @@
+//		./Isolines.hpp
+//
+//		This program is free software; you can redistribute it and/or modify
+//		it under the terms of the GNU General Public License as published by
+//		the Free Software Foundation; either version 2 of the License, or
+//		(at your option) any later version.
+//
+//		This program is distributed in the hope that it will be useful,
+//		but WITHOUT ANY WARRANTY; without even the implied warranty of
+//		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//		GNU General Public License for more details.
+//
+//		You should have received a copy of the GNU General Public License
+//		along with this program; if not, write to the Free Software
+//		Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//		MA 02110-1301, USA.
+
+#ifndef ISOLINES_HPP
+#define ISOLINES_HPP
+
+/** \page mylibs
+ * \section sec_Isolines Isolines
+ * \subsection files Files
+ * Isolines.hpp, Isolines.cpp
+ * \subsection description Description
+ * Isolines of scalar values as PointCurves: marching squares on a slice of a
+ * mymatrix and marching triangles on a SurfaceMesh with one value per node.
+ *
+ * Each cell (square or triangle) contributes line segments between points on
+ * its edges. The segments are joined by IsolineStitcher, which hashes the
+ * edges the points lie on, so joining costs O(1) per segment. Points are kept
+ * as plain coordinates until the curves are built. The curves are
+ * oriented: seen from the normal of a counter-clockwise cell (for slices: the
+ * z-axis), values above the level are on the left. Closed curves end with
+ * their first point (PointCurve::circular()).
+ *
+ \verbatim
+	vector<PointCurve> curves;
+	mylibs::isolines(mesh, activation_times, 100., curves);
+	vector<double> levels;				// e.g. every 2 ms
+	vector< vector<PointCurve> > isochrones;
+	mylibs::isolines(mesh, activation_times, levels, isochrones);
+ \endverbatim
+ */
+
+#include <vector>
+#include <cstddef>
+#include "point.hpp"
+#include "myline.hpp"
+#include "mymatrix.hpp"
+
+class SurfaceMesh;
+
+namespace mylibs {
+
+/** \class IsolineStitcher
+ * Joins isoline segments to polylines. Every segment end is identified by a
+ * key of the edge it lies on (any unique number per edge), segments sharing a
+ * key are neighbours on a curve.
+ */
+class IsolineStitcher {
+	public:
+		static const size_t npos = (size_t) -1;
+
+		IsolineStitcher();
+
+		void clear();
+		void reserve(size_t nr_segments);
+		size_t segments() const {return keys.size() / 2;}	//!< number of segments added
+
+		void add(size_t key_a, const double *a, size_t key_b, const double *b);
+		void add(size_t key_a, const Point &a, size_t key_b, const Point &b);
+		void add_polygon(size_t n, const double *values, const double *corners,
+						 const size_t *edge_keys, double level, bool centre_above);
+		size_t stitch(vector<PointCurve> &curves);
+
+	private:
+		struct Entry {
+			size_t key;
+			size_t seg[2];		//!< the (up to) two segments ending on the edge
+		};
+
+		vector<Entry>  table;	//!< open addressing hash table of the edges
+		size_t         used;	//!< occupied slots
+		vector<size_t> keys;	//!< two edge keys per segment
+		vector<double> xyz;		//!< coordinates of the two points per segment
+
+		static size_t hash(size_t key);
+		size_t slot(size_t key) const;
+		void rehash(size_t new_size);
+		void insert(size_t key, size_t segment);
+		Point point(size_t end) const {return Point(xyz[3 * end], xyz[3 * end + 1], xyz[3 * end + 2]);}
+};
+
+size_t isolines(SurfaceMesh &mesh, const double *values, double level, vector<PointCurve> &curves);
+size_t isolines(SurfaceMesh &mesh, const double *values, const vector<double> &levels,
+				vector< vector<PointCurve> > &curves);
+
+/** name: isolines
+ * Marching squares on slice (z, t) of a matrix. The corners of the squares
+ * are the voxel coordinates (my_regular_grid::coords()), a saddle is
+ * resolved with the mean of the four corners.
+ * \param m      : the matrix
+ * \param z, t   : the slice
+ * \param level  : the iso value
+ * \param curves : the curves are appended
+ * \return the number of curves appended
+ */
+template <class Type>
+size_t isolines(mymatrix<Type> &m, size_t z, size_t t, double level, vector<PointCurve> &curves){
+	if (z >= m.dims(2) or t >= m.dims(3)) throw mymatrix_exception(INVALID_SLICE_FAILURE);
+	const size_t nx = m.dims(0), ny = m.dims(1);
+	const Type *data = m.data() + m.index(0, 0, z, t);
+	const Point o  = m.coords(0, 0, z, t);
+	const double hx = m.pixdim(0), hy = m.pixdim(1);
+
+	IsolineStitcher stitcher;
+	for (size_t j = 0; j + 1 < ny; j++){
+		const Type *r0 = data + j * nx, *r1 = r0 + nx;
+		const double y0 = o.y + j * hy, y1 = y0 + hy;
+		for (size_t i = 0; i + 1 < nx; i++){
+			// corners counter-clockwise, edge k connects corner k and k+1
+			const double v[4] = {(double) r0[i], (double) r0[i+1], (double) r1[i+1], (double) r1[i]};
+			const bool a = v[0] > level;
+			if (a == (v[1] > level) and a == (v[2] > level) and a == (v[3] > level)) continue;
+			const size_t n00 = j * nx + i, n10 = n00 + 1, n01 = n00 + nx;
+			const size_t keys[4] = {2 * n00, 2 * n10 + 1, 2 * n01, 2 * n00 + 1};
+			const double x0 = o.x + i * hx, x1 = x0 + hx;
+			const double c[12] = {x0, y0, o.z,  x1, y0, o.z,  x1, y1, o.z,  x0, y1, o.z};
+			stitcher.add_polygon(4, v, c, keys, level, 0.25 * (v[0] + v[1] + v[2] + v[3]) > level);
+		}
+	}
+	return stitcher.stitch(curves);
+}
+
+/** name: isolines
+ * Marching squares for several levels, the levels are processed in parallel.
+ * \param curves : curves[i] receives the curves of levels[i]
+ * \return the total number of curves
+ */
+template <class Type>
+size_t isolines(mymatrix<Type> &m, size_t z, size_t t, const vector<double> &levels,
+				vector< vector<PointCurve> > &curves){
+	curves.assign(levels.size(), vector<PointCurve>());
+	long total = 0;
+	#pragma omp parallel for reduction(+:total) schedule(dynamic)
+	for (long l = 0; l < (long) levels.size(); l++) total += isolines(m, z, t, levels[l], curves[l]);
+	return total;
+}
+
+} // end of namespace mylibs
+
+#endif /* ISOLINES_HPP */
@@ -37,193 +37,541 @@ Grid::Grid()
 	TriangleList.clear();
 	pixdim(Point(1., 1., 1.));
 	origin(0., 0., 0.);
-	CubeList =NULL;
-	Cubes_Set = true;
 }
 
 /** \fn Grid::Grid(const Point, size_t const, size_t const, size_t const)
  *	\brief Constructor which takes some arguments to initialize the grid.
+ *
+ *	No cubes are stored: corner coordinates are computed from origin and
+ *	pixdim while the algorithm runs, so the grid itself needs no memory
+ *	proportional to the number of voxels.
  */
 Grid::Grid(const Point pixel_dims, size_t const max_x, size_t const max_y, size_t const max_z)
 	:	 my_regular_grid(max_x, max_y, max_z), Iso_Value(0.) {
 	TriangleList.clear();
 	pixdim(pixel_dims);
 	origin(0., 0., 0.);
-	size_t const k = this->dimensions[0] - 1;
-	size_t const l = this->dimensions[1] - 1;
-	size_t const m = this->dimensions[2] - 1;
-	size_t const length = k * l * m;
-
-	CubeList = new Cube[length];
-	Cubes_Set = true;
-	ConstructCubeList();
 }
 
 /** \fn Grid::~Grid()
- *	Destructor, frees the memory the constructor has reserved.
+ *	Destructor.
  */
 Grid::~Grid() {
-	if(Cubes_Set) {
-		delete[] this->CubeList;
-		this->CubeList = NULL;
-	}
 }
 
-void Grid::ConstructCubeList() {
-	size_t x, y, z, i = 0;
-
-	for(z=0; z < this->dimensions[2] - 1; z++)
-		for(y=0; y < this->dimensions[1] - 1; y++)
-			for(x=0; x < this->dimensions[0] - 1; x++) {
-				//! for every quad in the grid
-				Cube &cube = CubeList[i];
-				// First setting the coordinates
-				Point pnt[8];
-				size_t idx[8];
-
-				pnt[0] = this->coords(x  ,y  ,z  );
-				pnt[1] = this->coords(x+1,y  ,z  );
-				pnt[2] = this->coords(x+1,y+1,z  );
-				pnt[3] = this->coords(x  ,y+1,z  );
-				pnt[4] = this->coords(x  ,y  ,z+1);
-				pnt[5] = this->coords(x+1,y  ,z+1);
-				pnt[6] = this->coords(x+1,y+1,z+1);
-				pnt[7] = this->coords(x  ,y+1,z+1);
-
-				idx[0] = this->ijk_index(x  ,y  ,z  );
-				idx[1] = this->ijk_index(x+1,y  ,z  );
-				idx[2] = this->ijk_index(x+1,y+1,z  );
-				idx[3] = this->ijk_index(x  ,y+1,z  );
-				idx[4] = this->ijk_index(x  ,y  ,z+1);
-				idx[5] = this->ijk_index(x+1,y  ,z+1);
-				idx[6] = this->ijk_index(x+1,y+1,z+1);
-				idx[7] = this->ijk_index(x  ,y+1,z+1);
-
-				cube.SetVertices(pnt[0], pnt[1], pnt[2], pnt[3], pnt[4], pnt[5], pnt[6], pnt[7]);
-
-				// Now setting the cube indices that is the ijk-indices, which will make later value-settings easier from 1D-data-arrays
-				cube.SetCubeIndices(idx[0], idx[1], idx[2], idx[3], idx[4], idx[5], idx[6], idx[7]);
-				//CubeList.push_back(cube);
-				i++;
-			}
+/// corner offsets (x,y,z) of the eight vertices of a cube
+static const int corner_offset[8][3] = {
+	{0,0,0}, {1,0,0}, {1,1,0}, {0,1,0},
+	{0,0,1}, {1,0,1}, {1,1,1}, {0,1,1}
+};
+
+/// the two vertices of each of the twelve edges of a cube (see edgeTable)
+static const int edge_vertices[12][2] = {
+	{0,1}, {1,2}, {2,3}, {3,0},
+	{4,5}, {5,6}, {6,7}, {7,4},
+	{0,4}, {1,5}, {2,6}, {3,7}
+};
+
+/** \struct SlabRows
+ * The cubes of one chunk of slabs that have to be visited: the rows of cubes
+ * are grouped into rows of bricks (\a brick rows of cubes each) and for every
+ * row of bricks the ranges [x0,x1) of cubes within active bricks are listed.
+ * Without MinMaxBlocks there is one range over the whole grid.
+ */
+struct SlabRows {
+	size_t brick;
+	vector< vector< pair<size_t,size_t> > > ranges;
+};
+
+/** \fn static bool active_rows(const MinMaxBlocks *, size_t, size_t, long, double, SlabRows &)
+ * Determines the cubes to visit in the z-slabs of brick layer bz.
+ * \return false, if no cube can be cut by the isosurface
+ */
+static bool active_rows(const MinMaxBlocks *blocks, size_t nx, size_t ny, long bz, double iso, SlabRows &rows) {
+	rows.ranges.clear();
+	if (not blocks) {
+		rows.brick = ny - 1;
+		rows.ranges.assign(1, vector< pair<size_t,size_t> >(1, make_pair((size_t) 0, nx - 1)));
+		return true;
+	}
+
+	bool any = false;
+	rows.brick = blocks->BlockSize();
+	rows.ranges.resize(blocks->Bricks(1));
+	for (size_t by = 0; by < blocks->Bricks(1); by++)
+		for (size_t bx = 0; bx < blocks->Bricks(0); bx++) {
+			if (not blocks->Active(bx, by, bz, iso)) continue;
+			const size_t x0 = bx * rows.brick, x1 = min(x0 + rows.brick, nx - 1);
+			vector< pair<size_t,size_t> > &r = rows.ranges[by];
+			if (not r.empty() and r.back().second == x0) r.back().second = x1; // merge neighbours
+			else r.push_back(make_pair(x0, x1));
+			any = true;
+		}
+	return any;
 }
 
-/** \fn void Grid::SetCubeValues(Cube &, const double * const)
- * \brief Sets the vertex values of a cube.
- *
- *	Sets the values at the edges of the cube.
- *
- * \param cube: Reference to the Cube for whom to set the vertex values.
- * \param data: Pointer to a double array where the data can be found, that
- *				should be used to set the values.
+/** \fn static void classify(const Type *, size_t, size_t, const SlabRows &, double, vector<unsigned char> &)
+ * Marks the grid points of one slice which are below the iso value. Only the
+ * points of the cubes listed in \a rows are classified.
  */
-void Grid::SetCubeValues(Cube &cube, const double * const data) {
-	size_t k;
-
-	for(k = 0; k < 8; k++) {
-		cube.SetVertexValue(k, data);
+template <typename Type>
+static void classify(const Type *values, size_t nx, size_t ny, const SlabRows &rows, double iso, vector<unsigned char> &below) {
+	for (size_t by = 0; by < rows.ranges.size(); by++) {
+		const vector< pair<size_t,size_t> > &r = rows.ranges[by];
+		if (r.empty()) continue;
+		const size_t y1 = min((by + 1) * rows.brick, ny - 1);
+		for (size_t y = by * rows.brick; y <= y1; y++)
+			for (size_t k = 0; k < r.size(); k++)
+				for (size_t i = r[k].first + y * nx; i <= r[k].second + y * nx; i++)
+					below[i] = (values[i] < iso);
 	}
 }
 
-/** \fn void Grid::RunAlgorithm(const double * const, const double)
+/** \fn void Grid::RunAlgorithm(const Type * const, const double, const MinMaxBlocks *)
  * \brief Compute the isosurface.
  *
  *	This method will compute the isosurface within the given data. The
  *	trigangles are at the end in \a TriangleList.
  *
- * \param data: Pointer to doubles, which contain the values. It is assumed that
- *				within the given 1d-array are the three dimensional data.
+ *	The grid is processed in parallel, in chunks of consecutive z-slabs of
+ *	cubes. Every slab collects its triangles in an own buffer and the buffers
+ *	are concatenated in the order of the slabs afterwards. So the order of the
+ *	triangles does not depend on the number of threads.
+ *
+ * \param data: Pointer to the values (see MCUBES_INSTANTIATE for the supported
+ * 				types). It is assumed that within the given 1d-array are the
+ * 				three dimensional data.
  * \param iso: The value that should be used for the isosurface.
+ * \param blocks: optional min/max bricks of \a data (see MinMaxBlocks), only
+ * 				cubes within active bricks are visited
  */
-void Grid::RunAlgorithm(const double * const data, const double iso) {
+template <typename Type>
+void Grid::RunAlgorithm(const Type * const data, const double iso, const MinMaxBlocks *blocks) {
 	Iso_Value = iso;
 	TriangleList.clear();
 
-	size_t length = (dimensions[0] - 1) * (dimensions[1] - 1) * (dimensions[2] - 1);
-	size_t i = 0;
+	if (dimensions[0] < 2 or dimensions[1] < 2 or dimensions[2] < 2) return;
+	CheckBlocks(blocks);
 
+	const long nr_slabs  = (long) dimensions[2] - 1;
+	const long chunk     = ChunkSize(blocks); // slabs per task, each task classifies one extra slice
+	const long nr_chunks = (nr_slabs + chunk - 1) / chunk;
+	vector<TriangleArray> slabs(nr_slabs);
+	long c = 0;
 
 #ifdef _OPENMP /** Compute in parallelized manner*/
-	#pragma omp parallel for private(i)
+	#pragma omp parallel for private(c) schedule(dynamic)
 #endif
-	for (i = 0; i < length; i++) {
-		Cube &cube = CubeList[i];
-		SetCubeValues(cube, data);
+	for (c = 0; c < nr_chunks; c++) {
+		const long z0 = c * chunk;
+		const long z1 = (z0 + chunk < nr_slabs) ? z0 + chunk : nr_slabs;
+		PolygoniseSlabs(data, z0, z1, &slabs[z0], blocks);
 	}
 
-	//#ifdef _OPENMP /** Compute in parallelized manner*/
-	//#pragma omp parallel for private(i)
-	//#endif
-	for (i = 0; i < length; i++) {
-		Cube &cube = CubeList[i];
-		Polygonise(cube);
+	size_t nr_triangles = 0;
+	for (long z = 0; z < nr_slabs; z++) nr_triangles += slabs[z].size();
+
+	TriangleList.reserve(nr_triangles);
+	for (long z = 0; z < nr_slabs; z++) {
+		TriangleList.insert(TriangleList.end(), slabs[z].begin(), slabs[z].end());
+		TriangleArray().swap(slabs[z]); // free the memory early
 	}
 }
 
-/** \fn void Grid::Polygonise(Cube &)
- * \brief Get the triangle for a cube.
+/** \fn void Grid::RunAlgorithm(const Type * const, const double, TriangleWriter &, const MinMaxBlocks *)
+ * \brief Compute the isosurface and write it to a file.
  *
- * \param cube: The cube for which to determine the triangle at which the
- *				surface intersects.
+ *	Same as above, but the triangles are passed to \a out instead of being
+ *	collected in \a TriangleList. The chunks are processed in waves of a few
+ *	chunks per thread, the triangles of a wave are written (in the order of the
+ *	slabs) before the next wave is started. So only a small part of the
+ *	isosurface is held in memory at any time.
+ *
+ * \param data: Pointer to the values.
+ * \param iso: The value that should be used for the isosurface.
+ * \param out: an open TriangleWriter, it is not closed afterwards
+ * \param blocks: optional min/max bricks of \a data
  */
-void Grid::Polygonise(Cube &cube) {
-	int cubeindex;
-	Point vertexList[12] = {Point()};
+template <typename Type>
+void Grid::RunAlgorithm(const Type * const data, const double iso, TriangleWriter &out, const MinMaxBlocks *blocks) {
+	Iso_Value = iso;
+	if (not out.IsOpen()) throw myexception("MCubes::Grid: The output file is not open.");
+
+	if (dimensions[0] < 2 or dimensions[1] < 2 or dimensions[2] < 2) return;
+	CheckBlocks(blocks);
+
+	const long nr_slabs  = (long) dimensions[2] - 1;
+	const long chunk     = ChunkSize(blocks);
+	const long nr_chunks = (nr_slabs + chunk - 1) / chunk;
+#ifdef _OPENMP
+	const long wave      = 4 * omp_get_max_threads(); // chunks per wave
+#else
+	const long wave      = 1;
+#endif
+	vector<TriangleArray> slabs(min(nr_slabs, wave * chunk));
+
+	for (long w = 0; w < nr_chunks; w += wave) {
+		const long c1 = min(w + wave, nr_chunks);
+		const long s0 = w * chunk; // first slab of the wave
+		long c = 0;
+#ifdef _OPENMP
+		#pragma omp parallel for private(c) schedule(dynamic)
+#endif
+		for (c = w; c < c1; c++) {
+			const long z0 = c * chunk;
+			const long z1 = (z0 + chunk < nr_slabs) ? z0 + chunk : nr_slabs;
+			PolygoniseSlabs(data, z0, z1, &slabs[z0 - s0], blocks);
+		}
 
-	/*
-	  Determine the index into the edge table which
-	  tells us which vertices are inside of the surface
-	*/
-	cubeindex = 0;
-	if (cube.GetVertexValue(0) < Iso_Value)		cubeindex |= 1;
-	if (cube.GetVertexValue(1) < Iso_Value)		cubeindex |= 2;
-	if (cube.GetVertexValue(2) < Iso_Value)		cubeindex |= 4;
-	if (cube.GetVertexValue(3) < Iso_Value)		cubeindex |= 8;
-	if (cube.GetVertexValue(4) < Iso_Value)		cubeindex |= 16;
-	if (cube.GetVertexValue(5) < Iso_Value)		cubeindex |= 32;
-	if (cube.GetVertexValue(6) < Iso_Value)		cubeindex |= 64;
-	if (cube.GetVertexValue(7) < Iso_Value)		cubeindex |= 128;
+		const long s1 = min(c1 * chunk, nr_slabs);
+		for (long z = s0; z < s1; z++) {
+			out.Write(slabs[z - s0]);
+			slabs[z - s0].clear();
+		}
+	}
+}
 
-	/* Cube is entirely in/out of the surface */
-	if (edgeTable[cubeindex] == 0)	return;
+/** \struct Grid::IndexedChunk
+ * Output of one chunk of slabs for the indexed variant of RunAlgorithm().
+ * The vertices on the bottom and top slice of the chunk are listed together
+ * with their key within the slice, so that the vertices shared with the
+ * neighbouring chunks can be identified when the chunks are merged.
+ */
+struct Grid::IndexedChunk {
+	vector<Point>  points;						//!< vertices created by this chunk
+	vector<size_t> faces;						//!< three local vertex indices per triangle
+	vector< pair<size_t,size_t> > bottom;	//!< (key, local index) of vertices on slice z0
+	vector< pair<size_t,size_t> > top;		//!< (key, local index) of vertices on slice z1
+};
+
+/** \fn void Grid::RunAlgorithm(const Type * const, const double, SurfaceMesh &, const MinMaxBlocks *)
+ * \brief Compute the isosurface as indexed mesh.
+ *
+ *	Instead of independent triangles a mesh with shared vertices is created
+ *	directly: every intersected edge of the grid gets exactly one vertex, which
+ *	is looked up by the id of the edge from caches that are kept for the two
+ *	slices of the current slab. Vertices that are snapped onto a grid point
+ *	(see VertexInterpolation()) are shared by the id of that grid point. No
+ *	welding of points is needed afterwards.
+ *
+ *	The chunks of slabs are computed in parallel and merged in order, so the
+ *	result does not depend on the number of threads. \a TriangleList is not
+ *	touched.
+ *
+ * \param data: the three dimensional data (x varies fastest)
+ * \param iso: The value that should be used for the isosurface.
+ * \param mesh: receives the points and faces, previous content is cleared
+ * \param blocks: optional min/max bricks of \a data (see MinMaxBlocks)
+ */
+template <typename Type>
+void Grid::RunAlgorithm(const Type * const data, const double iso, SurfaceMesh &mesh, const MinMaxBlocks *blocks) {
+	Iso_Value = iso;
+	mesh.clear();
 
-	/* Find the vertices where the surface intersects the cube */
-	if (edgeTable[cubeindex] &    1) vertexList[ 0] = VertexInterpolation(cube.GetVertex(0), cube.GetVertex(1), cube.GetVertexValue(0), cube.GetVertexValue(1));
+	if (dimensions[0] < 2 or dimensions[1] < 2 or dimensions[2] < 2) return;
+	CheckBlocks(blocks);
 
-	if (edgeTable[cubeindex] &    2) vertexList[ 1] = VertexInterpolation(cube.GetVertex(1), cube.GetVertex(2), cube.GetVertexValue(1), cube.GetVertexValue(2));
+	const long nr_slabs  = (long) dimensions[2] - 1;
+	const long chunk     = ChunkSize(blocks);
+	const long nr_chunks = (nr_slabs + chunk - 1) / chunk;
+	vector<IndexedChunk> chunks(nr_chunks);
+	long c = 0;
 
-	if (edgeTable[cubeindex] &    4) vertexList[ 2] = VertexInterpolation(cube.GetVertex(2), cube.GetVertex(3), cube.GetVertexValue(2), cube.GetVertexValue(3));
+#ifdef _OPENMP
+	#pragma omp parallel for private(c) schedule(dynamic)
+#endif
+	for (c = 0; c < nr_chunks; c++) {
+		const long z0 = c * chunk;
+		const long z1 = (z0 + chunk < nr_slabs) ? z0 + chunk : nr_slabs;
+		PolygoniseSlabs(data, z0, z1, chunks[c], blocks);
+	}
 
-	if (edgeTable[cubeindex] &    8) vertexList[ 3] = VertexInterpolation(cube.GetVertex(3), cube.GetVertex(0), cube.GetVertexValue(3), cube.GetVertexValue(0));
+	size_t nr_points = 0, nr_faces = 0;
+	for (c = 0; c < nr_chunks; c++) {
+		nr_points += chunks[c].points.size();
+		nr_faces  += chunks[c].faces.size() / 3;
+	}
+	mesh.p.reserve(nr_points);
+	mesh.f.reserve(nr_faces);
+
+	// global index of the vertices on the top slice of the previous chunk
+	const size_t npos = (size_t) -1;
+	vector<size_t> shared(3 * dimensions[0] * dimensions[1], npos);
+	for (c = 0; c < nr_chunks; c++) {
+		IndexedChunk &chunk_out = chunks[c];
+		vector<size_t> global(chunk_out.points.size(), npos);
+		for (size_t i = 0; i < chunk_out.bottom.size(); i++)
+			global[chunk_out.bottom[i].second] = shared[chunk_out.bottom[i].first];
+
+		for (size_t i = 0; i < global.size(); i++) {
+			if (global[i] != npos) continue;
+			global[i] = mesh.p.size();
+			mesh.p.push_back(chunk_out.points[i]);
+		}
 
-	if (edgeTable[cubeindex] &   16) vertexList[ 4] = VertexInterpolation(cube.GetVertex(4), cube.GetVertex(5), cube.GetVertexValue(4), cube.GetVertexValue(5));
+		for (size_t i = 0; i + 2 < chunk_out.faces.size(); i += 3)
+			mesh.f.push_back(Face(	global[chunk_out.faces[i  ]],
+									global[chunk_out.faces[i+1]],
+									global[chunk_out.faces[i+2]]));
 
-	if (edgeTable[cubeindex] &   32) vertexList[ 5] = VertexInterpolation(cube.GetVertex(5), cube.GetVertex(6), cube.GetVertexValue(5), cube.GetVertexValue(6));
+		if (c > 0) {
+			const IndexedChunk &prev = chunks[c-1];
+			for (size_t i = 0; i < prev.top.size(); i++) shared[prev.top[i].first] = npos;
+		}
+		for (size_t i = 0; i < chunk_out.top.size(); i++)
+			shared[chunk_out.top[i].first] = global[chunk_out.top[i].second];
 
-	if (edgeTable[cubeindex] &   64) vertexList[ 6] = VertexInterpolation(cube.GetVertex(6), cube.GetVertex(7), cube.GetVertexValue(6), cube.GetVertexValue(7));
+		vector<Point>().swap(chunk_out.points); // free the memory early
+		vector<size_t>().swap(chunk_out.faces);
+	}
+}
 
-	if (edgeTable[cubeindex] &  128) vertexList[ 7] = VertexInterpolation(cube.GetVertex(7), cube.GetVertex(4), cube.GetVertexValue(7), cube.GetVertexValue(4));
+/** \fn void Grid::CheckBlocks(const MinMaxBlocks *) const
+ * Throws if the given blocks were not built for a grid of this size.
+ */
+void Grid::CheckBlocks(const MinMaxBlocks *blocks) const {
+	if (blocks and not blocks->Matches(dimensions[0], dimensions[1], dimensions[2]))
+		throw myexception("MCubes::Grid: The MinMaxBlocks do not match the size of the grid.");
+}
 
-	if (edgeTable[cubeindex] &  256) vertexList[ 8] = VertexInterpolation(cube.GetVertex(0), cube.GetVertex(4), cube.GetVertexValue(0), cube.GetVertexValue(4));
+/** \fn long Grid::ChunkSize(const MinMaxBlocks *) const
+ * Number of slabs processed by one task. With MinMaxBlocks one task handles
+ * exactly one layer of bricks.
+ */
+long Grid::ChunkSize(const MinMaxBlocks *blocks) const {
+	return blocks ? (long) blocks->BlockSize() : 8;
+}
 
-	if (edgeTable[cubeindex] &  512) vertexList[ 9] = VertexInterpolation(cube.GetVertex(1), cube.GetVertex(5), cube.GetVertexValue(1), cube.GetVertexValue(5));
+/** \fn Point Grid::Corner(size_t, size_t, size_t) const
+ * \brief Coordinates of the grid point (x,y,z), computed from origin and pixdim.
+ */
+Point Grid::Corner(size_t x, size_t y, size_t z) const {
+	return Point(	v_origin[0] + x * v_pixdim[0],
+					v_origin[1] + y * v_pixdim[1],
+					v_origin[2] + z * v_pixdim[2],
+					v_origin[3]);
+}
 
-	if (edgeTable[cubeindex] & 1024) vertexList[10] = VertexInterpolation(cube.GetVertex(2), cube.GetVertex(6), cube.GetVertexValue(2), cube.GetVertexValue(6));
+/** \fn void Grid::PolygoniseSlabs(const Type *, long, long, TriangleArray *, const MinMaxBlocks *) const
+ * \brief Get the triangles for all cubes in the slabs z0 <= z < z1.
+ *
+ *	The values are read straight from \a data. Only a two-slice cache is
+ *	kept, which stores for every grid point of the lower and the upper slice
+ *	of the current slab whether it is below the iso value. The upper slice of
+ *	one slab is the lower slice of the next one, so every slice is classified
+ *	only once per chunk and the memory needed is O(nx*ny).
+ *
+ *	If \a blocks are given, the chunk is one layer of bricks and only the
+ *	cubes (and grid points) of active bricks are visited.
+ *
+ * \param data: the three dimensional data (x varies fastest)
+ * \param z0, z1: range of slabs to process
+ * \param slabs: one triangle buffer per slab, slabs[0] belongs to slab z0
+ * \param blocks: optional min/max bricks
+ */
+template <typename Type>
+void Grid::PolygoniseSlabs(const Type * const data, long z0, long z1, TriangleArray *slabs, const MinMaxBlocks *blocks) const {
+	const size_t nx = dimensions[0];
+	const size_t ny = dimensions[1];
+	const size_t slice = nx * ny;
+	const size_t offset[8] = {
+		0, 1, 1 + nx, nx,
+		slice, slice + 1, slice + 1 + nx, slice + nx
+	};
+
+	SlabRows rows;
+	if (not active_rows(blocks, nx, ny, blocks ? z0 / ChunkSize(blocks) : 0, Iso_Value, rows)) return;
+
+	vector<unsigned char> lower(slice), upper(slice);
+	classify(data + z0 * slice, nx, ny, rows, Iso_Value, lower);
+
+	for (long z = z0; z < z1; z++) {
+		TriangleArray &out = slabs[z - z0];
+		classify(data + (z + 1) * slice, nx, ny, rows, Iso_Value, upper);
+
+		for (size_t y = 0; y < ny - 1; y++) {
+			const vector< pair<size_t,size_t> > &r = rows.ranges[y / rows.brick];
+			for (size_t k = 0; k < r.size(); k++)
+			for (size_t x = r[k].first; x < r[k].second; x++) {
+				/*
+				  Determine the index into the edge table which
+				  tells us which vertices are inside of the surface
+				*/
+				const size_t b = x + y * nx;
+				int cubeindex = 0;
+				if (lower[b         ])	cubeindex |= 1;
+				if (lower[b + 1     ])	cubeindex |= 2;
+				if (lower[b + 1 + nx])	cubeindex |= 4;
+				if (lower[b + nx    ])	cubeindex |= 8;
+				if (upper[b         ])	cubeindex |= 16;
+				if (upper[b + 1     ])	cubeindex |= 32;
+				if (upper[b + 1 + nx])	cubeindex |= 64;
+				if (upper[b + nx    ])	cubeindex |= 128;
+
+				/* Cube is entirely in/out of the surface */
+				const int edges = edgeTable[cubeindex];
+				if (edges == 0) continue;
+
+				const size_t base = b + z * slice;
+				double value[8];
+				Point  vertex[8];
+				for (int v = 0; v < 8; v++) {
+					value[v]  = data[base + offset[v]];
+					vertex[v] = Corner(	x + corner_offset[v][0],
+										y + corner_offset[v][1],
+										z + corner_offset[v][2]);
+				}
+
+				/* Find the vertices where the surface intersects the cube */
+				Point vertexList[12];
+				for (int e = 0; e < 12; e++) {
+					if (not (edges & (1 << e))) continue;
+					const int v1 = edge_vertices[e][0];
+					const int v2 = edge_vertices[e][1];
+					vertexList[e] = VertexInterpolation(vertex[v1], vertex[v2], value[v1], value[v2]);
+				}
+
+				/* Create the triangle */
+				for (int i = 0; triTable[cubeindex][i] != -1; i += 3) {
+					try {
+						Triangle T(	vertexList[triTable[cubeindex][i  ]],
+									vertexList[triTable[cubeindex][i+1]],
+									vertexList[triTable[cubeindex][i+2]] );
+						out.push_back(T);
+					} catch(Point::Exception_ZeroLength &e) {
+						// There is no need to make a specific handling, ignoring is ok.
+					}
+				}
+			}
+		}
+		lower.swap(upper);
+	}
+}
 
-	if (edgeTable[cubeindex] & 2048) vertexList[11] = VertexInterpolation(cube.GetVertex(3), cube.GetVertex(7), cube.GetVertexValue(3), cube.GetVertexValue(7));
+/// the edges of a cube with the vertex of lower grid index first
+static const int edge_vertices_ordered[12][2] = {
+	{0,1}, {1,2}, {3,2}, {0,3},
+	{4,5}, {5,6}, {7,6}, {4,7},
+	{0,4}, {1,5}, {2,6}, {3,7}
+};
 
+/// direction of each edge of a cube: 0 = x, 1 = y, 2 = z
+static const int edge_axis[12] = {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2};
 
-	/* Create the triangle */
-	for(int i = 0; triTable[cubeindex][i] != -1; i+=3) {
-		try {
-			Triangle T(	vertexList[triTable[cubeindex][i  ]],
-			            vertexList[triTable[cubeindex][i+1]],
-			            vertexList[triTable[cubeindex][i+2]] );
-			//T.info();
-			TriangleList.push_back(T);
-		} catch(Point::Exception_ZeroLength &e) {
-			// There is no need to make a specific handling, ignoring is ok.
+/** \fn void Grid::PolygoniseSlabs(const Type *, long, long, IndexedChunk &, const MinMaxBlocks *) const
+ * \brief Indexed variant: get the triangles for all cubes in the slabs z0 <= z < z1.
+ *
+ *	Besides the two-slice cache for the classification of the grid points,
+ *	vertex caches are kept for the lower and the upper slice (x-edges, y-edges
+ *	and snapped grid points, key = 3*(x + y*nx) + kind) and for the z-edges
+ *	between them. The upper caches become the lower ones of the next slab.
+ *	Only the entries which were used are reset after each slab.
+ */
+template <typename Type>
+void Grid::PolygoniseSlabs(const Type * const data, long z0, long z1, IndexedChunk &out, const MinMaxBlocks *blocks) const {
+	const size_t npos = (size_t) -1;
+	const size_t nx = dimensions[0];
+	const size_t ny = dimensions[1];
+	const size_t slice = nx * ny;
+	const size_t offset[8] = {
+		0, 1, 1 + nx, nx,
+		slice, slice + 1, slice + 1 + nx, slice + nx
+	};
+
+	SlabRows rows;
+	if (not active_rows(blocks, nx, ny, blocks ? z0 / ChunkSize(blocks) : 0, Iso_Value, rows)) return;
+
+	vector<unsigned char> lower(slice), upper(slice);
+	vector<size_t> lower_vtx(3 * slice, npos), upper_vtx(3 * slice, npos), z_vtx(slice, npos);
+	vector<size_t> lower_used, upper_used, z_used; // entries of the caches to reset
+	classify(data + z0 * slice, nx, ny, rows, Iso_Value, lower);
+
+	for (long z = z0; z < z1; z++) {
+		classify(data + (z + 1) * slice, nx, ny, rows, Iso_Value, upper);
+
+		for (size_t y = 0; y < ny - 1; y++) {
+			const vector< pair<size_t,size_t> > &r = rows.ranges[y / rows.brick];
+			for (size_t k = 0; k < r.size(); k++)
+			for (size_t x = r[k].first; x < r[k].second; x++) {
+				const size_t b = x + y * nx;
+				int cubeindex = 0;
+				if (lower[b         ])	cubeindex |= 1;
+				if (lower[b + 1     ])	cubeindex |= 2;
+				if (lower[b + 1 + nx])	cubeindex |= 4;
+				if (lower[b + nx    ])	cubeindex |= 8;
+				if (upper[b         ])	cubeindex |= 16;
+				if (upper[b + 1     ])	cubeindex |= 32;
+				if (upper[b + 1 + nx])	cubeindex |= 64;
+				if (upper[b + nx    ])	cubeindex |= 128;
+
+				const int edges = edgeTable[cubeindex];
+				if (edges == 0) continue;
+
+				const size_t base = b + z * slice;
+				double value[8];
+				for (int v = 0; v < 8; v++) value[v] = data[base + offset[v]];
+
+				size_t vertexList[12];
+				for (int e = 0; e < 12; e++) {
+					if (not (edges & (1 << e))) continue;
+					const int v1 = edge_vertices_ordered[e][0];
+					const int v2 = edge_vertices_ordered[e][1];
+
+					// the same decisions as in VertexInterpolation()
+					int snap = -1;
+					if      (((Iso_Value - value[v1])*(Iso_Value - value[v1])) < SMALL_NUM) snap = v1;
+					else if (((Iso_Value - value[v2])*(Iso_Value - value[v2])) < SMALL_NUM) snap = v2;
+					else if (((value[v1] - value[v2])*(value[v1] - value[v2])) < SMALL_NUM) snap = v1;
+
+					const int corner = (snap < 0) ? v1 : snap;
+					const size_t bc = b + corner_offset[corner][0] + corner_offset[corner][1] * nx;
+					const int plane = corner_offset[corner][2];
+					size_t *slot, key = npos;
+					if (snap < 0 and edge_axis[e] == 2) slot = &z_vtx[bc];
+					else {
+						key  = 3 * bc + ((snap < 0) ? edge_axis[e] : 2);
+						slot = plane ? &upper_vtx[key] : &lower_vtx[key];
+					}
+
+					if (*slot == npos) {
+						*slot = out.points.size();
+						if (snap < 0) {
+							const Point p1 = Corner(x + corner_offset[v1][0], y + corner_offset[v1][1], z + corner_offset[v1][2]);
+							const Point p2 = Corner(x + corner_offset[v2][0], y + corner_offset[v2][1], z + corner_offset[v2][2]);
+							out.points.push_back(VertexInterpolation(p1, p2, value[v1], value[v2]));
+						}
+						else out.points.push_back(Corner(x + corner_offset[snap][0], y + corner_offset[snap][1], z + corner_offset[snap][2]));
+
+						if (key == npos) z_used.push_back(bc);
+						else {
+							(plane ? upper_used : lower_used).push_back(key);
+							if (plane == 0 and z == z0    ) out.bottom.push_back(make_pair(key, *slot));
+							if (plane == 1 and z == z1 - 1) out.top.push_back(make_pair(key, *slot));
+						}
+					}
+					vertexList[e] = *slot;
+				}
+
+				for (int i = 0; triTable[cubeindex][i] != -1; i += 3) {
+					const size_t t0 = vertexList[triTable[cubeindex][i  ]];
+					const size_t t1 = vertexList[triTable[cubeindex][i+1]];
+					const size_t t2 = vertexList[triTable[cubeindex][i+2]];
+					if (t0 == t1 or t0 == t2 or t1 == t2) continue; // degenerated triangle
+					out.faces.push_back(t0);
+					out.faces.push_back(t1);
+					out.faces.push_back(t2);
+				}
+			}
 		}
+		lower.swap(upper);
+
+		// the upper caches become the lower ones, the old lower ones are reset
+		for (size_t i = 0; i < lower_used.size(); i++) lower_vtx[lower_used[i]] = npos;
+		for (size_t i = 0; i < z_used.size(); i++)     z_vtx[z_used[i]] = npos;
+		lower_vtx.swap(upper_vtx);
+		lower_used.swap(upper_used);
+		upper_used.clear();
+		z_used.clear();
 	}
 }
 
@@ -252,7 +600,7 @@ void Grid::Polygonise(Cube &cube) {
  * \return A point that conatins the position of the cut.
  */
 Point Grid::VertexInterpolation(const Point  &p1, const Point  &p2,
-								const double &v1, const double &v2 ) {
+								const double &v1, const double &v2 ) const {
 
 	if(((Iso_Value - v1)*(Iso_Value - v1)) < SMALL_NUM)	return p1;
 	if(((Iso_Value - v2)*(Iso_Value - v2)) < SMALL_NUM)	return p2;
@@ -299,7 +647,7 @@ void Grid::SaveTriangleList(const char *filename) const {
 		//cout<<"Header is written."<<nr_elements<<" "<<nr_variables<<"\n";
 
 		//! Now we write all values for one point in one line and do this for every point.
-		for (list<Triangle>::const_iterator it = TriangleList.begin(); it != TriangleList.end(); it++) {
+		for (TriangleArray::const_iterator it = TriangleList.begin(); it != TriangleList.end(); it++) {
 			const Triangle &t = *it;
 			schreiben << t.v1.x << " ";
 			schreiben << t.v1.y << " ";
@@ -316,24 +664,44 @@ void Grid::SaveTriangleList(const char *filename) const {
 	schreiben.close();
 }
 
+/** \fn void Grid::Save(const char *) const
+ * \brief Saves the isosurface as a surface mesh.
+ *
+ *	Files with the extension .ply, .stl or .vtp are written in binary (see
+ *	TriangleWriter), STL files directly from \a TriangleList. For all other
+ *	names the identical vertices are merged and the mesh is saved with
+ *	SurfaceMesh::save_mesh().
+ */
 void Grid::Save(const char *filename) const {
+	mystring ext;
+	if (filename) ext = mystring(filename).file_ext();
+	ext.lower();
+	if (ext == "stl") {
+		TriangleWriter out(filename, TriangleWriter::STL);
+		out.Write(TriangleList);
+		out.Close();
+		return;
+	}
+
 	mystring fn;
 	if(filename) fn = mystring(filename).file_base();
 	else   		 fn = "Tri_List_out";
-	SurfaceMesh out;
-	for (list<Triangle>::const_iterator it = TriangleList.begin(); it != TriangleList.end(); it++) {
+	vector<Point> soup;
+	soup.reserve(3*TriangleList.size());
+	for (TriangleArray::const_iterator it = TriangleList.begin(); it != TriangleList.end(); it++) {
 		const Triangle &t = *it;
-		size_t i1 = out.append_point_uniquely(t.v1);
-		size_t i2 = out.append_point_uniquely(t.v2);
-		size_t i3 = out.append_point_uniquely(t.v3);
-
-
-		out.append_face(Face(i1,i2,i3));
+		soup.push_back(t.v1);
+		soup.push_back(t.v2);
+		soup.push_back(t.v3);
 	}
+
+	SurfaceMesh out;
+	out.append_triangle_soup(soup); // merges identical vertices in parallel
 //	out.SmoothSurfaceLaplacianHC(1, .3, 0.);
 //	out.SmoothSurfaceLaplacian(1);
 
-	out.save_mesh(fn.c_str());
+	if (ext == "ply" or ext == "vtp") TriangleWriter::Save(out, filename);
+	else out.save_mesh(fn.c_str());
 }
 
 /** \fn void Grid::LoadTriangleList(const char * const)
@@ -342,59 +710,42 @@ void Grid::Save(const char *filename) const {
  *	This method will load triangles from a file with given name (and path).
  *	The result is at the end in TriangleList.<br>
  *	Previous triangles in TriangleList are cleared.<br>
- *	This method will return without doing something in the case the filename is
- *	empty, the file couldn't be opened the file is empty or an error ouccoured.
+ *	Binary STL and PLY files as well as the text format of SaveTriangleList()
+ *	are read (see LoadTriangles()). This method will return without doing
+ *	something in the case the filename is empty, errors are reported on cerr.
  *
  * \param filename: A reference to a string that contains name and path of the
  *				file that should be load.
  */
 void Grid::LoadTriangleList(const char *filename) {
-	if (strlen(filename) == 0) return;
-
-	FILE *f = NULL;
-	f = fopen(filename, "r");//!< Try to open the file.
-
-	double vals[9];
-	for(size_t i = 0; i < 0; i++) vals[i] = 0.0;
-
-	if (! f) { //! Error and return if the file could not be opened.
-		cerr << "Could not open " <<filename<< endl;
-		return;
-	}
-
-	char test[1024] = "#";//!< Buffer variable.
-
-	/* Read a line from the file. If a NULL-pointer was returned by fgets either
-	 * the end of file is reached or an error occoured.
-	 */
-	if(NULL == fgets(test,1024, f)) {
-		if(0 != ferror(f)) {
-			// Here one could handle the error.
-			return;
-		}
-
-		if(0 != feof(f)) {
-			// Here one could handle the end-of-line.
-			return;
-		}
-
-		// Something unexpected has happened, so return.
-		return;
-	}
+	if (not filename or strlen(filename) == 0) return;
 
 	TriangleList.clear();
-
-	while (fgets(test,1024, f)) {
-		if (test[0] == '#') continue;//!< Skip comment and parameter lines
-		sscanf(test, "%lf %lf %lf %lf %lf %lf %lf %lf %lf\n", &vals[0], &vals[1], &vals[2],
-		       &vals[3], &vals[4], &vals[5],
-		       &vals[6], &vals[7], &vals[8]);//!< Read a line with data.
-
-		Triangle T( Point(vals[0], vals[1], vals[2]),
-		            Point(vals[3], vals[4], vals[5]),
-		            Point(vals[6], vals[7], vals[8]) );
-		TriangleList.push_back(T);
+	try {
+		LoadTriangles(filename, TriangleList);
+	} catch (myexception &e) {
+		cerr << e.what() << endl;
 	}
 }
 
+/** \def MCUBES_INSTANTIATE
+ * The extraction reads the values in their own type, so volumes (GIPL, IGB,
+ * mymatrix) need not be converted to double before. It is instantiated for
+ * double, float, int, short, unsigned short, char and unsigned char.
+ */
+#define MCUBES_INSTANTIATE(T) \
+	template void Grid::RunAlgorithm<T>(const T *, const double, const MinMaxBlocks *); \
+	template void Grid::RunAlgorithm<T>(const T *, const double, SurfaceMesh &, const MinMaxBlocks *); \
+	template void Grid::RunAlgorithm<T>(const T *, const double, TriangleWriter &, const MinMaxBlocks *);
+
+MCUBES_INSTANTIATE(double)
+MCUBES_INSTANTIATE(float)
+MCUBES_INSTANTIATE(int)
+MCUBES_INSTANTIATE(short)
+MCUBES_INSTANTIATE(unsigned short)
+MCUBES_INSTANTIATE(char)
+MCUBES_INSTANTIATE(unsigned char)
+
+#undef MCUBES_INSTANTIATE
+
 }
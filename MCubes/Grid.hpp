@@ -34,11 +34,14 @@
 #include <stdlib.h>
 #include <math.h>
 #include <list>
+#include <vector>
 #include <omp.h>
 
 #include "Triangle.hpp"
 #include "Cube.hpp"
 #include "Tables.hpp"
+#include "MinMaxBlocks.hpp"
+#include "TriangleIO.hpp"
 
 #include "Triangle.hpp"
 
@@ -65,11 +68,16 @@ namespace MCubes {
  * Grid(const Point pixel_dims, size_t max_x, size_t max_y, size_t max_z);
  * ~Grid();
  *
- * Calculation methods:
- * void ConstructCubeList();
- * void SetCubeValues(Cube &cube, const double *data);
- * void RunAlgorithm(const double *data, const double iso);
- * void Polygonise(Cube &cube);
+ * Calculation methods, Type is one of double, float, int, short, unsigned short, char and
+ * unsigned char:
+ * void RunAlgorithm(const Type *data, const double iso, const MinMaxBlocks *blocks = NULL);
+ * void RunAlgorithm(const Type *data, const double iso, SurfaceMesh &mesh, const MinMaxBlocks *blocks = NULL);
+ * void RunAlgorithm(const Type *data, const double iso, TriangleWriter &out, const MinMaxBlocks *blocks = NULL);
+ * void PolygoniseSlabs(const Type *data, long z0, long z1, TriangleArray *slabs, const MinMaxBlocks *blocks) const;
+ * void PolygoniseSlabs(const Type *data, long z0, long z1, IndexedChunk &out, const MinMaxBlocks *blocks) const;
+ *
+ * Helper methods:
+ * Point Corner(size_t x, size_t y, size_t z) const;
  * void VertexInterpolation(Point &v,const Point &v1,const Point &v2, const double &value_one,const double &value_two);
  * void SaveTriangleList(const string* filename);
  * void LoadTriangleList(const char* filename);
@@ -77,7 +85,7 @@ namespace MCubes {
  */
 class Grid : public my_regular_grid {
 	public:
-		list<Triangle> TriangleList;
+		TriangleArray TriangleList;
 
 		// ******************************************
 		// *------ Constructors & Destructors ------*
@@ -90,33 +98,32 @@ class Grid : public my_regular_grid {
 		// *--------- Calculation methods ----------*
 		// ******************************************
 	private:
-		void ConstructCubeList();
-		void SetCubeValues(Cube &cube, const double *data);
-		void Polygonise(Cube &cube);
-		Point VertexInterpolation(const Point &p1,const Point &p2, const double &v1,const double &v2);
+		struct IndexedChunk;
+		template <typename Type>
+		void PolygoniseSlabs(const Type *data, long z0, long z1, TriangleArray *slabs, const MinMaxBlocks *blocks) const;
+		template <typename Type>
+		void PolygoniseSlabs(const Type *data, long z0, long z1, IndexedChunk &out, const MinMaxBlocks *blocks) const;
+		void CheckBlocks(const MinMaxBlocks *blocks) const;
+		long ChunkSize(const MinMaxBlocks *blocks) const;
+		Point Corner(size_t x, size_t y, size_t z) const;
+		Point VertexInterpolation(const Point &p1,const Point &p2, const double &v1,const double &v2) const;
 		size_t ijk_index(size_t i, size_t j, size_t k);
 
 	public:
-		void RunAlgorithm(const double *data, const double iso);
+		template <typename Type>
+		void RunAlgorithm(const Type *data, const double iso, const MinMaxBlocks *blocks = NULL);
+		template <typename Type>
+		void RunAlgorithm(const Type *data, const double iso, SurfaceMesh &mesh, const MinMaxBlocks *blocks = NULL);
+		template <typename Type>
+		void RunAlgorithm(const Type *data, const double iso, TriangleWriter &out, const MinMaxBlocks *blocks = NULL);
 		void SaveTriangleList(const char *filename = NULL) const __attribute_deprecated__;
 		void Save(const char *filename = NULL) const;
 		void LoadTriangleList(const char *filename);
 
-
-		// ***************************************
-		// ----- Object Getting methods ---------*
-		// ***************************************
-		inline Cube const * GetCubeList() const {
-			return this->CubeList;
-		}
-
 	protected:
 		// ******************************************
 		// *---------------Variables ---------------*
 		// ******************************************
-		//CubeVector CubeList;
-		Cube *CubeList;
-		bool Cubes_Set;
 		double Iso_Value;
 };
 
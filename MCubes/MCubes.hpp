@@ -102,27 +102,31 @@
 		...
  \endverbatim
  *
- *	Based upon this parameters the constructor sets up a onedimensional array of
- *	cubes, the CubeList. This is done in order to set the cubes just one time
- *	before the algorithm itself starts. Afterwards only the values at each
- *	vertex have to be renewed and not the whole list of cubes at each simulation
- *	time step. Now the algorithm can be evaluated for each time step as follows:
+ *	The grid does not store any cubes. The coordinates of the cube corners are
+ *	computed from origin and pixel dimensions and the values are read directly
+ *	from the data array while the grid is swept slice by slice, so apart from
+ *	the triangles only O(max_x*max_y) memory is needed. Now the algorithm can be
+ *	evaluated for each time step as follows:
  *
  \verbatim
 	mcubes_grid.RunAlgorithm(const double *data, const double iso);
  \endverbatim
  *
+ *	The data may be given as double, float, int, short, unsigned short, char or
+ *	unsigned char, so GIPL volumes and IGB frames are used without converting
+ *	them to double first.
+ *
  *	Here one has to feed the data set and an iso value into the algorithm. Based
  *	upon the data and the iso value the algorithm will create a list of
  *	triangles that represent the iso concentration planes. These list can then
- *	be accessed via a list<MCubes::Triangle>::cons_iterator which iterates over
+ *	be accessed via a MCubes::TriangleArray::const_iterator which iterates over
  *	the \a TriangleList member of the MCubes::Grid object. For example could the
  *	triangle be drawn by the following code (a proper coordinate system is
  *	assumed):
  *
  \verbatim
 	glBegin( GL_TRIANGLES );
-	list<MCubes::Triangle>::const_iterator it;
+	MCubes::TriangleArray::const_iterator it;
 	for (it = mcubes_algorithm->TriangleList.begin(); it != mcubes_algorithm->TriangleList.end(); it++) {
 		MCubes::Triangle const &t = *it;
 		glNormal3f(t.NormalVector.x, t.NormalVector.y, t.NormalVector.z);
@@ -134,6 +138,25 @@
 	}
  \endverbatim
  *
+ *	If an indexed mesh is needed (e.g. for saving or smoothing), the vertices
+ *	can be shared right away. Each intersected grid edge gets exactly one
+ *	vertex and no welding of the triangle corners is necessary:
+ *
+ \verbatim
+	SurfaceMesh mesh;
+	mcubes_grid.RunAlgorithm(data, iso, mesh);
+	mesh.save_mesh("isosurface");
+ \endverbatim
+ *
+ *	Large isosurfaces can be streamed into a binary PLY, STL or VTK (.vtp)
+ *	file without keeping the triangles in memory:
+ *
+ \verbatim
+	MCubes::TriangleWriter out("isosurface.stl");
+	mcubes_grid.RunAlgorithm(data, iso, out);
+	out.Close();
+ \endverbatim
+ *
  * \section sec_mc_copyright Copyright
  *
  * - Arash Azhand <azhand@itp.tu-berlin.de>
@@ -157,7 +180,9 @@
 
 #include "Grid.hpp"
 #include "Mesh.hpp"
+#include "MinMaxBlocks.hpp"
 #include "Triangle.hpp"
+#include "TriangleIO.hpp"
 
 namespace MCubes {
 
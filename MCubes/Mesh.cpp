@@ -23,6 +23,7 @@
 
 #include <cstring>
 #include <fstream>
+#include <algorithm>
 //#include <iostream>
 
 #include "Mesh.hpp"
@@ -45,38 +46,400 @@ Mesh::~Mesh() {
 
 }
 
-/** \fn void Mesh::RunAlgorithm(const double * const, const double)
+/** \fn void Mesh::RunAlgorithm(const Type * const, const double, const MinMaxBlocks *)
  * \brief Compute the isosurface.
  *
  *	This method will compute the isosurface within the given data. The
  *	trigangles are at the end in \a TriangleList.
  *
- * \param data: Pointer to doubles, which contain the values. It is assumed that
- *				within the given 1d-array are the three dimensional data.
+ *	The elements are processed in parallel in blocks, each block collects its
+ *	triangles in an own buffer. The buffers are concatenated in order, so the
+ *	result does not depend on the number of threads.
+ *
+ * \param data: Pointer to the values, one per point of the mesh (for the
+ * 				supported types see Grid::RunAlgorithm()).
  * \param iso: The value that should be used for the isosurface.
+ * \param blocks: optional min/max blocks of \a data (see MinMaxBlocks), only
+ * 				elements of active blocks are visited
  */
-void Mesh::RunAlgorithm(const double * const data, const double iso) {
+template <typename Type>
+void Mesh::RunAlgorithm(const Type * const data, const double iso, const MinMaxBlocks *blocks) {
 
 //	if (SurfaceMesh::dim != 3) throw throw myexception("MCubes::Mesh::IsoSurface(): Cannot proceed, the mesh is not 3D !");
 	Iso_Value = iso;
 	TriangleList.clear();
+	CheckBlocks(blocks);
+
+	const long block     = BlockSize(blocks);
+	const long nr_elem   = (long) elements();
+	const long nr_blocks = (nr_elem + block - 1) / block;
+	vector<TriangleArray> buffers(nr_blocks);
+	long c = 0;
+
+#ifdef _OPENMP /** Compute in parallelized manner*/
+	#pragma omp parallel for private(c) schedule(dynamic)
+#endif
+	for (c = 0; c < nr_blocks; c++) {
+		if (blocks and not blocks->Active(c, Iso_Value)) continue;
+		const long last = (c + 1) * block < nr_elem ? (c + 1) * block : nr_elem;
+		for (long i = c * block; i < last; i++) {
+			const vector<int> &v = f[i].v;
+			if (v.size() != 4) continue;
+			PolygoniseTri(data, v[0], v[1], v[2], v[3], buffers[c]);
+		}
+	}
+
+	size_t nr_triangles = 0;
+	for (c = 0; c < nr_blocks; c++) nr_triangles += buffers[c].size();
+
+	TriangleList.reserve(nr_triangles);
+	for (c = 0; c < nr_blocks; c++) {
+		TriangleList.insert(TriangleList.end(), buffers[c].begin(), buffers[c].end());
+		TriangleArray().swap(buffers[c]); // free the memory early
+	}
+}
+
+/** \fn void Mesh::RunAlgorithm(const Type * const, const double, TriangleWriter &, const MinMaxBlocks *)
+ * \brief Compute the isosurface and write it to a file.
+ *
+ *	Same as above, but the triangles are passed to \a out instead of being
+ *	collected in \a TriangleList. The blocks of elements are processed in
+ *	waves of a few blocks per thread, so only a small part of the isosurface
+ *	is held in memory at any time.
+ *
+ * \param data: Pointer to the values, one per point of the mesh.
+ * \param iso: The value that should be used for the isosurface.
+ * \param out: an open TriangleWriter, it is not closed afterwards
+ * \param blocks: optional min/max blocks of \a data
+ */
+template <typename Type>
+void Mesh::RunAlgorithm(const Type * const data, const double iso, TriangleWriter &out, const MinMaxBlocks *blocks) {
+	Iso_Value = iso;
+	if (not out.IsOpen()) throw myexception("MCubes::Mesh: The output file is not open.");
+	CheckBlocks(blocks);
+
+	const long block     = BlockSize(blocks);
+	const long nr_elem   = (long) elements();
+	const long nr_blocks = (nr_elem + block - 1) / block;
+#ifdef _OPENMP
+	const long wave      = 4 * omp_get_max_threads(); // blocks per wave
+#else
+	const long wave      = 1;
+#endif
+	vector<TriangleArray> buffers(min(nr_blocks, wave));
+
+	for (long w = 0; w < nr_blocks; w += wave) {
+		const long c1 = min(w + wave, nr_blocks);
+		long c = 0;
+#ifdef _OPENMP
+		#pragma omp parallel for private(c) schedule(dynamic)
+#endif
+		for (c = w; c < c1; c++) {
+			if (blocks and not blocks->Active(c, Iso_Value)) continue;
+			const long last = (c + 1) * block < nr_elem ? (c + 1) * block : nr_elem;
+			for (long i = c * block; i < last; i++) {
+				const vector<int> &v = f[i].v;
+				if (v.size() != 4) continue;
+				PolygoniseTri(data, v[0], v[1], v[2], v[3], buffers[c - w]);
+			}
+		}
+
+		for (c = w; c < c1; c++) {
+			out.Write(buffers[c - w]);
+			buffers[c - w].clear();
+		}
+	}
+}
+
+/** \fn bool Mesh::TopologyValid() const
+ * Checks whether the edges computed by BuildTopology() still belong to the
+ * elements of the mesh.
+ */
+bool Mesh::TopologyValid() const {
+	return (tet_edges.size() == 6 * elements() and not (elements() > 0 and edge_points.empty()));
+}
+
+/** \fn void Mesh::BuildTopology()
+ * \brief Determines the unique edges of all tetrahedra.
+ *
+ *	The edges are collected per lower point index (bucket sort), sorted and
+ *	made unique within each bucket, so edge ids are ordered by (lower point,
+ *	upper point). For every element the ids of its six edges are stored in the
+ *	order 01, 02, 03, 12, 13, 23. The topology is computed once and reused by
+ *	all following calls of the indexed RunAlgorithm(). It is rebuilt
+ *	automatically if the number of elements changes; after other changes of
+ *	the elements call this method again.
+ */
+void Mesh::BuildTopology() {
+	static const int tet_edge[6][2] = {{0,1}, {0,2}, {0,3}, {1,2}, {1,3}, {2,3}};
+	const size_t npos  = (size_t) -1;
+	const long nr_elem = (long) elements();
+	const long nr_pts  = (long) points();
+
+	// bucket the upper point of every edge by its lower point
+	vector<size_t> start(nr_pts + 1, 0);
+	for (long i = 0; i < nr_elem; i++) {
+		const vector<int> &v = f[i].v;
+		if (v.size() != 4) continue;
+		for (int e = 0; e < 6; e++) start[min(v[tet_edge[e][0]], v[tet_edge[e][1]]) + 1]++;
+	}
+	for (long i = 0; i < nr_pts; i++) start[i+1] += start[i];
+
+	vector<size_t> upper(start[nr_pts]);
+	{
+		vector<size_t> fill(start.begin(), start.end() - 1);
+		for (long i = 0; i < nr_elem; i++) {
+			const vector<int> &v = f[i].v;
+			if (v.size() != 4) continue;
+			for (int e = 0; e < 6; e++) {
+				const int a = v[tet_edge[e][0]], b = v[tet_edge[e][1]];
+				upper[fill[min(a,b)]++] = max(a,b);
+			}
+		}
+	}
+
+	// sort and unique each bucket, count the edges
+	vector<size_t> count(nr_pts + 1, 0);
+	long i = 0;
+#ifdef _OPENMP
+	#pragma omp parallel for private(i) schedule(dynamic, 1024)
+#endif
+	for (i = 0; i < nr_pts; i++) {
+		vector<size_t>::iterator first = upper.begin() + start[i];
+		vector<size_t>::iterator last  = upper.begin() + start[i+1];
+		sort(first, last);
+		count[i+1] = unique(first, last) - first;
+	}
+	vector<size_t> first_edge(nr_pts + 1, 0);
+	for (i = 0; i < nr_pts; i++) first_edge[i+1] = first_edge[i] + count[i+1];
+
+	edge_points.resize(2 * first_edge[nr_pts]);
+#ifdef _OPENMP
+	#pragma omp parallel for private(i) schedule(dynamic, 1024)
+#endif
+	for (i = 0; i < nr_pts; i++) {
+		for (size_t k = 0; k < count[i+1]; k++) {
+			edge_points[2 * (first_edge[i] + k)    ] = i;
+			edge_points[2 * (first_edge[i] + k) + 1] = upper[start[i] + k];
+		}
+	}
+
+	// look up the edge ids of every element
+	tet_edges.assign(6 * nr_elem, npos);
+#ifdef _OPENMP
+	#pragma omp parallel for private(i) schedule(static)
+#endif
+	for (i = 0; i < nr_elem; i++) {
+		const vector<int> &v = f[i].v;
+		if (v.size() != 4) continue;
+		for (int e = 0; e < 6; e++) {
+			const int a = v[tet_edge[e][0]], b = v[tet_edge[e][1]];
+			const size_t lo = min(a,b), hi = max(a,b);
+			vector<size_t>::const_iterator first = upper.begin() + start[lo];
+			vector<size_t>::const_iterator pos = lower_bound(first, first + count[lo+1], hi);
+			tet_edges[6*i + e] = first_edge[lo] + (pos - first);
+		}
+	}
+}
+
+/// Triangles of each marching tetrahedra case as local edge ids (01,02,03,12,13,23),
+/// in the same order and orientation as created by Mesh::PolygoniseTri().
+static const int tetTriTable[16][7] = {
+	{-1, -1, -1, -1, -1, -1, -1},	// 0x00
+	{ 0,  1,  2, -1, -1, -1, -1},	// 0x01
+	{ 0,  4,  3, -1, -1, -1, -1},	// 0x02
+	{ 2,  1,  4,  4,  3,  1, -1},	// 0x03
+	{ 1,  3,  5, -1, -1, -1, -1},	// 0x04
+	{ 0,  5,  2,  0,  3,  5, -1},	// 0x05
+	{ 0,  5,  4,  0,  1,  5, -1},	// 0x06
+	{ 2,  5,  4, -1, -1, -1, -1},	// 0x07
+	{ 2,  5,  4, -1, -1, -1, -1},	// 0x08
+	{ 0,  5,  4,  0,  1,  5, -1},	// 0x09
+	{ 0,  5,  2,  0,  3,  5, -1},	// 0x0A
+	{ 1,  3,  5, -1, -1, -1, -1},	// 0x0B
+	{ 2,  1,  4,  4,  3,  1, -1},	// 0x0C
+	{ 0,  4,  3, -1, -1, -1, -1},	// 0x0D
+	{ 0,  1,  2, -1, -1, -1, -1},	// 0x0E
+	{-1, -1, -1, -1, -1, -1, -1}	// 0x0F
+};
+
+/** \fn void Mesh::CheckBlocks(const MinMaxBlocks *) const
+ * Throws if the given blocks were not built for this mesh.
+ */
+void Mesh::CheckBlocks(const MinMaxBlocks *blocks) const {
+	if (blocks and not blocks->Matches(*this))
+		throw myexception("MCubes::Mesh: The MinMaxBlocks do not match the elements of the mesh.");
+}
+
+/** \fn long Mesh::BlockSize(const MinMaxBlocks *) const
+ * Number of elements processed by one task, with MinMaxBlocks one block.
+ */
+long Mesh::BlockSize(const MinMaxBlocks *blocks) const {
+	return blocks ? (long) blocks->BlockSize() : 16384;
+}
+
+/** \fn void Mesh::RunAlgorithm(const Type * const, const double, SurfaceMesh &, const MinMaxBlocks *)
+ * \brief Compute the isosurface as indexed mesh.
+ *
+ *	Every intersected edge of the mesh yields exactly one vertex, vertices
+ *	which are snapped onto a point of the mesh (see VertexInterpolation()) are
+ *	shared by that point. Only the elements are visited (in parallel, block
+ *	by block, skipping inactive blocks if \a blocks are given): first the cut
+ *	edges are collected, then their vertices are computed and finally the
+ *	faces are created. Vertex ids are assigned in the order of the edges, so
+ *	the result does not depend on the number of threads. \a TriangleList is
+ *	not touched.
+ *
+ * \param data: one value per point of the mesh
+ * \param iso: The value that should be used for the isosurface.
+ * \param out: receives points and faces, previous content is cleared
+ * \param blocks: optional min/max blocks of \a data
+ */
+template <typename Type>
+void Mesh::RunAlgorithm(const Type * const data, const double iso, SurfaceMesh &out, const MinMaxBlocks *blocks) {
+	Iso_Value = iso;
+	out.clear();
+	CheckBlocks(blocks);
+	if (not TopologyValid()) BuildTopology();
+
+	const long block     = BlockSize(blocks);
+	const long nr_elem   = (long) elements();
+	const long nr_blocks = (nr_elem + block - 1) / block;
+	vector< vector<size_t> > buffers(nr_blocks);
+	long c = 0;
+
+	// collect the edges which are cut
+#ifdef _OPENMP
+	#pragma omp parallel for private(c) schedule(dynamic)
+#endif
+	for (c = 0; c < nr_blocks; c++) {
+		if (blocks and not blocks->Active(c, Iso_Value)) continue;
+		vector<size_t> &buffer = buffers[c];
+		const long last = (c + 1) * block < nr_elem ? (c + 1) * block : nr_elem;
+		for (long i = c * block; i < last; i++) {
+			const int triindex = TetIndex(data, i);
+			for (int k = 0; tetTriTable[triindex][k] != -1; k++)
+				buffer.push_back(tet_edges[6*i + tetTriTable[triindex][k]]);
+		}
+	}
+
+	vector<size_t> cut_edges;
+	for (c = 0; c < nr_blocks; c++) {
+		cut_edges.insert(cut_edges.end(), buffers[c].begin(), buffers[c].end());
+		vector<size_t>().swap(buffers[c]);
+	}
+	sort(cut_edges.begin(), cut_edges.end());
+	cut_edges.erase(unique(cut_edges.begin(), cut_edges.end()), cut_edges.end());
+
+	// classify the cut edges: 0 interpolated, 1/2 snapped to the lower/upper point
+	const long nr_cut = (long) cut_edges.size();
+	vector<signed char> snap(nr_cut);
+	long e = 0;
+#ifdef _OPENMP
+	#pragma omp parallel for private(e) schedule(static)
+#endif
+	for (e = 0; e < nr_cut; e++) {
+		const size_t edge = cut_edges[e];
+		const double v1 = data[edge_points[2*edge]], v2 = data[edge_points[2*edge+1]];
+		if      (((Iso_Value - v1)*(Iso_Value - v1)) < SMALL_NUM)	snap[e] = 1;
+		else if (((Iso_Value - v2)*(Iso_Value - v2)) < SMALL_NUM)	snap[e] = 2;
+		else if (((v1 - v2)*(v1 - v2)) < SMALL_NUM)				snap[e] = 1;
+		else 														snap[e] = 0;
+	}
 
+	// assign vertex ids in the order of the edges
+	vector<size_t> edge_vertex(nr_cut);
+	map<size_t,size_t> point_vertex;
+	size_t nr_vertices = 0;
+	for (e = 0; e < nr_cut; e++) {
+		if (snap[e] == 0) { edge_vertex[e] = nr_vertices++; continue; }
+		const size_t pt = edge_points[2*cut_edges[e] + snap[e] - 1];
+		map<size_t,size_t>::iterator it = point_vertex.find(pt);
+		if (it == point_vertex.end()) it = point_vertex.insert(make_pair(pt, nr_vertices++)).first;
+		edge_vertex[e] = it->second;
+	}
 
-	size_t i = 0;
-	int numtri = 0;
-//	#ifdef _OPENMP /** Compute in parallelized manner*/
-//	#pragma omp parallel for private(i, numtri)
-//	#endif
-	for (i = 0; i < elements(); i++) {
-		if (f[i].size() != 4) continue;
+	out.p.resize(nr_vertices);
+#ifdef _OPENMP
+	#pragma omp parallel for private(e) schedule(static)
+#endif
+	for (e = 0; e < nr_cut; e++) {
+		if (snap[e] != 0) continue;
+		const size_t a = edge_points[2*cut_edges[e]], b = edge_points[2*cut_edges[e]+1];
+		out.p[edge_vertex[e]] = VertexInterpolation(p[a], p[b], data[a], data[b]);
+	}
+	for (map<size_t,size_t>::const_iterator it = point_vertex.begin(); it != point_vertex.end(); it++)
+		out.p[it->second] = p[it->first];
+
+	// faces, one buffer per block of elements
+#ifdef _OPENMP
+	#pragma omp parallel for private(c) schedule(dynamic)
+#endif
+	for (c = 0; c < nr_blocks; c++) {
+		if (blocks and not blocks->Active(c, Iso_Value)) continue;
+		vector<size_t> &buffer = buffers[c];
+		const long last = (c + 1) * block < nr_elem ? (c + 1) * block : nr_elem;
+		for (long i = c * block; i < last; i++) {
+			const int triindex = TetIndex(data, i);
+			const size_t *te = &tet_edges[6*i];
+			for (int k = 0; tetTriTable[triindex][k] != -1; k += 3) {
+				size_t t[3];
+				for (int j = 0; j < 3; j++) {
+					const size_t edge = te[tetTriTable[triindex][k+j]];
+					t[j] = edge_vertex[lower_bound(cut_edges.begin(), cut_edges.end(), edge) - cut_edges.begin()];
+				}
+				if (t[0] == t[1] or t[0] == t[2] or t[1] == t[2]) continue; // degenerated triangle
+				buffer.insert(buffer.end(), t, t + 3);
+			}
+		}
+	}
 
-		numtri = PolygoniseTri(data, f[i].v[0],f[i].v[1], f[i].v[2], f[i].v[3]);
-//		if (numtri > 0){
-//			cout << numtri << " >> " << TriangleList.size() << endl;
-//		}
+	size_t nr_faces = 0;
+	for (c = 0; c < nr_blocks; c++) nr_faces += buffers[c].size() / 3;
+	out.f.reserve(nr_faces);
+	for (c = 0; c < nr_blocks; c++) {
+		const vector<size_t> &buffer = buffers[c];
+		for (size_t k = 0; k + 2 < buffer.size(); k += 3)
+			out.f.push_back(Face(buffer[k], buffer[k+1], buffer[k+2]));
+		vector<size_t>().swap(buffers[c]);
 	}
 }
 
+/** \fn int Mesh::TetIndex(const Type *, size_t) const
+ * Case of element i for marching tetrahedra (0 for non-tetrahedral elements).
+ */
+template <typename Type>
+int Mesh::TetIndex(const Type *data, size_t i) const {
+	const vector<int> &v = f[i].v;
+	if (v.size() != 4) return 0;
+	int triindex = 0;
+	if (data[v[0]] < Iso_Value) triindex |= 1;
+	if (data[v[1]] < Iso_Value) triindex |= 2;
+	if (data[v[2]] < Iso_Value) triindex |= 4;
+	if (data[v[3]] < Iso_Value) triindex |= 8;
+	return triindex;
+}
+
+/** \fn void Mesh::RunAlgorithm(const Type * const, size_t, const double, vector<SurfaceMesh> &)
+ * \brief Compute the isosurfaces of a series of frames.
+ *
+ *	The frames are stored one after another in \a data, each with one value per
+ *	point of the mesh (as in IGB files). The topology of the mesh is built only
+ *	once and reused for all frames.
+ *
+ * \param data: nr_frames * points() values
+ * \param nr_frames: number of frames
+ * \param iso: The value that should be used for the isosurface.
+ * \param out: receives one indexed mesh per frame
+ */
+template <typename Type>
+void Mesh::RunAlgorithm(const Type * const data, size_t nr_frames, const double iso, vector<SurfaceMesh> &out) {
+	if (not TopologyValid()) BuildTopology();
+	out.resize(nr_frames);
+	for (size_t frame = 0; frame < nr_frames; frame++)
+		RunAlgorithm(data + frame * points(), iso, out[frame]);
+}
+
 /*
    Polygonise a tetrahedron given its vertices within a cube
    This is an alternative algorithm to polygonise a grid.
@@ -109,7 +472,8 @@ void Mesh::RunAlgorithm(const double * const data, const double iso) {
       PolygoniseTri(grid,iso,triangles,0,6,1,4);
       PolygoniseTri(grid,iso,triangles,5,6,1,4);
 */
-size_t Mesh::PolygoniseTri(const double *data,size_t v0,size_t v1,size_t v2,size_t v3)
+template <typename Type>
+size_t Mesh::PolygoniseTri(const Type *data,size_t v0,size_t v1,size_t v2,size_t v3, TriangleArray &out) const
 {
 	/*
 		Determine which of the 16 cases we have given which vertices
@@ -117,14 +481,14 @@ size_t Mesh::PolygoniseTri(const double *data,size_t v0,size_t v1,size_t v2,size
 	*/
 	int triindex = 0;
 	size_t numtri = 0;
-	Point &p0 = p[v0];
-	Point &p1 = p[v1];
-	Point &p2 = p[v2];
-	Point &p3 = p[v3];
-	const double &d0 = data[v0];
-	const double &d1 = data[v1];
-	const double &d2 = data[v2];
-	const double &d3 = data[v3];
+	const Point &p0 = p[v0];
+	const Point &p1 = p[v1];
+	const Point &p2 = p[v2];
+	const Point &p3 = p[v3];
+	const double d0 = data[v0];
+	const double d1 = data[v1];
+	const double d2 = data[v2];
+	const double d3 = data[v3];
 
 	if (d0 < Iso_Value) triindex |= 1;
 	if (d1 < Iso_Value) triindex |= 2;
@@ -142,7 +506,7 @@ size_t Mesh::PolygoniseTri(const double *data,size_t v0,size_t v1,size_t v2,size
 		Point v1 = VertexInterpolation(p0,p1,d0,d1);
 		Point v2 = VertexInterpolation(p0,p2,d0,d2);
 		Point v3 = VertexInterpolation(p0,p3,d0,d3);
-		TriangleList.push_back(Triangle(v1, v2, v3));
+		out.push_back(Triangle(v1, v2, v3));
 		numtri++;
 		break;
 	}
@@ -151,7 +515,7 @@ size_t Mesh::PolygoniseTri(const double *data,size_t v0,size_t v1,size_t v2,size
 		Point v1 = VertexInterpolation(p1,p0,d1,d0);
 		Point v2 = VertexInterpolation(p1,p3,d1,d3);
 		Point v3 = VertexInterpolation(p1,p2,d1,d2);
-		TriangleList.push_back(Triangle(v1, v2, v3));
+		out.push_back(Triangle(v1, v2, v3));
 		numtri++;
 		break;
 	}
@@ -160,10 +524,10 @@ size_t Mesh::PolygoniseTri(const double *data,size_t v0,size_t v1,size_t v2,size
 		Point v1 = VertexInterpolation(p0,p3,d0,d3);
 		Point v2 = VertexInterpolation(p0,p2,d0,d2);
 		Point v3 = VertexInterpolation(p1,p3,d1,d3);
-		TriangleList.push_back(Triangle(v1, v2, v3));
+		out.push_back(Triangle(v1, v2, v3));
 		numtri++;
 		v1 = VertexInterpolation(p1,p2,d1,d2);
-		TriangleList.push_back(Triangle(v3, v1, v2));
+		out.push_back(Triangle(v3, v1, v2));
 		numtri++;
       break;
 	}
@@ -173,7 +537,7 @@ size_t Mesh::PolygoniseTri(const double *data,size_t v0,size_t v1,size_t v2,size
 		Point v2 = VertexInterpolation(p2,p1,d2,d1);
 		Point v3 = VertexInterpolation(p2,p3,d2,d3);
 
-		TriangleList.push_back(Triangle(v1, v2, v3));
+		out.push_back(Triangle(v1, v2, v3));
 		numtri++;
 		break;
 	}
@@ -182,10 +546,10 @@ size_t Mesh::PolygoniseTri(const double *data,size_t v0,size_t v1,size_t v2,size
 		Point v1 = VertexInterpolation(p0,p1,d0,d1);
 		Point v2 = VertexInterpolation(p2,p3,d2,d3);
 		Point v3 = VertexInterpolation(p0,p3,d0,d3);
-		TriangleList.push_back(Triangle(v1, v2, v3));
+		out.push_back(Triangle(v1, v2, v3));
 		numtri++;
 		v3 = VertexInterpolation(p1,p2,d1,d2);
-		TriangleList.push_back(Triangle(v1,v3,v2));
+		out.push_back(Triangle(v1,v3,v2));
 		numtri++;
 		break;
 	}
@@ -194,10 +558,10 @@ size_t Mesh::PolygoniseTri(const double *data,size_t v0,size_t v1,size_t v2,size
 		Point v1 = VertexInterpolation(p0,p1,d0,d1);
 		Point v2 = VertexInterpolation(p1,p3,d1,d3);
 		Point v3 = VertexInterpolation(p2,p3,d2,d3);
-		TriangleList.push_back(Triangle(v1, v3, v2));
+		out.push_back(Triangle(v1, v3, v2));
 		numtri++;
 		v2 = VertexInterpolation(p0,p2,d0,d2);
-		TriangleList.push_back(Triangle(v1, v2, v3));
+		out.push_back(Triangle(v1, v2, v3));
 		numtri++;
 		break;
    }
@@ -206,7 +570,7 @@ size_t Mesh::PolygoniseTri(const double *data,size_t v0,size_t v1,size_t v2,size
 		Point v1 = VertexInterpolation(p3,p0,d3,d0);
 		Point v2 = VertexInterpolation(p3,p2,d3,d2);
 		Point v3 = VertexInterpolation(p3,p1,d3,d1);
-		TriangleList.push_back(Triangle(v1, v2, v3));
+		out.push_back(Triangle(v1, v2, v3));
 		numtri++;
 		break;
 	}
@@ -241,7 +605,7 @@ size_t Mesh::PolygoniseTri(const double *data,size_t v0,size_t v1,size_t v2,size
  * \return Point with the coordinates of the cut.
  */
 Point Mesh::VertexInterpolation(const Point  &p1, const Point  &p2,
-								const double &v1, const double &v2 ) {
+								const double &v1, const double &v2 ) const {
 
 	if(((Iso_Value - v1)*(Iso_Value - v1)) < SMALL_NUM)	return p1;
 	if(((Iso_Value - v2)*(Iso_Value - v2)) < SMALL_NUM)	return p2;
@@ -277,7 +641,7 @@ void Mesh::SaveTriangleList(const char *filename) const {
 		//cout<<"Header is written."<<nr_elements<<" "<<nr_variables<<"\n";
 
 		//! Now we write all values for one point in one line and do this for every point.
-		for (list<Triangle>::const_iterator it = TriangleList.begin(); it != TriangleList.end(); it++) {
+		for (TriangleArray::const_iterator it = TriangleList.begin(); it != TriangleList.end(); it++) {
 			const Triangle &t = *it;
 			schreiben << t.v1.x << " ";
 			schreiben << t.v1.y << " ";
@@ -296,24 +660,42 @@ void Mesh::SaveTriangleList(const char *filename) const {
 	this->Save(filename);
 }
 
+/** \fn void Mesh::Save(const char *) const
+ * \brief Saves the isosurface as a surface mesh.
+ *
+ *	Files with the extension .ply, .stl or .vtp are written in binary (see
+ *	Grid::Save()), all others with SurfaceMesh::save_mesh().
+ */
 void Mesh::Save(const char *filename) const {
+	mystring ext;
+	if (filename) ext = mystring(filename).file_ext();
+	ext.lower();
+	if (ext == "stl") {
+		TriangleWriter out(filename, TriangleWriter::STL);
+		out.Write(TriangleList);
+		out.Close();
+		return;
+	}
+
 	mystring fn;
 	if(filename) fn = mystring(filename).file_base();
 	else   		 fn = "Tri_List_out";
-	SurfaceMesh out;
-	for (list<Triangle>::const_iterator it = TriangleList.begin(); it != TriangleList.end(); it++) {
+	vector<Point> soup;
+	soup.reserve(3*TriangleList.size());
+	for (TriangleArray::const_iterator it = TriangleList.begin(); it != TriangleList.end(); it++) {
 		const Triangle &t = *it;
-		size_t i1 = out.append_point_uniquely(t.v1);
-		size_t i2 = out.append_point_uniquely(t.v2);
-		size_t i3 = out.append_point_uniquely(t.v3);
-
-
-		out.append_face(Face(i1,i2,i3));
+		soup.push_back(t.v1);
+		soup.push_back(t.v2);
+		soup.push_back(t.v3);
 	}
+
+	SurfaceMesh out;
+	out.append_triangle_soup(soup); // merges identical vertices in parallel
 //	out.SmoothSurfaceLaplacianHC(1, .3, 0.);
 //	out.SmoothSurfaceLaplacian(1);
 
-	out.save_mesh(fn.c_str());
+	if (ext == "ply" or ext == "vtp") TriangleWriter::Save(out, filename);
+	else out.save_mesh(fn.c_str());
 }
 
 /** \fn void Mesh::LoadTriangleList(const char * const)
@@ -322,59 +704,38 @@ void Mesh::Save(const char *filename) const {
  *	This method will load triangles from a file with given name (and path).
  *	The result is at the end in TriangleList.<br>
  *	Previous triangles in TriangleList are cleared.<br>
- *	This method will return without doing something in the case the filename is
- *	empty, the file couldn't be opened the file is empty or an error ouccoured.
+ *	Binary STL and PLY files as well as the text format of SaveTriangleList()
+ *	are read (see LoadTriangles()). This method will return without doing
+ *	something in the case the filename is empty, errors are reported on cerr.
  *
  * \param filename: A reference to a string that contains name and path of the
  *				file that should be load.
  */
 void Mesh::LoadTriangleList(const char *filename) {
-	if (strlen(filename) == 0) return;
-
-	FILE *f = NULL;
-	f = fopen(filename, "r");//!< Try to open the file.
-
-	double vals[9];
-	for(size_t i = 0; i < 0; i++) vals[i] = 0.0;
-
-	if (! f) { //! Error and return if the file could not be opened.
-		cerr << "Could not open " <<filename<< endl;
-		return;
-	}
-
-	char test[1024] = "#";//!< Buffer variable.
-
-	/* Read a line from the file. If a NULL-pointer was returned by fgets either
-	 * the end of file is reached or an error occoured.
-	 */
-	if(NULL == fgets(test,1024, f)) {
-		if(0 != ferror(f)) {
-			// Here one could handle the error.
-			return;
-		}
-
-		if(0 != feof(f)) {
-			// Here one could handle the end-of-line.
-			return;
-		}
-
-		// Something unexpected has happened, so return.
-		return;
-	}
+	if (not filename or strlen(filename) == 0) return;
 
 	TriangleList.clear();
-
-	while (fgets(test,1024, f)) {
-		if (test[0] == '#') continue;//!< Skip comment and parameter lines
-		sscanf(test, "%lf %lf %lf %lf %lf %lf %lf %lf %lf\n", &vals[0], &vals[1], &vals[2],
-		       &vals[3], &vals[4], &vals[5],
-		       &vals[6], &vals[7], &vals[8]);//!< Read a line with data.
-
-		Triangle T( Point(vals[0], vals[1], vals[2]),
-		            Point(vals[3], vals[4], vals[5]),
-		            Point(vals[6], vals[7], vals[8]) );
-		TriangleList.push_back(T);
+	try {
+		LoadTriangles(filename, TriangleList);
+	} catch (myexception &e) {
+		cerr << e.what() << endl;
 	}
 }
 
+#define MCUBES_INSTANTIATE(T) \
+	template void Mesh::RunAlgorithm<T>(const T *, const double, const MinMaxBlocks *); \
+	template void Mesh::RunAlgorithm<T>(const T *, const double, SurfaceMesh &, const MinMaxBlocks *); \
+	template void Mesh::RunAlgorithm<T>(const T *, const double, TriangleWriter &, const MinMaxBlocks *); \
+	template void Mesh::RunAlgorithm<T>(const T *, size_t, const double, vector<SurfaceMesh> &);
+
+MCUBES_INSTANTIATE(double)
+MCUBES_INSTANTIATE(float)
+MCUBES_INSTANTIATE(int)
+MCUBES_INSTANTIATE(short)
+MCUBES_INSTANTIATE(unsigned short)
+MCUBES_INSTANTIATE(char)
+MCUBES_INSTANTIATE(unsigned char)
+
+#undef MCUBES_INSTANTIATE
+
 }
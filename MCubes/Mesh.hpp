@@ -1,4 +1,4 @@
-//		./MCubes/Grid.hpp
+//		./MCubes/Mesh.hpp
 //
 //		Copyright 2012 Stefan Fruhner <stefan.fruhner@gmail.com>
 //
@@ -22,10 +22,8 @@
 #ifndef _MESH_HPP
 #define _MESH_HPP
 
-/** \file MCubes/Grid.hpp
- *	\brief Declares a Grid object and the Grid_exception object.
- *
- *	This file declares Grid object and the Grid_exception object.
+/** \file MCubes/Mesh.hpp
+ *	\brief Declares the Mesh object (marching tetrahedra).
  */
 
 #include <iostream>
@@ -34,44 +32,51 @@
 #include <stdlib.h>
 #include <math.h>
 #include <list>
+#include <vector>
 #include <omp.h>
 
 #include "Triangle.hpp"
+#include "MinMaxBlocks.hpp"
+#include "TriangleIO.hpp"
 #include <mylibs/mymesh.hpp>
 
 #define SMALL_NUM  1.e-8	 // anything that avoids division overflow
 
 namespace MCubes {
 
-/** \class Grid
+/** \class Mesh
  *
  * \section Introduction
  *
- * The Grid class is the main class for performing the Marching Cubes algorithm. It inherits from
- * my_regular_grid to have the basic properties of a regular grid, such as the origin (as Point)
- * and pixel dimensions (also as Point). By this the spatial dimensions are set automatically in
- * the regular grid class and can be used directliy here.
+ * The Mesh class computes isosurfaces on unstructured tetrahedral meshes
+ * (marching tetrahedra). It inherits from SurfaceMesh, the data are given as
+ * one value per point of the mesh. All non-tetrahedral elements are ignored.
+ *
+ * The tetrahedra are processed in parallel. For indexed output the edges of
+ * the mesh are determined once (BuildTopology()) and reused for every
+ * following call, so a series of frames is processed without rebuilding the
+ * topology. Every intersected mesh edge yields exactly one vertex.
  *
  * \section Methods list
  *
  * Constructur and destructor:
- * Grid();
- * Grid(const Point pixel_dims, size_t max_x, size_t max_y, size_t max_z);
- * ~Grid();
+ * Mesh(const SurfaceMesh &mesh);
+ * ~Mesh();
  *
  * Calculation methods:
- * void ConstructCubeList();
- * void SetCubeValues(Cube &cube, const double *data);
- * void RunAlgorithm(const double *data, const double iso);
- * void Polygonise(Cube &cube);
- * void VertexInterpolation(Point &v,const Point &v1,const Point &v2, const double &value_one,const double &value_two);
- * void SaveTriangleList(const string* filename);
+ * void BuildTopology();
+ * void RunAlgorithm(const Type *data, const double iso, const MinMaxBlocks *blocks = NULL);
+ * void RunAlgorithm(const Type *data, const double iso, SurfaceMesh &out, const MinMaxBlocks *blocks = NULL);
+ * void RunAlgorithm(const Type *data, const double iso, TriangleWriter &out, const MinMaxBlocks *blocks = NULL);
+ * void RunAlgorithm(const Type *data, size_t nr_frames, const double iso, vector<SurfaceMesh> &out);
+ * size_t PolygoniseTri(const Type *data, size_t v0,size_t v1,size_t v2,size_t v3, TriangleArray &out) const;
+ * Point VertexInterpolation(const Point &p1,const Point &p2, const double &v1,const double &v2) const;
+ * void SaveTriangleList(const char *filename);
  * void LoadTriangleList(const char* filename);
- * size_t ijk_index(size_t i, size_t j, size_t k);
  */
 class Mesh : public SurfaceMesh {
 	public:
-		list<Triangle> TriangleList;
+		TriangleArray TriangleList;
 
 		// ******************************************
 		// *------ Constructors & Destructors ------*
@@ -83,10 +88,24 @@ class Mesh : public SurfaceMesh {
 		// *--------- Calculation methods ----------*
 		// ******************************************
 	private:
-		size_t PolygoniseTri(const double *data, size_t v0,size_t v1,size_t v2,size_t v3);
-		Point VertexInterpolation(const Point &p1,const Point &p2, const double &v1,const double &v2);
+		template <typename Type>
+		size_t PolygoniseTri(const Type *data, size_t v0,size_t v1,size_t v2,size_t v3, TriangleArray &out) const;
+		Point VertexInterpolation(const Point &p1,const Point &p2, const double &v1,const double &v2) const;
+		bool TopologyValid() const;
+		template <typename Type>
+		int TetIndex(const Type *data, size_t i) const;
+		void CheckBlocks(const MinMaxBlocks *blocks) const;
+		long BlockSize(const MinMaxBlocks *blocks) const;
 	public:
-		void RunAlgorithm(const double *data, const double iso);
+		void BuildTopology();
+		template <typename Type>
+		void RunAlgorithm(const Type *data, const double iso, const MinMaxBlocks *blocks = NULL);
+		template <typename Type>
+		void RunAlgorithm(const Type *data, const double iso, SurfaceMesh &out, const MinMaxBlocks *blocks = NULL);
+		template <typename Type>
+		void RunAlgorithm(const Type *data, const double iso, TriangleWriter &out, const MinMaxBlocks *blocks = NULL);
+		template <typename Type>
+		void RunAlgorithm(const Type *data, size_t nr_frames, const double iso, vector<SurfaceMesh> &out);
 		void SaveTriangleList(const char *filename = NULL) const __attribute_deprecated__;
 		void Save(const char *filename = NULL) const;
 		void LoadTriangleList(const char *filename);
@@ -94,12 +113,15 @@ class Mesh : public SurfaceMesh {
 		// ***************************************
 		// ----- Object Getting methods ---------*
 		// ***************************************
+		size_t edges() const {return edge_points.size() / 2;} //!< # of edges found by BuildTopology()
 
 	protected:
 		// ******************************************
 		// *---------------Variables ---------------*
 		// ******************************************
 		double Iso_Value;
+		vector<size_t> edge_points;	//!< two point indices (lower first) per edge
+		vector<size_t> tet_edges;	//!< six edge ids (01,02,03,12,13,23) per element
 };
 
 }
@@ -0,0 +1,160 @@
+//		./MCubes/MinMaxBlocks.cpp
+//
+//		This program is free software; you can redistribute it and/or modify
+//		it under the terms of the GNU General Public License as published by
+//		the Free Software Foundation; either version 2 of the License, or
+//		(at your option) any later version.
+//
+//		This program is distributed in the hope that it will be useful,
+//		but WITHOUT ANY WARRANTY; without even the implied warranty of
+//		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//		GNU General Public License for more details.
+//
+//		You should have received a copy of the GNU General Public License
+//		along with this program; if not, write to the Free Software
+//		Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//		MA 02110-1301, USA.
+
+#include <limits>
+#include "MinMaxBlocks.hpp"
+
+namespace MCubes {
+
+/** \fn MinMaxBlocks::MinMaxBlocks()
+ * Creates an empty set of blocks, call Build() before use.
+ */
+MinMaxBlocks::MinMaxBlocks()
+	: block(0), grid(true) {
+	dims[0] = dims[1] = dims[2] = 0;
+	nb[0]   = nb[1]   = nb[2]   = 0;
+}
+
+/** \fn void MinMaxBlocks::Build(const Type *, size_t, size_t, size_t, size_t)
+ * \brief Builds the bricks for a regular grid (x varies fastest).
+ *
+ *	Brick (bx,by,bz) holds the cubes bx*brick <= x < (bx+1)*brick (and so on).
+ *	Its minimum and maximum include the grid points on the upper faces, which
+ *	are shared with the neighbouring bricks.
+ *
+ * \param data: nx*ny*nz values
+ * \param nx, ny, nz: number of grid points
+ * \param brick: number of cubes along each edge of a brick
+ */
+template <typename Type>
+void MinMaxBlocks::Build(const Type * const data, size_t nx, size_t ny, size_t nz, size_t brick) {
+	grid  = true;
+	block = (brick > 0) ? brick : 1;
+	dims[0] = nx; dims[1] = ny; dims[2] = nz;
+	for (int a = 0; a < 3; a++)
+		nb[a] = (dims[a] > 1) ? (dims[a] - 2) / block + 1 : 0;
+
+	const long nr_blocks = (long) (nb[0] * nb[1] * nb[2]);
+	bmin.assign(nr_blocks,  numeric_limits<double>::max());
+	bmax.assign(nr_blocks, -numeric_limits<double>::max());
+
+	long b = 0;
+#ifdef _OPENMP
+	#pragma omp parallel for private(b) schedule(dynamic, 16)
+#endif
+	for (b = 0; b < nr_blocks; b++) {
+		const size_t bx = b % nb[0], by = (b / nb[0]) % nb[1], bz = b / (nb[0] * nb[1]);
+		const size_t x0 = bx * block, x1 = min(x0 + block, nx - 1);
+		const size_t y0 = by * block, y1 = min(y0 + block, ny - 1);
+		const size_t z0 = bz * block, z1 = min(z0 + block, nz - 1);
+		double lo = bmin[b], hi = bmax[b];
+		for (size_t z = z0; z <= z1; z++)
+			for (size_t y = y0; y <= y1; y++) {
+				const Type *row = data + (z * ny + y) * nx;
+				for (size_t x = x0; x <= x1; x++) {
+					if (row[x] < lo) lo = row[x];
+					if (row[x] > hi) hi = row[x];
+				}
+			}
+		bmin[b] = lo;
+		bmax[b] = hi;
+	}
+}
+
+/** \fn void MinMaxBlocks::Build(const Type *, const SurfaceMesh &, size_t)
+ * \brief Builds the blocks for an unstructured mesh.
+ *
+ *	Block b holds the elements b*block <= i < (b+1)*block. Only tetrahedra are
+ *	taken into account, blocks without tetrahedra are never active.
+ *
+ * \param data: one value per point of the mesh
+ * \param mesh: the mesh
+ * \param block_size: number of elements per block
+ */
+template <typename Type>
+void MinMaxBlocks::Build(const Type * const data, const SurfaceMesh &mesh, size_t block_size) {
+	grid  = false;
+	block = (block_size > 0) ? block_size : 1;
+	dims[0] = mesh.elements(); dims[1] = dims[2] = 0;
+	nb[0] = (dims[0] + block - 1) / block; nb[1] = nb[2] = 1;
+
+	const long nr_blocks = (long) nb[0];
+	bmin.assign(nr_blocks,  numeric_limits<double>::max());
+	bmax.assign(nr_blocks, -numeric_limits<double>::max());
+
+	long b = 0;
+#ifdef _OPENMP
+	#pragma omp parallel for private(b) schedule(static)
+#endif
+	for (b = 0; b < nr_blocks; b++) {
+		const size_t last = min((b + 1) * block, dims[0]);
+		double lo = bmin[b], hi = bmax[b];
+		for (size_t i = b * block; i < last; i++) {
+			const vector<int> &v = mesh.f[i].v;
+			if (v.size() != 4) continue;
+			for (int k = 0; k < 4; k++) {
+				const double val = data[v[k]];
+				if (val < lo) lo = val;
+				if (val > hi) hi = val;
+			}
+		}
+		bmin[b] = lo;
+		bmax[b] = hi;
+	}
+}
+
+/** \fn size_t MinMaxBlocks::ActiveBlocks(double, vector<size_t> &) const
+ * Lists all blocks which may contain cells cut by the isosurface.
+ * \return number of active blocks
+ */
+size_t MinMaxBlocks::ActiveBlocks(double iso, vector<size_t> &active) const {
+	active.clear();
+	for (size_t b = 0; b < Blocks(); b++)
+		if (Active(b, iso)) active.push_back(b);
+	return active.size();
+}
+
+/** \fn bool MinMaxBlocks::Matches(size_t, size_t, size_t) const
+ * Checks whether the blocks were built for a grid of the given size.
+ */
+bool MinMaxBlocks::Matches(size_t nx, size_t ny, size_t nz) const {
+	return grid and dims[0] == nx and dims[1] == ny and dims[2] == nz;
+}
+
+/** \fn bool MinMaxBlocks::Matches(const SurfaceMesh &) const
+ * Checks whether the blocks were built for a mesh with the same number of
+ * elements.
+ */
+bool MinMaxBlocks::Matches(const SurfaceMesh &mesh) const {
+	return (not grid) and dims[0] == mesh.elements();
+}
+
+#define MCUBES_INSTANTIATE(T) \
+	template void MinMaxBlocks::Build<T>(const T *, size_t, size_t, size_t, size_t); \
+	template void MinMaxBlocks::Build<T>(const T *, const SurfaceMesh &, size_t);
+
+MCUBES_INSTANTIATE(double)
+MCUBES_INSTANTIATE(float)
+MCUBES_INSTANTIATE(int)
+MCUBES_INSTANTIATE(short)
+MCUBES_INSTANTIATE(unsigned short)
+MCUBES_INSTANTIATE(char)
+MCUBES_INSTANTIATE(unsigned char)
+
+#undef MCUBES_INSTANTIATE
+
+}
@@ -0,0 +1,87 @@
+//		./MCubes/MinMaxBlocks.hpp
+//
+//		This program is free software; you can redistribute it and/or modify
+//		it under the terms of the GNU General Public License as published by
+//		the Free Software Foundation; either version 2 of the License, or
+//		(at your option) any later version.
+//
+//		This program is distributed in the hope that it will be useful,
+//		but WITHOUT ANY WARRANTY; without even the implied warranty of
+//		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//		GNU General Public License for more details.
+//
+//		You should have received a copy of the GNU General Public License
+//		along with this program; if not, write to the Free Software
+//		Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//		MA 02110-1301, USA.
+
+#ifndef _MINMAXBLOCKS_HPP
+#define _MINMAXBLOCKS_HPP
+
+/** \file MCubes/MinMaxBlocks.hpp
+ *	\brief Declares MinMaxBlocks, a min/max summary of a scalar field used
+ *	to skip empty space during isosurface extraction.
+ */
+
+#include <vector>
+#include <cstddef>
+
+#include <mylibs/mymesh.hpp>
+
+namespace MCubes {
+
+/** \class MinMaxBlocks
+ *
+ * The scalar field is divided into blocks: bricks of brick^3 cubes for a
+ * regular grid (MCubes::Grid) or runs of consecutive elements for an
+ * unstructured mesh (MCubes::Mesh). For every block the minimum and maximum
+ * of all values touched by its cells are stored. A cell can only be cut by the
+ * isosurface, if one of its values is below and one is not below the iso
+ * value, so whole blocks can be skipped with one comparison.
+ *
+ * The blocks are built once per frame and can be queried for any number of
+ * iso values:
+ *
+ \verbatim
+	MCubes::MinMaxBlocks blocks;
+	blocks.Build(data, nx, ny, nz);
+	grid.RunAlgorithm(data, iso1, mesh1, &blocks);
+	grid.RunAlgorithm(data, iso2, mesh2, &blocks);
+ \endverbatim
+ */
+class MinMaxBlocks {
+	public:
+		MinMaxBlocks();
+
+		template <typename Type>
+		void Build(const Type *data, size_t nx, size_t ny, size_t nz, size_t brick = 8);
+		template <typename Type>
+		void Build(const Type *data, const SurfaceMesh &mesh, size_t block = 4096);
+
+		size_t Blocks() const {return bmin.size();}		//!< total number of blocks
+		size_t BlockSize() const {return block;}		//!< cubes per brick edge or elements per block
+		size_t Bricks(int axis) const {return nb[axis];}	//!< number of bricks along an axis (grids only)
+
+		/// true, if block b may contain cells which are cut by the isosurface
+		bool Active(size_t b, double iso) const {
+			return (bmin[b] < iso) and not (bmax[b] < iso);
+		}
+		bool Active(size_t bx, size_t by, size_t bz, double iso) const {
+			return Active(bx + nb[0] * (by + nb[1] * bz), iso);
+		}
+		size_t ActiveBlocks(double iso, std::vector<size_t> &active) const;
+
+		bool Matches(size_t nx, size_t ny, size_t nz) const;
+		bool Matches(const SurfaceMesh &mesh) const;
+
+	private:
+		std::vector<double> bmin;	//!< minimum per block
+		std::vector<double> bmax;	//!< maximum per block
+		size_t block;				//!< edge length of a brick in cubes or elements per block
+		size_t dims[3];			//!< grid points per axis, dims[0] = elements for meshes
+		size_t nb[3];				//!< number of blocks per axis
+		bool   grid;				//!< built for a grid or for a mesh
+};
+
+}
+#endif
@@ -215,7 +215,7 @@ int drawGLScene() {
 	glEnd();				// Done Drawing Points
 
 	glBegin(GL_TRIANGLES);	// Drawing Using Triangles
-	list<MCubes::Triangle>::iterator it;
+	MCubes::TriangleArray::iterator it;
 	float const col_inc = 1.0/float(nr_triangles);
 	float col = col_inc;
 	for(it = gitter.TriangleList.begin(); it != gitter.TriangleList.end(); ++it) {
@@ -21,6 +21,7 @@
 #ifndef __TRIANGLE_HPP
 #define __TRIANGLE_HPP
 
+#include <vector>
 #include <mylibs/point.hpp>
 
 namespace MCubes {
@@ -46,6 +47,9 @@ class Triangle {
 		~Triangle() {};
 };
 
+//! Contiguous storage for the output of the isosurface algorithms.
+typedef std::vector<Triangle> TriangleArray;
+
 }
 
 #endif
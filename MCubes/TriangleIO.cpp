@@ -0,0 +1,492 @@
+//		./MCubes/TriangleIO.cpp
+//
+//		This program is free software; you can redistribute it and/or modify
+//		it under the terms of the GNU General Public License as published by
+//		the Free Software Foundation; either version 2 of the License, or
+//		(at your option) any later version.
+//
+//		This program is distributed in the hope that it will be useful,
+//		but WITHOUT ANY WARRANTY; without even the implied warranty of
+//		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//		GNU General Public License for more details.
+//
+//		You should have received a copy of the GNU General Public License
+//		along with this program; if not, write to the Free Software
+//		Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//		MA 02110-1301, USA.
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <stdint.h>
+
+#include "TriangleIO.hpp"
+#include <mylibs/mystring.hpp>
+#include <mylibs/myexception.hpp>
+
+namespace MCubes {
+
+/// true on big endian machines, all formats are written in little endian
+static bool big_endian() {
+	const uint16_t one = 1;
+	return *((const unsigned char *) &one) == 0;
+}
+
+/// converts value from little endian to the byte order of the machine (and back)
+template <typename T>
+static T little_endian(T value) {
+	if (big_endian()) {
+		unsigned char *b = (unsigned char *) &value;
+		std::reverse(b, b + sizeof(T));
+	}
+	return value;
+}
+
+static const size_t buffer_size = 1 << 20;
+
+/** \fn TriangleWriter::TriangleWriter()
+ * Creates a writer without a file, see Open().
+ */
+TriangleWriter::TriangleWriter()
+	: file(NULL), format(PLY), dbl(false), nr_triangles(0) {
+}
+
+/** \fn TriangleWriter::TriangleWriter(const char *, bool)
+ * Opens a file, the format is chosen by the extension (see FormatFromName()).
+ */
+TriangleWriter::TriangleWriter(const char *filename, bool double_precision)
+	: file(NULL), format(PLY), dbl(false), nr_triangles(0) {
+	Open(filename, FormatFromName(filename), double_precision);
+}
+
+/** \fn TriangleWriter::TriangleWriter(const char *, Format, bool)
+ * Opens a file in the given format.
+ */
+TriangleWriter::TriangleWriter(const char *filename, Format fmt, bool double_precision)
+	: file(NULL), format(PLY), dbl(false), nr_triangles(0) {
+	Open(filename, fmt, double_precision);
+}
+
+/** \fn TriangleWriter::~TriangleWriter()
+ * Closes the file if it is still open.
+ */
+TriangleWriter::~TriangleWriter() {
+	if (file) Close();
+}
+
+/** \fn TriangleWriter::Format TriangleWriter::FormatFromName(const char *)
+ * Determines the format from the extension of a filename (.ply, .stl, .vtp).
+ * Unknown extensions give PLY.
+ */
+TriangleWriter::Format TriangleWriter::FormatFromName(const char *filename) {
+	mystring ext = mystring(filename).file_ext();
+	ext.lower();
+	if (ext == "stl") return STL;
+	if (ext == "vtp") return VTP;
+	return PLY;
+}
+
+/** \fn void TriangleWriter::Open(const char *, Format, bool)
+ * \brief Opens a file for streaming triangles.
+ *
+ * \param filename: name of the file
+ * \param fmt: the format
+ * \param double_precision: write coordinates as double (PLY and VTP only,
+ * 							STL always uses float)
+ */
+void TriangleWriter::Open(const char *filename, Format fmt, bool double_precision) {
+	if (file) Close();
+	Begin(filename, fmt, double_precision);
+}
+
+void TriangleWriter::Begin(const char *filename, Format fmt, bool double_precision) {
+	file = fopen(filename, "wb");
+	if (not file)
+		throw myexception(string("MCubes::TriangleWriter: Could not open ") + filename + " for writing.");
+
+	format       = fmt;
+	dbl          = double_precision and (fmt != STL);
+	nr_triangles = 0;
+	buffer.clear();
+	buffer.reserve(buffer_size + 1024);
+	WriteHeader(0, 0);
+	Flush();
+}
+
+template <typename T>
+void TriangleWriter::Put(T value) {
+	value = little_endian(value);
+	const char *b = (const char *) &value;
+	buffer.insert(buffer.end(), b, b + sizeof(T));
+}
+
+void TriangleWriter::PutPoint(const Point &p) {
+	if (dbl) {
+		Put<double>(p.x);
+		Put<double>(p.y);
+		Put<double>(p.z);
+	}
+	else {
+		Put<float>(p.x);
+		Put<float>(p.y);
+		Put<float>(p.z);
+	}
+}
+
+void TriangleWriter::Flush() {
+	if (buffer.empty()) return;
+	if (fwrite(&buffer[0], 1, buffer.size(), file) != buffer.size())
+		throw myexception("MCubes::TriangleWriter: Write error.");
+	buffer.clear();
+}
+
+/** \fn void TriangleWriter::WriteHeader(size_t, size_t)
+ * Appends the header to the buffer. All numbers have a fixed width, so the
+ * header can be overwritten with the final numbers when the file is closed.
+ */
+void TriangleWriter::WriteHeader(size_t nr_points, size_t nr_faces) {
+	char text[2048];
+	const char *real = dbl ? "double" : "float";
+	const size_t point_bytes = 3 * nr_points * (dbl ? sizeof(double) : sizeof(float));
+
+	switch (format) {
+		case PLY:
+			snprintf(text, sizeof(text),
+				"ply\n"
+				"format binary_little_endian 1.0\n"
+				"comment mylibs MCubes\n"
+				"element vertex %020lu\n"
+				"property %s x\n"
+				"property %s y\n"
+				"property %s z\n"
+				"element face %020lu\n"
+				"property list uchar int vertex_indices\n"
+				"end_header\n",
+				(unsigned long) nr_points, real, real, real, (unsigned long) nr_faces);
+			buffer.insert(buffer.end(), text, text + strlen(text));
+			break;
+
+		case STL: {
+			memset(text, ' ', 80);
+			memcpy(text, "binary STL, mylibs MCubes", 25);
+			buffer.insert(buffer.end(), text, text + 80);
+			Put<uint32_t>((uint32_t) nr_faces);
+			break;
+		}
+
+		case VTP: {
+			const unsigned long conn_offset    = sizeof(uint64_t) + point_bytes;
+			const unsigned long offsets_offset = conn_offset + sizeof(uint64_t) + 3 * nr_faces * sizeof(int64_t);
+			snprintf(text, sizeof(text),
+				"<?xml version=\"1.0\"?>\n"
+				"<VTKFile type=\"PolyData\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\">\n"
+				"  <PolyData>\n"
+				"    <Piece NumberOfPoints=\"%020lu\" NumberOfVerts=\"0\" NumberOfLines=\"0\" NumberOfStrips=\"0\" NumberOfPolys=\"%020lu\">\n"
+				"      <Points>\n"
+				"        <DataArray type=\"%s\" NumberOfComponents=\"3\" format=\"appended\" offset=\"0\"/>\n"
+				"      </Points>\n"
+				"      <Polys>\n"
+				"        <DataArray type=\"Int64\" Name=\"connectivity\" format=\"appended\" offset=\"%020lu\"/>\n"
+				"        <DataArray type=\"Int64\" Name=\"offsets\" format=\"appended\" offset=\"%020lu\"/>\n"
+				"      </Polys>\n"
+				"    </Piece>\n"
+				"  </PolyData>\n"
+				"  <AppendedData encoding=\"raw\">\n"
+				"   _",
+				(unsigned long) nr_points, (unsigned long) nr_faces,
+				dbl ? "Float64" : "Float32", conn_offset, offsets_offset);
+			buffer.insert(buffer.end(), text, text + strlen(text));
+			Put<uint64_t>(point_bytes);
+			break;
+		}
+	}
+}
+
+/** \fn void TriangleWriter::Write(const Point &, const Point &, const Point &)
+ * Writes one triangle.
+ */
+void TriangleWriter::Write(const Point &a, const Point &b, const Point &c) {
+	if (format == STL) {
+		Point n = (a - b).cross(a - c);
+		const double len = n.norm();
+		if (len > 0.) n = n * (1. / len);
+		Put<float>(n.x); Put<float>(n.y); Put<float>(n.z);
+	}
+	PutPoint(a);
+	PutPoint(b);
+	PutPoint(c);
+	if (format == STL) Put<uint16_t>(0);
+
+	nr_triangles++;
+	if (buffer.size() >= buffer_size) Flush();
+}
+
+void TriangleWriter::Write(const Triangle &t) {
+	Write(t.v1, t.v2, t.v3);
+}
+
+void TriangleWriter::Write(const TriangleArray &triangles) {
+	for (TriangleArray::const_iterator it = triangles.begin(); it != triangles.end(); it++)
+		Write(it->v1, it->v2, it->v3);
+}
+
+/** \fn void TriangleWriter::WriteFaces(const vector<size_t> *, size_t)
+ * Writes the face section of PLY and VTP files. Without indices the faces
+ * are (0,1,2), (3,4,5), ... as for streamed triangles.
+ */
+void TriangleWriter::WriteFaces(const vector<size_t> *indices, size_t nr_faces) {
+	switch (format) {
+		case PLY:
+			for (size_t i = 0; i < nr_faces; i++) {
+				Put<unsigned char>(3);
+				for (size_t k = 3*i; k < 3*i + 3; k++)
+					Put<int32_t>((int32_t) (indices ? (*indices)[k] : k));
+				if (buffer.size() >= buffer_size) Flush();
+			}
+			break;
+		case VTP:
+			Put<uint64_t>(3 * nr_faces * sizeof(int64_t));
+			for (size_t k = 0; k < 3 * nr_faces; k++) {
+				Put<int64_t>((int64_t) (indices ? (*indices)[k] : k));
+				if (buffer.size() >= buffer_size) Flush();
+			}
+			Put<uint64_t>(nr_faces * sizeof(int64_t));
+			for (size_t i = 1; i <= nr_faces; i++) {
+				Put<int64_t>((int64_t) (3 * i));
+				if (buffer.size() >= buffer_size) Flush();
+			}
+			{
+				const char *tail = "\n  </AppendedData>\n</VTKFile>\n";
+				buffer.insert(buffer.end(), tail, tail + strlen(tail));
+			}
+			break;
+		case STL:
+			break;
+	}
+}
+
+/** \fn void TriangleWriter::Close()
+ * Writes the faces (PLY, VTP), fills in the final numbers of points and
+ * triangles and closes the file.
+ */
+void TriangleWriter::Close() {
+	if (not file) return;
+	WriteFaces(NULL, nr_triangles);
+	Flush();
+
+	fseek(file, 0, SEEK_SET);
+	WriteHeader(3 * nr_triangles, nr_triangles);
+	Flush();
+	fclose(file);
+	file = NULL;
+}
+
+/** \fn void TriangleWriter::Save(const SurfaceMesh &, const char *, bool)
+ * Saves the triangles of a mesh, the format is chosen by the extension.
+ */
+void TriangleWriter::Save(const SurfaceMesh &mesh, const char *filename, bool double_precision) {
+	Save(mesh, filename, FormatFromName(filename), double_precision);
+}
+
+/** \fn void TriangleWriter::Save(const SurfaceMesh &, const char *, Format, bool)
+ * \brief Saves the triangles of a mesh.
+ *
+ *	PLY and VTP files keep the points shared (indexed mesh), STL files store
+ *	every triangle separately. Elements that are not triangles are skipped.
+ */
+void TriangleWriter::Save(const SurfaceMesh &mesh, const char *filename, Format fmt, bool double_precision) {
+	vector<size_t> indices;
+	indices.reserve(3 * mesh.elements());
+	for (size_t i = 0; i < mesh.elements(); i++) {
+		const vector<int> &v = mesh.f[i].v;
+		if (v.size() != 3) continue;
+		indices.insert(indices.end(), v.begin(), v.end());
+	}
+	const size_t nr_faces = indices.size() / 3;
+
+	TriangleWriter out;
+	out.Begin(filename, fmt, double_precision);
+	if (fmt == STL) {
+		for (size_t k = 0; k < indices.size(); k += 3)
+			out.Write(mesh.p[indices[k]], mesh.p[indices[k+1]], mesh.p[indices[k+2]]);
+	}
+	else {
+		for (size_t i = 0; i < mesh.points(); i++) {
+			out.PutPoint(mesh.p[i]);
+			if (out.buffer.size() >= buffer_size) out.Flush();
+		}
+		out.WriteFaces(&indices, nr_faces);
+	}
+	out.Flush();
+
+	fseek(out.file, 0, SEEK_SET);
+	out.WriteHeader((fmt == STL) ? 3 * nr_faces : mesh.points(), nr_faces);
+	out.Flush();
+	fclose(out.file);
+	out.file = NULL;
+}
+
+/** \fn static void append_triangle(TriangleArray &, const Point &, const Point &, const Point &)
+ * Appends a triangle, degenerated triangles (no normal) are skipped.
+ */
+static void append_triangle(TriangleArray &triangles, const Point &a, const Point &b, const Point &c) {
+	try {
+		triangles.push_back(Triangle(a, b, c));
+	} catch (Point::Exception_ZeroLength &e) {}
+}
+
+/// reads a little endian value from a byte buffer
+template <typename T>
+static T get(const char *&pos) {
+	T value;
+	memcpy(&value, pos, sizeof(T));
+	pos += sizeof(T);
+	return little_endian(value);
+}
+
+static size_t load_stl(const vector<char> &content, TriangleArray &triangles) {
+	if (content.size() < 84)
+		throw myexception("MCubes::LoadTriangles: STL file too short.");
+	const char *pos = &content[80];
+	const size_t n = get<uint32_t>(pos);
+	if (content.size() < 84 + 50 * n)
+		throw myexception("MCubes::LoadTriangles: Only binary STL files are supported.");
+
+	triangles.reserve(triangles.size() + n);
+	for (size_t i = 0; i < n; i++) {
+		pos += 3 * sizeof(float); // normal
+		Point p[3];
+		for (int k = 0; k < 3; k++) {
+			p[k].x = get<float>(pos);
+			p[k].y = get<float>(pos);
+			p[k].z = get<float>(pos);
+		}
+		pos += sizeof(uint16_t);
+		append_triangle(triangles, p[0], p[1], p[2]);
+	}
+	return n;
+}
+
+static size_t load_ply(const vector<char> &content, TriangleArray &triangles) {
+	const char *end_header = strstr(&content[0], "end_header\n");
+	if (not end_header)
+		throw myexception("MCubes::LoadTriangles: No PLY header found.");
+	const string header(&content[0], end_header);
+
+	size_t nr_vertices = 0, nr_faces = 0;
+	bool   little = false, dbl = false, int_index = true;
+	int    nr_properties = 0;
+	const char *line = header.c_str();
+	while (line and *line) {
+		char word[64] = "", a[64] = "", b[64] = "", c[64] = "", d[64] = "";
+		const int n = sscanf(line, "%63s %63s %63s %63s %63s", word, a, b, c, d);
+		if (n >= 2 and not strcmp(word, "format"))
+			little = not strcmp(a, "binary_little_endian");
+		else if (n >= 3 and not strcmp(word, "element") and not strcmp(a, "vertex"))
+			nr_vertices = strtoul(b, NULL, 10);
+		else if (n >= 3 and not strcmp(word, "element") and not strcmp(a, "face"))
+			nr_faces = strtoul(b, NULL, 10);
+		else if (n >= 3 and not strcmp(word, "property") and strcmp(a, "list")) {
+			dbl = (not strcmp(a, "double") or not strcmp(a, "float64"));
+			nr_properties++;
+		}
+		else if (n >= 5 and not strcmp(word, "property") and not strcmp(a, "list"))
+			int_index = (strcmp(c, "short") and strcmp(c, "ushort") and strcmp(c, "int16") and strcmp(c, "uint16"));
+		line = strchr(line, '\n');
+		if (line) line++;
+	}
+	if (not little or nr_properties != 3 or not int_index)
+		throw myexception("MCubes::LoadTriangles: Only binary little endian PLY files with x,y,z vertices and int indices are supported.");
+
+	const size_t bytes = dbl ? sizeof(double) : sizeof(float);
+	const char *pos = end_header + strlen("end_header\n");
+	const char *end = &content[0] + content.size();
+	if ((size_t) (end - pos) < 3 * bytes * nr_vertices)
+		throw myexception("MCubes::LoadTriangles: PLY file too short.");
+
+	vector<Point> pts(nr_vertices);
+	for (size_t i = 0; i < nr_vertices; i++) {
+		pts[i].x = dbl ? get<double>(pos) : get<float>(pos);
+		pts[i].y = dbl ? get<double>(pos) : get<float>(pos);
+		pts[i].z = dbl ? get<double>(pos) : get<float>(pos);
+	}
+
+	triangles.reserve(triangles.size() + nr_faces);
+	for (size_t i = 0; i < nr_faces and pos < end; i++) {
+		const unsigned char n = get<unsigned char>(pos);
+		if ((size_t) (end - pos) < n * sizeof(int32_t)) break;
+		vector<uint32_t> v(n);
+		for (unsigned char k = 0; k < n; k++) v[k] = get<uint32_t>(pos);
+		for (unsigned char k = 2; k < n; k++) { // triangle fan
+			if (v[0] >= nr_vertices or v[k-1] >= nr_vertices or v[k] >= nr_vertices)
+				throw myexception("MCubes::LoadTriangles: Invalid vertex index in PLY file.");
+			append_triangle(triangles, pts[v[0]], pts[v[k-1]], pts[v[k]]);
+		}
+	}
+	return nr_faces;
+}
+
+static size_t load_text(vector<char> &content, TriangleArray &triangles) {
+	// split into lines, strtod must not run across line ends
+	std::replace(content.begin(), content.end(), '\n', '\0');
+
+	size_t n = 0;
+	const char *line = &content[0];
+	const char *end  = &content[0] + content.size() - 1;
+	line += strlen(line) + 1; // the first line is the header
+	for ( ; line < end; line += strlen(line) + 1) {
+		if (line[0] == '#') continue; //!< Skip comment and parameter lines
+		double vals[9];
+		const char *pos = line;
+		int k = 0;
+		for ( ; k < 9; k++) {
+			char *next;
+			vals[k] = strtod(pos, &next);
+			if (next == pos) break;
+			pos = next;
+		}
+		if (k < 9) continue; // empty or incomplete line
+
+		append_triangle(triangles,
+						Point(vals[0], vals[1], vals[2]),
+						Point(vals[3], vals[4], vals[5]),
+						Point(vals[6], vals[7], vals[8]));
+		n++;
+	}
+	return n;
+}
+
+/** \fn size_t LoadTriangles(const char *, TriangleArray &)
+ * \brief Loads triangles from a file.
+ *
+ *	The file is read at once. Binary STL (.stl) and binary little endian PLY
+ *	(.ply) files as written by TriangleWriter are supported as well as the
+ *	text format of Grid::SaveTriangleList() (nine coordinates per line).
+ *	Degenerated triangles are skipped. The triangles are appended.
+ *
+ * \param filename: name of the file
+ * \param triangles: receives the triangles
+ * \return number of triangles read from the file
+ */
+size_t LoadTriangles(const char *filename, TriangleArray &triangles) {
+	FILE *f = fopen(filename, "rb");
+	if (not f)
+		throw myexception(string("MCubes::LoadTriangles: Could not open ") + filename);
+
+	fseek(f, 0, SEEK_END);
+	const long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	vector<char> content((size > 0 ? size : 0) + 1, '\0'); // terminated by '\0'
+	const size_t nr_read = (size > 0) ? fread(&content[0], 1, size, f) : 0;
+	fclose(f);
+	if (nr_read != (size_t) (size > 0 ? size : 0))
+		throw myexception(string("MCubes::LoadTriangles: Could not read ") + filename);
+
+	mystring ext = mystring(filename).file_ext();
+	ext.lower();
+	if (ext == "stl") return load_stl(content, triangles);
+	if (ext == "ply") return load_ply(content, triangles);
+	return load_text(content, triangles);
+}
+
+}
@@ -0,0 +1,97 @@
+//		./MCubes/TriangleIO.hpp
+//
+//		This program is free software; you can redistribute it and/or modify
+//		it under the terms of the GNU General Public License as published by
+//		the Free Software Foundation; either version 2 of the License, or
+//		(at your option) any later version.
+//
+//		This program is distributed in the hope that it will be useful,
+//		but WITHOUT ANY WARRANTY; without even the implied warranty of
+//		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//		GNU General Public License for more details.
+//
+//		You should have received a copy of the GNU General Public License
+//		along with this program; if not, write to the Free Software
+//		Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//		MA 02110-1301, USA.
+
+#ifndef _TRIANGLEIO_HPP
+#define _TRIANGLEIO_HPP
+
+/** \file MCubes/TriangleIO.hpp
+ *	\brief Binary output of isosurfaces and surface meshes (PLY, STL, VTK)
+ *	and a fast loader for triangle lists.
+ */
+
+#include <cstdio>
+#include <vector>
+
+#include "Triangle.hpp"
+#include <mylibs/mymesh.hpp>
+
+namespace MCubes {
+
+/** \class TriangleWriter
+ *
+ * Streams triangles into a binary file. The triangles are written as soon as
+ * they are passed to Write() (through a buffer of about 1 MB), so an
+ * isosurface need not be held in memory completely. The numbers of points and
+ * triangles are written into the header when the file is closed.
+ *
+ * Formats (all little endian):
+ * - TriangleWriter::PLY: binary PLY, three points per triangle
+ * - TriangleWriter::STL: binary STL with facet normals
+ * - TriangleWriter::VTP: VTK XML PolyData with appended raw data
+ *
+ * Indexed meshes (points and faces) are written with Save().
+ *
+ \verbatim
+	MCubes::TriangleWriter out("iso_0001.ply");
+	grid.RunAlgorithm(data, iso, out);
+	out.Close();
+ \endverbatim
+ */
+class TriangleWriter {
+	public:
+		enum Format {PLY, STL, VTP};
+
+		TriangleWriter();
+		TriangleWriter(const char *filename, bool double_precision = false);
+		TriangleWriter(const char *filename, Format format, bool double_precision = false);
+		~TriangleWriter();
+
+		void Open(const char *filename, Format format, bool double_precision = false);
+		void Write(const Point &a, const Point &b, const Point &c);
+		void Write(const Triangle &t);
+		void Write(const TriangleArray &triangles);
+		void Close();
+
+		bool IsOpen() const {return file != NULL;}		//!< true while a file is open
+		size_t Triangles() const {return nr_triangles;}	//!< triangles written so far
+
+		static Format FormatFromName(const char *filename);
+		static void Save(const SurfaceMesh &mesh, const char *filename, bool double_precision = false);
+		static void Save(const SurfaceMesh &mesh, const char *filename, Format format, bool double_precision = false);
+
+	private:
+		FILE  *file;
+		Format format;
+		bool   dbl;					//!< write coordinates as double instead of float
+		size_t nr_triangles;
+		std::vector<char> buffer;	//!< output buffer
+
+		TriangleWriter(const TriangleWriter &);				// not copyable
+		TriangleWriter& operator=(const TriangleWriter &);
+
+		void Flush();
+		template <typename T> void Put(T value);
+		void PutPoint(const Point &p);
+		void WriteHeader(size_t nr_points, size_t nr_faces);
+		void WriteFaces(const std::vector<size_t> *indices, size_t nr_faces);
+		void Begin(const char *filename, Format format, bool double_precision);
+};
+
+size_t LoadTriangles(const char *filename, TriangleArray &triangles);
+
+}
+#endif
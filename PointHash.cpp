@@ -0,0 +1,213 @@
+//		./PointHash.cpp
+//
+//		This program is free software; you can redistribute it and/or modify
+//		it under the terms of the GNU General Public License as published by
+//		the Free Software Foundation; either version 2 of the License, or
+//		(at your option) any later version.
+//
+//		This program is distributed in the hope that it will be useful,
+//		but WITHOUT ANY WARRANTY; without even the implied warranty of
+//		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//		GNU General Public License for more details.
+//
+//		You should have received a copy of the GNU General Public License
+//		along with this program; if not, write to the Free Software
+//		Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//		MA 02110-1301, USA.
+
+#include <cmath>
+#include "PointHash.hpp"
+
+namespace mylibs {
+
+/** name: PointHash::PointHash
+ * \param tolerance: Two points are regarded as equal, if all of their
+ * 					 coordinates differ by less than tolerance.
+ */
+PointHash::PointHash(double tolerance)
+	: tol(tolerance), inv(1.), used(0) {
+	if (not (tol > 0.)) tol = SMALL_VALUE;
+	inv = 1./tol;
+	clear();
+}
+
+/** name: PointHash::clear
+ * Removes all points from the hash.
+ */
+void PointHash::clear(){
+	Cell empty = {0, 0, 0, npos};
+	table.assign(64, empty);
+	used = 0;
+	xyz.clear();
+	ids.clear();
+	next.clear();
+}
+
+/** name: PointHash::reserve
+ * Allocates enough memory for nr_points, so that no rehashing is needed
+ * while inserting them.
+ */
+void PointHash::reserve(size_t nr_points){
+	xyz.reserve(3*nr_points);
+	ids.reserve(nr_points);
+	next.reserve(nr_points);
+	size_t sz = table.size();
+	while (sz < 2*nr_points) sz *= 2;
+	if (sz > table.size()) rehash(sz);
+}
+
+/** name: PointHash::hash
+ * Mixes the integer coordinates of a cell into a hash value.
+ */
+size_t PointHash::hash(long long i, long long j, long long k){
+	unsigned long long h = (unsigned long long) i * 0x9E3779B97F4A7C15ULL;
+	h ^= (unsigned long long) j * 0xC2B2AE3D27D4EB4FULL;
+	h ^= (unsigned long long) k * 0x165667B19E3779F9ULL;
+	h ^= h >> 29;
+	return (size_t) h;
+}
+
+void PointHash::cell_of(const Point &pt, long long &i, long long &j, long long &k) const {
+	i = (long long) floor(pt.x * inv);
+	j = (long long) floor(pt.y * inv);
+	k = (long long) floor(pt.z * inv);
+}
+
+/** name: PointHash::slot
+ * Linear probing: returns the slot of cell (i,j,k) or the empty slot where
+ * it would have to be inserted.
+ */
+size_t PointHash::slot(long long i, long long j, long long k) const {
+	const size_t mask = table.size() - 1;
+	size_t s = hash(i,j,k) & mask;
+	while (table[s].head != npos){
+		const Cell &c = table[s];
+		if (c.i == i and c.j == j and c.k == k) break;
+		s = (s + 1) & mask;
+	}
+	return s;
+}
+
+void PointHash::rehash(size_t new_size){
+	vector<Cell> old;
+	old.swap(table);
+	Cell empty = {0, 0, 0, npos};
+	table.assign(new_size, empty);
+	for (size_t s = 0; s < old.size(); s++){
+		if (old[s].head == npos) continue;
+		table[slot(old[s].i, old[s].j, old[s].k)] = old[s];
+	}
+}
+
+/** name: PointHash::insert
+ * Inserts a point without checking for duplicates.
+ * \param pt : the point
+ * \param idx: the index of the point in the users list
+ * \return idx
+ */
+size_t PointHash::insert(const Point &pt, size_t idx){
+	if (2*(used+1) > table.size()) rehash(2*table.size());
+
+	long long i,j,k;
+	cell_of(pt, i, j, k);
+	size_t s = slot(i,j,k);
+	Cell &c = table[s];
+	if (c.head == npos){
+		c.i = i; c.j = j; c.k = k;
+		used++;
+	}
+	xyz.push_back(pt.x);
+	xyz.push_back(pt.y);
+	xyz.push_back(pt.z);
+	ids.push_back(idx);
+	next.push_back(c.head);
+	c.head = ids.size() - 1;
+	return idx;
+}
+
+/** name: PointHash::insert_uniquely
+ * Inserts a point only if no equal point is stored yet.
+ * \return The index of the equal point found or idx if pt was new.
+ */
+size_t PointHash::insert_uniquely(const Point &pt, size_t idx){
+	size_t found = find(pt);
+	if (found != npos) return found;
+	return insert(pt, idx);
+}
+
+/** name: PointHash::find
+ * Looks for a point within the tolerance. If several points match, the one
+ * that was inserted first is returned, so results do not depend on the
+ * layout of the table.
+ * \return index of the point or PointHash::npos
+ */
+size_t PointHash::find(const Point &pt) const {
+	long long i,j,k;
+	cell_of(pt, i, j, k);
+
+	size_t best = npos;
+	for (long long dk = -1; dk <= 1; dk++)
+	for (long long dj = -1; dj <= 1; dj++)
+	for (long long di = -1; di <= 1; di++){
+		const Cell &c = table[slot(i+di, j+dj, k+dk)];
+		for (size_t e = c.head; e != npos; e = next[e]){
+			if (e < best and equal(pt, e)) best = e;
+		}
+	}
+	return (best == npos) ? npos : ids[best];
+}
+
+/** name: PointHash::weld
+ * Merges equal vertices of a triangle soup (or any other list of points).
+ * Each point is merged into the first unique point it equals, unique points
+ * keep the order of their first occurrence, so the result is the same as
+ * appending all points one by one with SurfaceMesh::append_point_uniquely().
+ * Merging is not transitive: points further apart than the tolerance are
+ * never merged, even if they are connected by a chain of equal points.
+ *
+ * The search for the first equal point is done in parallel. Only points
+ * whose first equal point was merged itself are looked up again among the
+ * unique points.
+ *
+ * \param soup     : all vertices, e.g. three consecutive points per triangle
+ * \param unique   : receives the merged points
+ * \param remap    : receives for each point in soup the index in unique
+ * \param tolerance: see PointHash::PointHash()
+ * \return number of unique points
+ */
+size_t PointHash::weld(	const vector<Point> &soup,
+						vector<Point> &unique,
+						vector<size_t> &remap,
+						double tolerance){
+	const long n = (long) soup.size();
+	PointHash hash(tolerance);
+	hash.reserve(n);
+	for (long i = 0; i < n; i++) hash.insert(soup[i], i);
+
+	// each point points to the first point it equals (rep[i] <= i) ...
+	vector<size_t> rep(n);
+	#pragma omp parallel for schedule(static)
+	for (long i = 0; i < n; i++) rep[i] = hash.find(soup[i]);
+
+	// ... which is the answer if that one is unique, otherwise the point is
+	// compared with the unique points found so far
+	PointHash accepted(tolerance);
+	vector<char> is_unique(n, 0);
+	unique.clear();
+	remap.assign(n, 0);
+	for (long i = 0; i < n; i++){
+		size_t found = npos;
+		if (rep[i] != (size_t) i)
+			found = is_unique[rep[i]] ? remap[rep[i]] : accepted.find(soup[i]);
+		if (found == npos){
+			found = unique.size();
+			is_unique[i] = 1;
+			accepted.insert(soup[i], found);
+			unique.push_back(soup[i]);
+		}
+		remap[i] = found;
+	}
+	return unique.size();
+}
+
+} // end of namespace mylibs
@@ -0,0 +1,93 @@
+//		./PointHash.hpp
+//
+//		This program is free software; you can redistribute it and/or modify
+//		it under the terms of the GNU General Public License as published by
+//		the Free Software Foundation; either version 2 of the License, or
+//		(at your option) any later version.
+//
+//		This program is distributed in the hope that it will be useful,
+//		but WITHOUT ANY WARRANTY; without even the implied warranty of
+//		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//		GNU General Public License for more details.
+//
+//		You should have received a copy of the GNU General Public License
+//		along with this program; if not, write to the Free Software
+//		Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//		MA 02110-1301, USA.
+
+#ifndef POINTHASH_HPP
+#define POINTHASH_HPP
+
+/** \page mylibs
+ * \section sec_PointHash PointHash
+ * \subsection files Files
+ * PointHash.hpp, PointHash.cpp
+ * \subsection description Description
+ * Tolerance aware spatial hash for points. Space is divided into cubic cells
+ * with an edge length equal to the tolerance, so two points which are equal
+ * in the sense of Point::operator== (every coordinate differs by less than the
+ * tolerance) are either in the same or in directly neighbouring cells. A
+ * lookup therefore only has to probe 27 cells and costs O(1) on average.
+ *
+ * The class is used by SurfaceMesh::append_point_uniquely() and
+ * SurfaceMesh::index_of_point(). PointHash::weld() merges the vertices of a
+ * complete triangle soup (e.g. the output of marching cubes) in parallel.
+ */
+
+#include <vector>
+#include <cstddef>
+#include "point.hpp"
+
+namespace mylibs {
+
+class PointHash {
+	public:
+		static const size_t npos = (size_t) -1;	//!< returned if nothing was found
+
+		PointHash(double tolerance = SMALL_VALUE);
+
+		void clear();
+		void reserve(size_t nr_points);
+
+		size_t insert(const Point &pt, size_t idx);
+		size_t insert_uniquely(const Point &pt, size_t idx);
+		size_t find(const Point &pt) const;
+
+		size_t size() const {return ids.size();}	//!< number of inserted points
+		double tolerance() const {return tol;}		//!< the tolerance used for comparisons
+
+		static size_t weld(	const vector<Point> &soup,
+							vector<Point> &unique,
+							vector<size_t> &remap,
+							double tolerance = SMALL_VALUE);
+
+	private:
+		struct Cell {
+			long long i,j,k;	//!< integer coordinates of the cell
+			size_t head;		//!< first entry in the cell (npos if the slot is empty)
+		};
+
+		double tol;				//!< tolerance, equals the edge length of a cell
+		double inv;				//!< 1./tol
+		vector<Cell>   table;	//!< open addressing hash table of the cells
+		size_t         used;	//!< number of occupied slots in the table
+		vector<double> xyz;		//!< coordinates of all inserted points
+		vector<size_t> ids;		//!< user index of each inserted point
+		vector<size_t> next;	//!< next entry in the same cell
+
+		void cell_of(const Point &pt, long long &i, long long &j, long long &k) const;
+		size_t slot(long long i, long long j, long long k) const;
+		void rehash(size_t new_size);
+
+		static size_t hash(long long i, long long j, long long k);
+		bool equal(const Point &a, size_t entry) const {
+			const double *b = &xyz[3*entry];
+			return (a.x - b[0] < tol) && (b[0] - a.x < tol) &&
+				   (a.y - b[1] < tol) && (b[1] - a.y < tol) &&
+				   (a.z - b[2] < tol) && (b[2] - a.z < tol);
+		}
+};
+
+} // end of namespace mylibs
+
+#endif /* POINTHASH_HPP */
@@ -0,0 +1,101 @@
+//      benchmark_edge_filters.cpp
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+/** Smooths a noisy 256^3 phantom (nested spheres) with the Gaussian, the
+ * bilateral filter and the anisotropic diffusion of mymatrix and reports the
+ * time and the error against the noise-free phantom, within the regions and
+ * at the edges.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <omp.h>
+
+#include <mylibs/mymatrix.hpp>
+#include <mylibs/cmdline.hpp>
+
+using namespace std;
+using namespace mylibs;
+
+const int N = 256;
+
+/// nested spheres with the values 0, 100 and 200
+float phantom(int i, int j, int k){
+	const double r = sqrt(pow(i - N / 2., 2) + pow(j - N / 2., 2) + pow(k - N / 2., 2));
+	return (r < N * 0.2) ? 200.f : ((r < N * 0.4) ? 100.f : 0.f);
+}
+
+/// normal distributed noise (Box-Muller)
+double noise(double sigma){
+	const double u = (rand() + 1.) / (RAND_MAX + 2.), v = (rand() + 1.) / (RAND_MAX + 2.);
+	return sigma * sqrt(-2. * log(u)) * cos(2. * M_PI * v);
+}
+
+/// root mean square error within the regions and at the edges
+void report(const char *name, double seconds, mymatrix<float> &result, mymatrix<float> &clean, mymatrix<char> &edge){
+	double e[2] = {0., 0.};
+	size_t n[2] = {0, 0};
+	for (size_t i = 0; i < clean.items(); i++){
+		const double d = result[i] - clean[i];
+		e[(int) edge[i]] += d * d;
+		n[(int) edge[i]]++;
+	}
+	cout << " - " << name << ": " << seconds << " s, rms error regions " << sqrt(e[0] / n[0])
+		 << ", edges " << sqrt(e[1] / n[1]) << endl;
+}
+
+int main(int argc, char **argv){
+	(void) argc; (void) argv;
+	cmdline::section("Edge preserving filters on a noisy 256^3 phantom");
+	srand(42);
+
+	mymatrix<float> clean(N, N, N), noisy(N, N, N);
+	mymatrix<char>  edge(N, N, N);
+	for (int k = 0; k < N; k++)
+		for (int j = 0; j < N; j++)
+			for (int i = 0; i < N; i++){
+				const size_t idx = clean.index(i, j, k);
+				clean[idx] = phantom(i, j, k);
+				noisy[idx] = clean[idx] + noise(20.);
+			}
+	// pixels with a different value within a distance of 2
+	mymatrix<float> lo(clean), hi(clean);
+	lo.erode(2);
+	hi.dilate(2);
+	for (size_t i = 0; i < clean.items(); i++) edge[i] = (lo[i] != hi[i]) ? 1 : 0;
+
+	report("noisy", 0., noisy, clean, edge);
+
+	mymatrix<float> m(noisy);
+	double start = omp_get_wtime();
+	m.smooth_gaussian(1.5);
+	report("gaussian sigma 1.5", omp_get_wtime() - start, m, clean, edge);
+
+	mymatrix<float> b(noisy);
+	start = omp_get_wtime();
+	b.bilateral(2., 40.);
+	report("bilateral sigma_s 2, sigma_r 40", omp_get_wtime() - start, b, clean, edge);
+
+	mymatrix<float> d(noisy);
+	start = omp_get_wtime();
+	const int iterations = d.anisotropic_diffusion(100, 30., 0.05);
+	cout << "   (" << iterations << " iterations until the change is below 0.05)" << endl;
+	report("diffusion kappa 30", omp_get_wtime() - start, d, clean, edge);
+
+	return 0;
+}
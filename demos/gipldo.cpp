@@ -95,6 +95,20 @@ void save(const char* filename, mymatrix<T> &matrix){
 	return;
 }
 
+template <class T>
+void save(const char* filename, mymatrix_view<T> &view){
+	GIPL header(view);
+
+	header.set_image_type(view(0));
+	cout << "Image type is: " << header.image_type() << endl;
+
+	FILE *ou = header.save_header(string(filename));
+	view.save_to_file(ou);
+	cout << filename <<"(" << header.dims(0)<< "x" << header.dims(1)
+		 << "x"<<header.dims(2)<< "x"<<header.dims(3)<<") saved." << endl;
+	return;
+}
+
 /** name: copy_data
  * Copys a file starting at a certain position. Both files have to be open.
  * \param infile: The file to read.
@@ -130,16 +144,11 @@ void create_mask(vector<mystring> & files, mystring& outfile, const float thresh
 	my_regular_grid grid = img.grid();
 	mymatrix<T> matrix(grid);
 	matrix.read_data(files[0], img.header_size());	// read the data of the first image
-	mymatrix<char> *mask = matrix.mask(threshold);
+	mymatrix<char> mask(grid);
+	if (invert) mask = (matrix <= threshold);
+	else        mask = (matrix >  threshold);
 
-	if (invert){
-		for (unsigned long i = 0; i < mask->items(); i++){
-			mask->operator[](i) = (mask->operator[](i) == (char) 0) ? (char) 1 : (char) 0;
-		}
-	}
-
-	save(outfile.c_str(), *mask);
-	delete mask;
+	save(outfile.c_str(), mask);
 	return;
 }
 
@@ -161,16 +170,8 @@ void subtract_gipl_files(vector<mystring> & files, mystring& outfile, bool ignor
 	mymatrix<T> matrix2(g2);
 	matrix2.read_data(files[1], img2.header_size());	// read the data of the first image
 
-	if (ignore_zeros){
-		for (long i = 0; i < (long) matrix1.items(); i++){
-			if (( matrix1[i] == (T) 0 ) or ( matrix2[i] == (T) 0 )){
-				matrix1[i] = (T) 0;
-				matrix2[i] = (T) 0;
-			}
-		}
-	}
-
-	matrix1.sub(matrix2);
+	if (ignore_zeros) matrix1 = where(matrix1 == 0 || matrix2 == 0, 0, matrix1 - matrix2);
+	else              matrix1 -= matrix2;
 
 //				for (uint i = 0; i < matrix1.items(); i++){
 //					if (matrix1[i] > 0. and matrix2[i]> 0.)
@@ -265,25 +266,13 @@ void crop_image(vector<mystring> & files, mystring crop_coords, mystring outfile
 
 		mymatrix<T> original(grid);
 		original.read_data(files[i], img.header_size());
-		my_regular_grid copy_grid = grid;
-		copy_grid.dims(w[0], w[1], w[2], w[3]);
-
-		mymatrix<T> copy(copy_grid);
-		for (uint t = 0; t < w[3]; t++)
-		for (uint z = 0; z < w[2]; z++)
-		for (uint y = 0; y < w[1]; y++)
-		for (uint x = 0; x < w[0]; x++){
-			uint idx = copy.index(x,y,z,t);
-			uint ori = original.index(c[0]+x, c[1]+y,c[2]+z, c[3]+t);
-
-			copy[idx] = original[ori];
-		}
+		mymatrix_view<T> roi = original.crop(c[0], c[1], c[2], c[3], w[0], w[1], w[2], w[3]);
 
 		cout << basename << endl;
 
 		char fn[256];
 		sprintf(fn, "%s%04d.gipl", basename.c_str(), (int) cnt++);
-		save(fn, copy);
+		save(fn, roi);
 	}
 	delete[] c;
 	delete[] w;
@@ -333,9 +322,7 @@ void merge_gipl_files(vector<mystring> & files, mystring& outfile, bool rescale=
 		img.image_type(GIPL_U_CHAR);
 		mymatrix<unsigned char> ch_mat(img.dims(0), img.dims(1), img.dims(2), img.dims(3));
 
-		// copy values of the matrix
-		#pragma omp parallel for
-		for (long i = 0; i < (long) ch_mat.items(); i++) ch_mat[i] = (unsigned char) matrix[i];
+		ch_mat = convert<unsigned char>(matrix);	// values are rounded and clamped to [0:255]
 
 		uchar min, max;
 		ch_mat.minmax(min, max);
@@ -362,14 +349,15 @@ void merge_gipl_files(vector<mystring> & files, mystring& outfile, bool rescale=
 }
 
 template <class T>
-void pm3d(mystring &file, mystring& outfile, vector<int> slice_nr, mystring cutout_interval, bool png){
+void pm3d(mystring &file, mystring& outfile, vector<int> slice_nr, mystring cutout_interval, bool png, bool binary){
 	for (size_t slice = 0; slice < slice_nr.size(); slice++){
 		//cout << "slice_nr[slice] = "<< slice_nr[slice] << endl;
 		GIPL img(file);
-		my_regular_grid grid = img.grid();
+		if (slice_nr[slice] < 0 or slice_nr[slice] >= (int) img.dims(2))
+			throw mymatrix_exception(INVALID_SLICE_FAILURE);
 
-		mymatrix<T> matrix(grid);
-		matrix.read_data(file, img.header_size());	// read the data of the first image
+		mymatrix<T> matrix(img.dims(0), img.dims(1), 1, img.dims(3));
+		img.read_slices(matrix, slice_nr[slice], 1);	// read only the slice
 
 		if (not cutout_interval.empty()){
 			T min, max;
@@ -395,7 +383,7 @@ void pm3d(mystring &file, mystring& outfile, vector<int> slice_nr, mystring cuto
 		mystring fn  =  outfile.path_join(file.file_base(true) + "_"
 							+ toString(slice_nr[slice], 6) + ".dat");
 
-		matrix.save_to_pm3dmap(fn, slice_nr[slice], false, png);
+		matrix.save_to_pm3dmap(fn, 0, false, png, binary);
 	}
 }
 
@@ -555,6 +543,7 @@ int main(int argc, char **argv){
 	ini.register_param("rescale_to_256"		,"r", "If all data values should be rescaled to [0:256]", false, "action=merge");
 	ini.register_param("slice","s", "slice number ^= index of plane in z - direction", true, "action=pm3d");
 	ini.register_param("png",NULL, "Create png files instead of showing the data on the screen ", false, "action=pm3d");
+	ini.register_param("binary",NULL, "Write the data as gnuplot binary matrix instead of text", false, "action=pm3d");
 	ini.register_param("cutout_interval","c", "values out of this interval are set to 0", true, "action=pm3d");
 	ini.register_param("no-zero-diff","z", "Set value to zero where one of both gipl-files is zero.", false, "action=sub");
 	ini.register_param("threshold",NULL, "Threshold value for creating the mask. (Values >t will be set to 1, 0 otherwise.)", true, "action=mask");
@@ -874,17 +863,18 @@ int main(int argc, char **argv){
 		// interval of values which should be ignored, they will be set to 0 instead
 		mystring cutout_interval = ini.read("cutout_interval", mystring());
 		bool png = ini.exists("png");
+		bool binary = ini.exists("binary");
 
 		switch (img.image_type()){
-		case GIPL_BINARY:	pm3d<bool  >(files[i],outfile,slices,cutout_interval,png);break;	/* all the easy datatypes **/
-		case GIPL_CHAR:		pm3d<char  >(files[i],outfile,slices,cutout_interval,png);break;
-		case GIPL_U_CHAR:	pm3d<uchar >(files[i],outfile,slices,cutout_interval,png);break;
-		case GIPL_SHORT:	pm3d<short >(files[i],outfile,slices,cutout_interval,png);break;
-		case GIPL_U_SHORT:	pm3d<ushort>(files[i],outfile,slices,cutout_interval,png);break;
-		case GIPL_INT:		pm3d<int   >(files[i],outfile,slices,cutout_interval,png);break;
-		case GIPL_U_INT:	pm3d<uint  >(files[i],outfile,slices,cutout_interval,png);break;
-		case GIPL_FLOAT:	pm3d<float >(files[i],outfile,slices,cutout_interval,png);break;
-		case GIPL_DOUBLE:	pm3d<double>(files[i],outfile,slices,cutout_interval,png);break;
+		case GIPL_BINARY:	pm3d<bool  >(files[i],outfile,slices,cutout_interval,png,binary);break;	/* all the easy datatypes **/
+		case GIPL_CHAR:		pm3d<char  >(files[i],outfile,slices,cutout_interval,png,binary);break;
+		case GIPL_U_CHAR:	pm3d<uchar >(files[i],outfile,slices,cutout_interval,png,binary);break;
+		case GIPL_SHORT:	pm3d<short >(files[i],outfile,slices,cutout_interval,png,binary);break;
+		case GIPL_U_SHORT:	pm3d<ushort>(files[i],outfile,slices,cutout_interval,png,binary);break;
+		case GIPL_INT:		pm3d<int   >(files[i],outfile,slices,cutout_interval,png,binary);break;
+		case GIPL_U_INT:	pm3d<uint  >(files[i],outfile,slices,cutout_interval,png,binary);break;
+		case GIPL_FLOAT:	pm3d<float >(files[i],outfile,slices,cutout_interval,png,binary);break;
+		case GIPL_DOUBLE:	pm3d<double>(files[i],outfile,slices,cutout_interval,png,binary);break;
 		case GIPL_C_SHORT:
 		case GIPL_C_INT:
 		case GIPL_C_DOUBLE:
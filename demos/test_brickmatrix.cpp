@@ -0,0 +1,83 @@
+//      test_brickmatrix.cpp
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+/** Round trip between the linear layout of mymatrix and the bricked layout
+ * of mybrickmatrix: values, index()/index_1to4(), CoordsToIndex() and
+ * copy_to(), for volumes that are not multiples of the brick size.
+ */
+
+#include <iostream>
+#include <cstdlib>
+
+#include <mylibs/mymatrix.hpp>
+#include <mylibs/mybrickmatrix.hpp>
+#include <mylibs/cmdline.hpp>
+
+using namespace std;
+using namespace mylibs;
+
+int test(int nx, int ny, int nz, int nt, int brick_shift){
+	mymatrix<int> m(nx, ny, nz, nt);
+	m.pixdim(0.5, 1.5, 0.7, 2.);
+	m.origin(-3., 10., 0.25, 1.);
+	for (size_t i = 0; i < m.items(); i++) m[i] = rand();
+
+	mybrickmatrix<int> b(m, brick_shift);
+	int errors = 0;
+	for (int l = 0; l < nt; l++)
+		for (int k = 0; k < nz; k++)
+			for (int j = 0; j < ny; j++)
+				for (int i = 0; i < nx; i++){
+					const size_t idx = b.index(i, j, k, l);
+					if (b[idx] != m[m.index(i, j, k, l)]) errors++;
+
+					size_t x, y, z, t;
+					b.index_1to4(idx, x, y, z, t);
+					if ((int) x != i or (int) y != j or (int) z != k or (int) t != l) errors++;
+
+					// the centre of the voxel, so that rounding does not matter
+					Point p = b.coords(i, j, k, l);
+					p.x += 0.5 * b.pixdim(0);
+					p.y += 0.5 * b.pixdim(1);
+					p.z += 0.5 * b.pixdim(2);
+					p.t += 0.5 * b.pixdim(3);
+					if (b.CoordsToIndex(p) != idx) errors++;
+				}
+
+	mymatrix<int> back(nx, ny, nz, nt);
+	b.copy_to(back);
+	for (size_t i = 0; i < m.items(); i++) if (back[i] != m[i]) errors++;
+
+	cout << " - " << nx << "x" << ny << "x" << nz << "x" << nt << ", bricks of " << b.brick_size()
+		 << ": " << errors << " errors" << endl;
+	return errors;
+}
+
+int main(int argc, char **argv){
+	(void) argc; (void) argv;
+	cmdline::section("Round trip between mymatrix and mybrickmatrix");
+	srand(42);
+
+	int errors = 0;
+	errors += test(17, 13, 11, 1, 3);
+	errors += test(16, 16, 16, 1, 3);
+	errors += test(33,  9, 20, 2, 2);
+	errors += test(40, 21,  5, 1, 4);
+
+	cout << (errors ? "FAILED" : "PASSED") << endl;
+	return errors ? 1 : 0;
+}
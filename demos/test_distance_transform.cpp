@@ -0,0 +1,103 @@
+//      test_distance_transform.cpp
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+/** Compares the distance transforms of mymatrix (distance_map,
+ * signed_distance_map, feature_transform) with brute force on small random
+ * masks, with and without anisotropic pixel dimensions.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#include <mylibs/mymatrix.hpp>
+#include <mylibs/cmdline.hpp>
+
+using namespace std;
+using namespace mylibs;
+
+/// squared distance between two pixels of the matrix
+double dist2(mymatrix<char> &m, size_t a, size_t b, const double *h){
+	size_t x[4], y[4];
+	m.index_1to4(a, x[0], x[1], x[2], x[3]);
+	m.index_1to4(b, y[0], y[1], y[2], y[3]);
+	if (x[3] != y[3]) return INFINITY;
+	double d = 0.;
+	for (int i = 0; i < 3; i++){
+		const double e = ((double) x[i] - (double) y[i]) * h[i];
+		d += e * e;
+	}
+	return d;
+}
+
+/// nearest distance from pixel i to a pixel with (m != 0) == object
+double brute_force(mymatrix<char> &m, size_t i, bool object, const double *h){
+	double best = INFINITY;
+	for (size_t j = 0; j < m.items(); j++)
+		if ((m[j] != 0) == object) best = min(best, dist2(m, i, j, h));
+	return sqrt(best);
+}
+
+int test(int nx, int ny, int nz, int nt, double fill, bool anisotropic){
+	mymatrix<char> m(nx, ny, nz, nt);
+	const double aniso[3] = {1., 1.5, 0.7}, iso[3] = {1., 1., 1.};
+	const double *h = anisotropic ? aniso : iso;
+	m.pixdim(aniso[0], aniso[1], aniso[2], 1.);
+	for (size_t i = 0; i < m.items(); i++) m[i] = (rand() < fill * RAND_MAX) ? 1 : 0;
+
+	mymatrix<float> *d  = m.distance_map(0, anisotropic);
+	mymatrix<float> *sd = m.signed_distance_map(0, anisotropic);
+	mymatrix<int>   *ft = m.feature_transform(0, anisotropic);
+
+	int errors = 0;
+	for (size_t i = 0; i < m.items(); i++){
+		const double expect = brute_force(m, i, true, h);
+		const double signed_expect = (m[i] != 0) ? -brute_force(m, i, false, h) : expect;
+		if (isinf(expect) != isinf((*d)[i]) or (not isinf(expect) and fabs((*d)[i] - expect) > 1e-4)) errors++;
+		if (isinf(signed_expect) != isinf((*sd)[i]) or (not isinf(signed_expect) and fabs((*sd)[i] - signed_expect) > 1e-4)) errors++;
+		// ties are possible, so only the distance to the feature is checked
+		const int f = (*ft)[i];
+		if (isinf(expect)) { if (f != -1) errors++; }
+		else if (f < 0 or m[f] == 0 or fabs(sqrt(dist2(m, i, f, h)) - expect) > 1e-4) errors++;
+	}
+	delete d;
+	delete sd;
+	delete ft;
+
+	cout << " - " << nx << "x" << ny << "x" << nz << "x" << nt << ", fill " << fill
+		 << (anisotropic ? ", anisotropic" : "") << ": " << errors << " errors" << endl;
+	return errors;
+}
+
+int main(int argc, char **argv){
+	(void) argc; (void) argv;
+	cmdline::section("Distance transform of mymatrix against brute force");
+	srand(42);
+
+	int errors = 0;
+	errors += test(17, 13, 11, 1, 0.02, false);
+	errors += test(17, 13, 11, 1, 0.02, true);
+	errors += test(17, 13, 11, 1, 0.5,  true);
+	errors += test(16, 16,  1, 1, 0.05, true);
+	errors += test(23,  1,  1, 1, 0.1,  false);
+	errors += test( 9,  8,  7, 3, 0.01, true);
+	errors += test( 9,  8,  7, 1, 0.,   true);	// no objects at all
+
+	cout << (errors ? "FAILED" : "PASSED") << endl;
+	return errors ? 1 : 0;
+}
@@ -20,6 +20,15 @@
  */
 
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <errno.h>
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 #include "gipl.h"
 using namespace mylibs;
 
@@ -42,6 +51,21 @@ GIPL::GIPL(string fn){
 	read_header(fn);
 }
 
+/** name: GIPL::GIPL
+ * Constructor for a header in memory, e.g. a mapped file.
+ * \param buf   : the start of the file
+ * \param bytes : available bytes, at least GIPL_HEADER_SIZE
+ * \param fn    : file name (only informative)
+ */
+GIPL::GIPL(const uchar *buf, size_t bytes, string fn){
+	dimension_val = 0;
+	set_standard_header();
+
+	if (bytes < GIPL_HEADER_SIZE) throw GIPL_exception(NO_GIPL_HEADER_FAILURE);
+	filename = fn;
+	parse_header(buf);
+}
+
 GIPL::GIPL(my_regular_grid &grid){
 	set_standard_header();
 
@@ -91,102 +115,58 @@ void GIPL::pixdim(Point p){
 }
 
 bool GIPL::read_header(string fn){
-	FILE *ou = 0;
-	uchar buf[512];
-	int counter = 0; // counts how many bytes where read
+	uchar buf[GIPL_HEADER_SIZE];
 
-	ou = fopen(fn.c_str(),"r");
+	FILE *ou = fopen(fn.c_str(),"r");
 	if (!ou) throw GIPL_exception(GIPL_FILE_OPEN_FAILURE); // file error
 
-	for (int i=0;i<4;i++) {
-		if ( fread(buf,sizeof(ushort),1,ou) != 1 )
-			cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-		header.dims[i] = mk_unsigned_short(buf);
-		if (header.dims[i] == 0) header.dims[i]= 1; // ensure that no value is 0
-		counter += sizeof(ushort);
-	}
-	if ( fread(buf,sizeof(ushort),1,ou) != 1 )
+	if (fread(buf, GIPL_HEADER_SIZE, 1, ou) != 1)
 		cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-	header.image_type = mk_unsigned_short(buf);
-	counter += sizeof(ushort);
+	fclose(ou);
 
-	for (int i=0;i<4;i++) {
-		if (fread(buf,sizeof(float),1,ou) != 1)
-		cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-		header.pixdim[i] = mk_float(buf);
-		counter += sizeof(float);
-	}
+	filename = fn;
+	parse_header(buf);
+	return true;
+}
 
-	if (fread(header.infoline,80,1,ou) != 1)
-		cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-	counter += 80;
+/** name: GIPL::parse_header
+ * Decodes the 256 bytes of a GIPL header (big endian), e.g. read from a file
+ * or from a mapping.
+ * \param buf : GIPL_HEADER_SIZE bytes
+ */
+void GIPL::parse_header(const uchar *buf){
+	const uchar *p = buf;
 
-	for (int i=0;i<20;i++) {
-		if ( fread(buf,sizeof(float),1,ou) != 1)
-			cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-		header.matrix[i] = mk_float(buf);
-		counter += sizeof(float);
+	for (int i=0;i<4;i++, p += sizeof(ushort)) {
+		header.dims[i] = mk_unsigned_short(p);
+		if (header.dims[i] == 0) header.dims[i]= 1; // ensure that no value is 0
 	}
+	header.image_type = mk_unsigned_short(p);	p += sizeof(ushort);
 
-	if ( fread(buf,sizeof(char),1,ou) != 1)
-		cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-	header.flag1 = (char)buf[0];
-	counter += sizeof(char);
-	if( fread(buf,sizeof(char),1,ou) != 1)
-		cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-	
-	header.flag2 = (char)buf[0];
-	counter += sizeof(char);
+	for (int i=0;i<4;i++, p += sizeof(float)) header.pixdim[i] = mk_float(p);
 
-	if( fread(buf,sizeof(double),1,ou) != 1)
-		cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-	header.min = mk_double(buf);
-	counter += sizeof(double);
-	if( fread(buf,sizeof(double),1,ou) != 1)
-		cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-	header.max = mk_double(buf);
-	counter += sizeof(double);
+	memcpy(header.infoline, p, 80);				p += 80;
 
-	for (int i=0;i<4;i++) {
-		if( fread(buf,sizeof(double),1,ou) != 1)
-			cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");	
-		header.origin[i] = mk_double(buf);
-		counter += sizeof(double);
-	}
+	for (int i=0;i<20;i++, p += sizeof(float)) header.matrix[i] = mk_float(p);
 
-	if( fread(buf,sizeof(float),1,ou) != 1)
-		cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-	header.pixval_offset = mk_float(buf);
-	counter += sizeof(float);
-	if( fread(buf,sizeof(float),1,ou) != 1)
-		cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-	header.pixval_cal = mk_float(buf);
-	counter += sizeof(float);
+	header.flag1 = (char) *p++;
+	header.flag2 = (char) *p++;
+	header.min = mk_double(p);					p += sizeof(double);
+	header.max = mk_double(p);					p += sizeof(double);
 
-	if( fread(buf,sizeof(float),1,ou) != 1)
-		cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-	header.userdef1 = mk_float(buf);
-	counter += sizeof(float);
-	if( fread(buf,sizeof(float),1,ou) != 1)
-		cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-	header.userdef2 = mk_float(buf);
-	counter += sizeof(float);
+	for (int i=0;i<4;i++, p += sizeof(double)) header.origin[i] = mk_double(p);
 
-	if( fread(buf,sizeof(uint),1,ou) != 1)
-		cmdline::exit(string(__FILE__)+":"+toString(__LINE__) + "Did not read enough items.");
-	header.magic_number = mk_unsigned_int(buf);
-	counter += sizeof(uint);
+	header.pixval_offset = mk_float(p);			p += sizeof(float);
+	header.pixval_cal    = mk_float(p);			p += sizeof(float);
+	header.userdef1      = mk_float(p);			p += sizeof(float);
+	header.userdef2      = mk_float(p);			p += sizeof(float);
+	header.magic_number  = mk_unsigned_int(p);	p += sizeof(uint);
 
-	fclose(ou);
-	filename = fn;
-	header_size_val = counter;
+	header_size_val = p - buf;
 
 	set_dimension_data();
 
 	if (header.image_type == GIPL_NONE) throw GIPL_exception(NO_GIPL_HEADER_FAILURE);
-
-
-	return true;
 }
 
 /** index
@@ -261,19 +241,19 @@ void GIPL::set_dimension_data(){
 //	}
 }
 
-ushort GIPL::mk_unsigned_short(uchar *ptr) {
+ushort GIPL::mk_unsigned_short(const uchar *ptr) {
 	return (ushort)0x0100*(ushort)ptr[0]+
 		   (ushort)0x0001*(ushort)ptr[1];
 }
 
-uint GIPL::mk_unsigned_int(uchar *ptr) {
+uint GIPL::mk_unsigned_int(const uchar *ptr) {
 	return (uint)0x01000000*(uint)ptr[0]+
 		   (uint)0x00010000*(uint)ptr[1]+
 		   (uint)0x00000100*(uint)ptr[2]+
 		   (uint)0x00000001*(uint)ptr[3];
 }
 
-float GIPL::mk_float(uchar *ptr) {
+float GIPL::mk_float(const uchar *ptr) {
 	float tmp;
 	uchar pt[4];
 	pt[0] = ptr[3];
@@ -284,7 +264,7 @@ float GIPL::mk_float(uchar *ptr) {
 	return tmp;
 }
 
-double GIPL::mk_double(uchar *ptr) {
+double GIPL::mk_double(const uchar *ptr) {
 	double tmp;
 	uchar pt[8];
 	pt[0] = ptr[7];
@@ -517,3 +497,244 @@ size_t GIPL::size_of_item(){
 	}
 }
 
+
+/** name: GIPL::type_id
+ * \return the typeid of the image type
+ */
+const type_info& GIPL::type_id(){
+	switch (header.image_type){
+		case GIPL_BINARY	:  return typeid(bool);
+		case GIPL_CHAR 		:  return typeid(char);
+		case GIPL_U_CHAR 	:  return typeid(uchar);
+		case GIPL_SHORT		:  return typeid(short);
+		case GIPL_U_SHORT	:  return typeid(ushort);
+		case GIPL_INT		:  return typeid(int);
+		case GIPL_U_INT		:  return typeid(uint);
+		case GIPL_FLOAT		:  return typeid(float);
+		case GIPL_DOUBLE	:  return typeid(double);
+		default: throw GIPL_exception(GIPL_NO_TYPEID);
+	}
+}
+
+/** name: GIPL::open_data
+ * Opens the file the header was read from for read_rows().
+ * \return the file descriptor
+ */
+int GIPL::open_data(){
+	const int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) throw GIPL_exception(GIPL_FILE_OPEN_FAILURE);
+	return fd;
+}
+
+void GIPL::close_data(int fd){
+	close(fd);
+}
+
+/** name: gipl_pread
+ * pread() which continues after partial reads.
+ * \return false at the end of the file or on errors
+ */
+static bool gipl_pread(int fd, uchar *buf, size_t bytes, size_t offset){
+	while (bytes > 0){
+		const ssize_t r = pread(fd, buf, bytes, offset);
+		if (r < 0 and errno == EINTR) continue;
+		if (r <= 0) return false;
+		buf += r;
+		bytes -= r;
+		offset += r;
+	}
+	return true;
+}
+
+/** name: GIPL::read_rows
+ * Reads rows of row_bytes, which are stride bytes apart in the file, into
+ * dst[0] ... dst[rows-1]. The rows are gathered with one preadv() per batch
+ * of rows, the gaps in between go into a scratch buffer. Rows with gaps larger
+ * than 64 kB are read one by one, so the gaps are never read.
+ * Safe to be called in parallel on one file descriptor.
+ * \param offset : file offset of the first row
+ * \return false, if the file ends too early
+ */
+bool GIPL::read_rows(int fd, size_t offset, size_t row_bytes, size_t stride, size_t rows, uchar *const *dst){
+	const size_t gap = stride - row_bytes;
+	if (gap > (1 << 16)){
+		for (size_t j = 0; j < rows; j++)
+			if (not gipl_pread(fd, dst[j], row_bytes, offset + j * stride)) return false;
+		return true;
+	}
+
+	const size_t max_iov = 1024;		// UIO_MAXIOV on linux
+	vector<uchar> scratch(gap);
+	vector<struct iovec> iov;
+	iov.reserve(max_iov);
+	size_t first = 0, total = 0;		// first row and bytes of the current batch
+	for (size_t j = 0; j < rows; j++){
+		if (not iov.empty() and gap == 0 and (uchar*) iov.back().iov_base + iov.back().iov_len == dst[j])
+			iov.back().iov_len += row_bytes;		// contiguous in memory too
+		else {
+			if (j > first and gap > 0){
+				struct iovec g = {&scratch[0], gap};
+				iov.push_back(g);
+				total += gap;
+			}
+			struct iovec r = {dst[j], row_bytes};
+			iov.push_back(r);
+		}
+		total += row_bytes;
+		if (j + 1 < rows and iov.size() + 2 <= max_iov) continue;
+
+		ssize_t r;
+		do r = preadv(fd, &iov[0], iov.size(), offset + first * stride);
+		while (r < 0 and errno == EINTR);
+		if (r != (ssize_t) total)	// partial read, try row by row
+			for (size_t i = first; i <= j; i++)
+				if (not gipl_pread(fd, dst[i], row_bytes, offset + i * stride)) return false;
+		iov.clear();
+		first = j + 1;
+		total = 0;
+	}
+	return true;
+}
+
+/** name: gipl_swap_needed
+ * \return true, if data in the given byte order has to be swapped on this host
+ */
+bool gipl_swap_needed(gipl_byte_order order){
+	const ushort one = 1;
+	const bool host_little = (*(const uchar*) &one == 1);
+	switch (order){
+		case GIPL_BIG_ENDIAN_DATA:		return host_little;
+		case GIPL_LITTLE_ENDIAN_DATA:	return not host_little;
+		default:						return false;
+	}
+}
+
+/** name: gipl_swap_items
+ * Copies items from src to dst and reverses the byte order of each item, 32
+ * or 16 bytes per shuffle if available. dst may be src.
+ */
+void gipl_swap_items(void *dst_v, const void *src_v, size_t items, size_t item_size){
+	uchar       *dst = (uchar*) dst_v;
+	const uchar *src = (const uchar*) src_v;
+	const size_t bytes = items * item_size;
+	size_t i = 0;
+	if (item_size < 2){
+		if (dst != src) memcpy(dst, src, bytes);
+		return;
+	}
+#if defined(__SSSE3__) || defined(__AVX2__)
+	if (16 % item_size == 0){	// whole items in each 16 byte lane
+		char order[32];			// byte j of a lane comes from byte order[j]
+		for (int j = 0; j < 32; j++)
+			order[j] = (char) (((j % 16) / item_size) * item_size + item_size - 1 - (j % item_size));
+#ifdef __AVX2__
+		const __m256i mask32 = _mm256_loadu_si256((const __m256i*) order);
+		for (; i + 32 <= bytes; i += 32){
+			const __m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+			_mm256_storeu_si256((__m256i*) (dst + i), _mm256_shuffle_epi8(v, mask32));
+		}
+#endif
+		const __m128i mask16 = _mm_loadu_si128((const __m128i*) order);
+		for (; i + 16 <= bytes; i += 16){
+			const __m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+			_mm_storeu_si128((__m128i*) (dst + i), _mm_shuffle_epi8(v, mask16));
+		}
+	}
+#endif
+	switch (item_size){
+		case 2:
+			for (; i < bytes; i += 2){
+				uint16_t v; memcpy(&v, src + i, 2); v = __builtin_bswap16(v); memcpy(dst + i, &v, 2);
+			}
+			break;
+		case 4:
+			for (; i < bytes; i += 4){
+				uint32_t v; memcpy(&v, src + i, 4); v = __builtin_bswap32(v); memcpy(dst + i, &v, 4);
+			}
+			break;
+		case 8:
+			for (; i < bytes; i += 8){
+				uint64_t v; memcpy(&v, src + i, 8); v = __builtin_bswap64(v); memcpy(dst + i, &v, 8);
+			}
+			break;
+		default:	// any other size, byte by byte
+			for (; i < bytes; i += item_size)
+				for (size_t a = 0, b = item_size - 1; a < b; a++, b--){
+					const uchar t = src[i + a];
+					dst[i + a] = src[i + b];
+					dst[i + b] = t;
+				}
+	}
+}
+
+/** name: gipl_copy_items
+ * Copies items from src to dst in parallel (chunks of 1 MB), and reverses
+ * the byte order of each item if swap is set. dst may be src (in place swap).
+ * \param items     : number of items
+ * \param item_size : bytes per item
+ */
+void gipl_copy_items(void *dst, const void *src, size_t items, size_t item_size, bool swap){
+	if (item_size < 2) swap = false;
+	if (not swap and dst == src) return;
+	const size_t bytes = items * item_size;
+	const size_t chunk = item_size << 20;	// whole items and whole vectors
+	const long   chunks = (bytes + chunk - 1) / chunk;
+	uchar       *d = (uchar*) dst;
+	const uchar *s = (const uchar*) src;
+	#pragma omp parallel for
+	for (long c = 0; c < chunks; c++){
+		const size_t first = c * chunk, n = std::min(chunk, bytes - first);
+		if (swap) gipl_swap_items(d + first, s + first, n / item_size, item_size);
+		else memcpy(d + first, s + first, n);
+	}
+}
+
+/** name: GIPL_mapped::GIPL_mapped
+ * Maps a GIPL file (read only, private) and parses its header.
+ * \param fn    : the file
+ * \param order : byte order of the data in the file
+ */
+GIPL_mapped::GIPL_mapped(string fn, gipl_byte_order order) :
+	map_val(0), bytes_val(0), swap_val(gipl_swap_needed(order)), converted(false){
+	const int fd = open(fn.c_str(), O_RDONLY);
+	if (fd < 0) throw GIPL_exception(GIPL_FILE_OPEN_FAILURE);
+	struct stat st;
+	if (fstat(fd, &st) != 0){
+		close(fd);
+		throw GIPL_exception(GIPL_FILE_OPEN_FAILURE);
+	}
+	bytes_val = st.st_size;
+	if (bytes_val < GIPL_HEADER_SIZE){
+		close(fd);
+		throw GIPL_exception(NO_GIPL_HEADER_FAILURE);
+	}
+	// writable copy-on-write pages, so views can be changed (and swapped)
+	void *m = mmap(0, bytes_val, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);			// the mapping keeps the file open
+	if (m == MAP_FAILED) throw GIPL_exception(GIPL_FILE_OPEN_FAILURE);
+	map_val = (uchar*) m;
+
+	try {
+		gipl_val = GIPL(map_val, bytes_val, fn);
+	} catch (...) {
+		munmap(map_val, bytes_val);
+		throw;
+	}
+}
+
+GIPL_mapped::~GIPL_mapped(){
+	if (map_val) munmap(map_val, bytes_val);
+}
+
+/** name: GIPL_mapped::checked_items
+ * \param sequential : the data will be read once from start to end
+ * \return the number of items, after checking the item size and that the
+ *         file is long enough
+ */
+size_t GIPL_mapped::checked_items(size_t item_size, bool sequential){
+	if (gipl_val.size_of_item() != item_size) throw GIPL_exception(GIPL_TYPE_ERROR);
+	const size_t n = (size_t) gipl_val.dims(0) * gipl_val.dims(1) * gipl_val.dims(2) * gipl_val.dims(3);
+	if (n * item_size > payload_bytes()) throw GIPL_exception(GIPL_DATA_SIZE_FAILURE);
+	if (sequential) madvise(map_val, bytes_val, MADV_SEQUENTIAL);
+	return n;
+}
@@ -33,6 +33,7 @@
 #include <map>
 #include "point.hpp"
 #include "my_regular_grid.hpp"
+#include "mymatrix.hpp"
 #include "cmdline.hpp"
 #include <error.h>
 
@@ -50,6 +51,7 @@ typedef unsigned short ushort;
 
 #define GIPL_MAGIC_NUMBER1 (0xefffe9b0)
 #define GIPL_MAGIC_NUMBER2 (0x2ae389b8)
+#define GIPL_HEADER_SIZE	256			// bytes, the data follows the header
 
 /*  IMAGE TYPE DEFINITIONS  */
 #define GIPL_NONE			  0
@@ -83,7 +85,7 @@ typedef unsigned short ushort;
 
 enum GIPL_exceptions {NO_GIPL_HEADER_FAILURE, NO_GIPL_TYPE_FAILURE,
 						GIPL_FILE_OPEN_FAILURE, GIPL_NO_TYPEID, GIPL_TYPE_ERROR,
-						GIPL_USERDEF_ERROR};
+						GIPL_USERDEF_ERROR, GIPL_DATA_SIZE_FAILURE};
 
 class GIPL_exception : public exception {
 
@@ -105,12 +107,22 @@ class GIPL_exception : public exception {
 					return "GIPL: Cannot handle data type."; break;
 				case GIPL_USERDEF_ERROR:
 					return "GIPL: For image type GIPL_USERDEF (255) not possible."; break;
+				case GIPL_DATA_SIZE_FAILURE:
+					return "GIPL: The file contains less data than the header describes."; break;
 				default:
 					return "GIPL: Unclarified exception."; break;
 			}
 		};
 };
 
+/** \enum gipl_byte_order
+ * Byte order of the voxel data. The header of a GIPL file is always big
+ * endian. The data written by this library (GIPL::save_header() followed by
+ * mymatrix::save_to_file()) and read by mymatrix::read_data() is in the
+ * order of the host, GIPL files of other programs are mostly big endian.
+ */
+enum gipl_byte_order {GIPL_HOST_ORDER, GIPL_BIG_ENDIAN_DATA, GIPL_LITTLE_ENDIAN_DATA};
+
 /** \struct giplheader
  *
  * 	\brief Saves everything, that is contained in the header of a GIPL file.
@@ -154,22 +166,33 @@ class GIPL{
 
 		void	set_standard_header();
 		bool	read_header(string fn);
+		void	parse_header(const uchar *buf);
 
 		void 	set_dimension_data();
 
-		ushort	mk_unsigned_short(uchar *ptr);
-		uint 	mk_unsigned_int(uchar *ptr);
-		float	mk_float(uchar *ptr);
-		double	mk_double(uchar *ptr);
+		ushort	mk_unsigned_short(const uchar *ptr);
+		uint 	mk_unsigned_int(const uchar *ptr);
+		float	mk_float(const uchar *ptr);
+		double	mk_double(const uchar *ptr);
 		void 	mk_wr_unsigned_short(ushort value, uchar *ptr);
 		void	mk_wr_unsigned_int(uint value, uchar *ptr);
 		void	mk_wr_float(float value, uchar *ptr);
 		void	mk_wr_double(double value, uchar *ptr);
 
+		int		open_data();
+		static void close_data(int fd);
+		static bool read_rows(int fd, size_t offset, size_t row_bytes, size_t stride,
+							  size_t rows, uchar *const *dst);
+		template <class In, class Type>
+		static void convert_from(const uchar *raw, Type *out, size_t n);
+		template <class Type>
+		void	convert_items(const uchar *raw, Type *out, size_t n);
+
 	public:
 		GIPL();
 		GIPL(string fn);
 		GIPL(my_regular_grid &grid);
+		GIPL(const uchar *buf, size_t bytes, string fn="");
 
 		my_regular_grid grid(){
 			my_regular_grid g(dims(0), dims(1), dims(2), dims(3));
@@ -258,6 +281,20 @@ class GIPL{
 		 **/
 		size_t size_of_item();
 
+		const type_info& type_id();
+
+		// partial reads of the data, see GIPL::read_roi()
+		template <class Type>
+		void read_roi(mymatrix<Type> &m, size_t x0, size_t y0, size_t z0, size_t nx, size_t ny, size_t nz,
+					  gipl_byte_order order=GIPL_HOST_ORDER);
+		template <class Type>
+		mymatrix<Type>* read_roi(size_t x0, size_t y0, size_t z0, size_t nx, size_t ny, size_t nz,
+								 gipl_byte_order order=GIPL_HOST_ORDER);
+		template <class Type>
+		void read_slices(mymatrix<Type> &m, size_t z0, size_t nz, gipl_byte_order order=GIPL_HOST_ORDER);
+		template <class Type>
+		mymatrix<Type>* read_slices(size_t z0, size_t nz, gipl_byte_order order=GIPL_HOST_ORDER);
+
 		/** name: GIPL::num_data_arrays
 		 * If one wants to store different data using GIPL, one can append
 		 * other data to the gipl files. These data must be of the same type
@@ -283,6 +320,59 @@ class GIPL{
 		void set_image_type(T t);
 };
 
+bool gipl_swap_needed(gipl_byte_order order);
+void gipl_swap_items(void *dst, const void *src, size_t items, size_t item_size);
+void gipl_copy_items(void *dst, const void *src, size_t items, size_t item_size, bool swap);
+
+/**
+ * \class GIPL_mapped
+ * \brief A GIPL file mapped into memory.
+ *
+ * The header is parsed from the mapping, the voxels are not read until they
+ * are used. If the byte order of the data is that of the host, view() gives
+ * the voxels without copying anything (the pages are loaded on first access),
+ * otherwise the data is converted once in place. read() copies the voxels
+ * into a matrix, swapping the bytes on the way if needed. Both run in
+ * parallel over chunks of the file, with SSSE3/AVX2 shuffles when compiled
+ * with -mssse3 or -mavx2.
+ *
+ * The mapping is private: changes through the view do not reach the file, and
+ * the view must not outlive the GIPL_mapped object.
+ \verbatim
+	GIPL_mapped file("heart.gipl");
+	mymatrix_view<short> vol = file.view<short>();			// zero-copy
+	mymatrix_statistics s = vol.statistics();
+	GIPL_mapped other("other.gipl", GIPL_BIG_ENDIAN_DATA);
+	mymatrix<short> *m = other.read<short>();				// converted copy
+ \endverbatim
+ */
+class GIPL_mapped {
+	private:
+		GIPL			gipl_val;
+		uchar			*map_val;
+		size_t			bytes_val;
+		bool			swap_val;		//!< the data has to be swapped
+		bool			converted;		//!< the data was swapped in place
+
+		GIPL_mapped(const GIPL_mapped &);				// not copyable
+		GIPL_mapped& operator=(const GIPL_mapped &);
+
+		size_t checked_items(size_t item_size, bool sequential=false);
+
+	public:
+		GIPL_mapped(string fn, gipl_byte_order order=GIPL_HOST_ORDER);
+		~GIPL_mapped();
+
+		GIPL& gipl(){return gipl_val;}									//!< the header
+		const uchar* payload() const {return map_val + GIPL_HEADER_SIZE;}	//!< first byte of the data
+		size_t payload_bytes() const {return bytes_val - GIPL_HEADER_SIZE;}
+		bool swap_needed() const {return swap_val and not converted;}
+
+		template <class Type> mymatrix_view<Type> view();
+		template <class Type> void read(mymatrix<Type> &m);
+		template <class Type> mymatrix<Type>* read();
+};
+
 // In C++ function templates have to be implemented in the same file
 // where they are declared
 // So here follow all templates
@@ -315,4 +405,172 @@ void GIPL::set_image_type(T t){
 	throw(GIPL_NO_TYPEID);
 }
 
+/** name: GIPL::convert_from
+ * Converts n items of type In (raw bytes of the file in host order) into
+ * Type, integers are rounded and clamped (mymatrix_cast()).
+ */
+template <class In, class Type>
+void GIPL::convert_from(const uchar *raw, Type *out, size_t n){
+	const In *in = (const In*) raw;
+	for (size_t i = 0; i < n; i++) out[i] = mymatrix_cast<Type>((double) in[i]);
+}
+
+template <class Type>
+void GIPL::convert_items(const uchar *raw, Type *out, size_t n){
+	switch (header.image_type){
+		case GIPL_BINARY	: convert_from<bool  >(raw, out, n); break;
+		case GIPL_CHAR		: convert_from<char  >(raw, out, n); break;
+		case GIPL_U_CHAR	: convert_from<uchar >(raw, out, n); break;
+		case GIPL_SHORT		: convert_from<short >(raw, out, n); break;
+		case GIPL_U_SHORT	: convert_from<ushort>(raw, out, n); break;
+		case GIPL_INT		: convert_from<int   >(raw, out, n); break;
+		case GIPL_U_INT		: convert_from<uint  >(raw, out, n); break;
+		case GIPL_FLOAT		: convert_from<float >(raw, out, n); break;
+		case GIPL_DOUBLE	: convert_from<double>(raw, out, n); break;
+	}
+}
+
+/** name: GIPL::read_roi
+ * Reads the box [x0, x0+nx) x [y0, y0+ny) x [z0, z0+nz) of all frames from
+ * the file of the header into a matrix, without reading the rest of the file.
+ *
+ * The planes of the box are read in parallel, the rows of a plane with one
+ * preadv() (rows with large gaps in the file separately). Rows are read
+ * directly into the matrix if the types match, otherwise the bytes are
+ * swapped and the values converted per plane.
+ *
+ * \param m     : matrix of size nx, ny, nz, dims(3); origin and pixdim
+ *                are set to those of the box
+ * \param order : byte order of the data in the file
+ */
+template <class Type>
+void GIPL::read_roi(mymatrix<Type> &m, size_t x0, size_t y0, size_t z0, size_t nx, size_t ny, size_t nz,
+					gipl_byte_order order){
+	const size_t NX = dims(0), NY = dims(1), NZ = dims(2), NT = dims(3);
+	if (nx < 1 or ny < 1 or nz < 1 or x0 + nx > NX or y0 + ny > NY or z0 + nz > NZ)
+		throw mymatrix_exception(INDEX_OUT_OF_RANGE_FAILURE);
+	if (m.dims(0) != nx or m.dims(1) != ny or m.dims(2) != nz or m.dims(3) != NT)
+		throw mymatrix_exception(DIMENSION_FAILURE);
+
+	const size_t isz  = size_of_item();
+	const bool   swap = isz > 1 and gipl_swap_needed(order);
+	bool same;		// the file stores Type
+	if (header.image_type == GIPL_USER_DEFINED){
+		if (isz != sizeof(Type)) throw GIPL_exception(GIPL_TYPE_ERROR);
+		same = true;
+	} else same = (type_id() == typeid(Type) and isz == sizeof(Type));
+
+	const int  fd     = open_data();
+	const long planes = nz * NT;
+	long failed = 0;
+	#pragma omp parallel
+	{
+		vector<uchar>  buf(same ? 0 : nx * ny * isz);
+		vector<uchar*> rows(ny);
+		#pragma omp for schedule(dynamic) reduction(+:failed)
+		for (long p = 0; p < planes; p++){
+			const size_t k = p % nz, l = p / nz;
+			Type *out = m.data() + m.index(0, 0, k, l);
+			for (size_t j = 0; j < ny; j++)
+				rows[j] = same ? (uchar*) (out + j * nx) : &buf[j * nx * isz];
+			const size_t offset = header_size_val + (((l * NZ + z0 + k) * NY + y0) * NX + x0) * isz;
+			if (not read_rows(fd, offset, nx * isz, NX * isz, ny, &rows[0])){
+				failed++;
+				continue;
+			}
+			uchar *raw = same ? (uchar*) out : &buf[0];
+			if (swap) gipl_swap_items(raw, raw, nx * ny, isz);
+			if (not same) convert_items(raw, out, nx * ny);
+		}
+	}
+	close_data(fd);
+	if (failed) throw GIPL_exception(GIPL_DATA_SIZE_FAILURE);
+
+	m.pixdim(pixdim());
+	m.origin(coords(x0, y0, z0, 0));
+}
+
+/** name: GIPL::read_roi
+ * \return a new matrix with the box, delete it after use
+ */
+template <class Type>
+mymatrix<Type>* GIPL::read_roi(size_t x0, size_t y0, size_t z0, size_t nx, size_t ny, size_t nz,
+							   gipl_byte_order order){
+	mymatrix<Type> *m = new mymatrix<Type>(nx, ny, nz, dims(3));
+	try {
+		read_roi(*m, x0, y0, z0, nx, ny, nz, order);
+	} catch (...) {
+		delete m;
+		throw;
+	}
+	return m;
+}
+
+/** name: GIPL::read_slices
+ * Reads the slices z0 ... z0+nz-1 of all frames, e.g. for a preview or for
+ * processing a volume slab by slab (see read_roi()).
+ */
+template <class Type>
+void GIPL::read_slices(mymatrix<Type> &m, size_t z0, size_t nz, gipl_byte_order order){
+	read_roi(m, 0, 0, z0, dims(0), dims(1), nz, order);
+}
+
+template <class Type>
+mymatrix<Type>* GIPL::read_slices(size_t z0, size_t nz, gipl_byte_order order){
+	return read_roi<Type>(0, 0, z0, dims(0), dims(1), nz, order);
+}
+
+/** name: GIPL_mapped::view
+ * The voxels as a view into the mapping, nothing is copied if the byte order
+ * matches. Otherwise the bytes are swapped in place once (this copies the
+ * pages into private memory, the file is not changed).
+ * \attention sizeof(Type) must be the item size of the file.
+ */
+template <class Type>
+mymatrix_view<Type> GIPL_mapped::view(){
+	const size_t n = checked_items(sizeof(Type));
+	uchar *data = map_val + GIPL_HEADER_SIZE;
+	if (swap_needed()){
+		gipl_copy_items(data, data, n, sizeof(Type), true);
+		converted = true;
+	}
+	size_t count[4];
+	long   stride[4];
+	double pixdim[4], origin[4];
+	long step = 1;
+	for (int i = 0; i < 4; i++){
+		count[i]  = gipl_val.dims(i);
+		stride[i] = step;
+		step     *= count[i];
+		pixdim[i] = gipl_val.pixdim(i);
+		origin[i] = gipl_val.origin(i);
+	}
+	return mymatrix_view<Type>((Type*) data, count, stride, pixdim, origin);
+}
+
+/** name: GIPL_mapped::read
+ * Copies the voxels into a matrix of the same size, the byte order is
+ * converted on the way.
+ * \attention sizeof(Type) must be the item size of the file.
+ */
+template <class Type>
+void GIPL_mapped::read(mymatrix<Type> &m){
+	const size_t n = checked_items(sizeof(Type), true);
+	if (m.items() != n) throw mymatrix_exception(DIMENSION_FAILURE);
+	gipl_copy_items(m.data(), payload(), n, sizeof(Type), swap_needed());
+}
+
+/** name: GIPL_mapped::read
+ * \return a new matrix with the grid and the voxels of the file, delete it
+ *         after use
+ */
+template <class Type>
+mymatrix<Type>* GIPL_mapped::read(){
+	checked_items(sizeof(Type));
+	my_regular_grid g = gipl_val.grid();
+	mymatrix<Type> *m = new mymatrix<Type>(g);
+	read(*m);
+	return m;
+}
+
 #endif /* GIPL_H */
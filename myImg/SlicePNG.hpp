@@ -0,0 +1,159 @@
+//		./SlicePNG.hpp
+//
+//		This program is free software; you can redistribute it and/or modify
+//		it under the terms of the GNU General Public License as published by
+//		the Free Software Foundation; either version 2 of the License, or
+//		(at your option) any later version.
+//
+//		This program is distributed in the hope that it will be useful,
+//		but WITHOUT ANY WARRANTY; without even the implied warranty of
+//		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//		GNU General Public License for more details.
+//
+//		You should have received a copy of the GNU General Public License
+//		along with this program; if not, write to the Free Software
+//		Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//		MA 02110-1301, USA.
+
+#ifndef __SLICEPNG_H
+#define __SLICEPNG_H
+
+/** \file SlicePNG.hpp
+ * Direct PNG output of matrix slices, without gnuplot.
+ *
+ * The values of a slice are mapped through a LookUpTable into RGB colours and
+ * written with PNGwrite. y = 0 is the top row of the image, like in the pm3d
+ * maps of mymatrix::save_to_pm3dmap(). save_slices_png() exports all slices
+ * of a volume in parallel:
+ *
+ \verbatim
+	mymatrix<short> vol(grid);
+	...
+	save_slices_png(vol, "preview/heart.png");				// heart_000000.png, ...
+	LookUpTable<RedBlueColour> lut(256, -80., 40.);
+	save_slice_png(vol, 100, 0, "slice100.png", lut);
+ \endverbatim
+ */
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+#include <mylibs/mymatrix.hpp>
+#include <mylibs/lookuptable.hpp>
+#include "PNGwrite.hpp"
+
+using namespace std;
+
+/** \class RGBColour
+ * Colour of a LookUpTable entry, 8 bit per channel.
+ */
+class RGBColour {
+	public:
+		unsigned char r, g, b;
+		RGBColour() : r(0), g(0), b(0) {}
+};
+
+/// grey scale from black (minimum) to white (maximum)
+class GreyColour : public RGBColour {
+	public:
+		void evaluate(float value, float mini, float maxi){
+			const float f = (maxi > mini) ? (value - mini) / (maxi - mini) : 0.f;
+			r = g = b = (unsigned char) (255.f * f + 0.5f);
+		}
+};
+
+/// blue (minimum) over white (0) to red (maximum), the redblue palette of the pm3d maps
+class RedBlueColour : public RGBColour {
+	public:
+		void evaluate(float value, float mini, float maxi){
+			if (value < 0.f and mini < 0.f){
+				const float f = value / mini;					// 1 at the minimum
+				r = g = (unsigned char) (255.f * (1.f - f) + 0.5f);
+				b = 255;
+			} else {
+				const float f = (maxi > 0.f) ? value / maxi : 0.f;	// 1 at the maximum
+				r = 255;
+				g = b = (unsigned char) (255.f * (1.f - f) + 0.5f);
+			}
+		}
+};
+
+/** name: rasterize_slice
+ * Maps slice (z, t) of a matrix into RGB values.
+ * \param rgb : space for 3*dims(0)*dims(1) bytes, rows in the order of
+ *              PNGwrite (bottom row first)
+ */
+template <class Type, class Colour>
+void rasterize_slice(mymatrix<Type> &m, size_t z, size_t t, LookUpTable<Colour> &lut, unsigned char *rgb){
+	const size_t nx = m.dims(0), ny = m.dims(1);
+	if (z >= m.dims(2) or t >= m.dims(3)) throw mymatrix_exception(INVALID_SLICE_FAILURE);
+	for (size_t j = 0; j < ny; j++){
+		const Type *in = m.data() + m.index(0, j, z, t);
+		unsigned char *out = rgb + 3 * (ny - 1 - j) * nx;		// PNGwrite flips the rows
+		for (size_t i = 0; i < nx; i++){
+			const Colour &c = lut((float) in[i]);
+			out[3 * i]     = c.r;
+			out[3 * i + 1] = c.g;
+			out[3 * i + 2] = c.b;
+		}
+	}
+}
+
+/** name: save_slice_png
+ * Saves slice (z, t) of a matrix as RGB png file.
+ * \return false, if the file could not be written
+ */
+template <class Type, class Colour>
+bool save_slice_png(mymatrix<Type> &m, size_t z, size_t t, const string &fn, LookUpTable<Colour> &lut){
+	vector<unsigned char> rgb(3 * m.dims(0) * m.dims(1));
+	rasterize_slice(m, z, t, lut, &rgb[0]);
+
+	FILE *ou = fopen(fn.c_str(), "wb");
+	if (not ou){
+		cerr << "Could not open " << fn << endl;
+		return false;
+	}
+	PNGwrite png(ou);
+	png.size(m.dims(0), m.dims(1));
+	png.colour_type(PNG_COLOR_TYPE_RGB);
+	png.depth(8);
+	const bool ok = png.write(&rgb[0]);
+	fclose(ou);
+	return ok;
+}
+
+/** name: save_slices_png
+ * Saves all slices of a matrix as png files in parallel, one file per slice:
+ * file_base(fn)_zzzzzz.png, for 4D data file_base(fn)_zzzzzz_tttttt.png
+ * \return the number of files written
+ */
+template <class Type, class Colour>
+size_t save_slices_png(mymatrix<Type> &m, const string &fn, LookUpTable<Colour> &lut){
+	const string base = mystring(fn).file_base();
+	const long nz = m.dims(2), slices = nz * m.dims(3);
+	long written = 0;
+	#pragma omp parallel for reduction(+:written) schedule(dynamic)
+	for (long s = 0; s < slices; s++)
+		if (save_slice_png(m, s % nz, s / nz, mymatrix_slice_name(base, s % nz, s / nz, m.dims(3), ".png"), lut)) written++;
+	return written;
+}
+
+/** name: save_slices_png
+ * Saves all slices with a colour scale from the minimum to the maximum of the
+ * matrix, grey or blue-white-red (redblue).
+ */
+template <class Type>
+size_t save_slices_png(mymatrix<Type> &m, const string &fn, bool redblue=false){
+	Type mini, maxi;
+	m.minmax(mini, maxi);
+	if (not (maxi > mini)) maxi = mini + 1;
+	if (redblue){
+		LookUpTable<RedBlueColour> lut(1024, (float) mini, (float) maxi);
+		return save_slices_png(m, fn, lut);
+	}
+	LookUpTable<GreyColour> lut(1024, (float) mini, (float) maxi);
+	return save_slices_png(m, fn, lut);
+}
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ *      mybrickmatrix.hpp
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+
+#ifndef MYBRICKMATRIX_H
+#define MYBRICKMATRIX_H
+
+#include <vector>
+#include <algorithm>
+#include "mymatrix.hpp"
+#include "my_regular_grid.hpp"
+
+using namespace std;
+
+/** \class mybrickmatrix
+ * Volume data in a bricked memory layout.
+ *
+ * The volume is divided into bricks of B^3 voxels (B = 2^brick_shift, e.g. 8
+ * or 16). Each brick is stored contiguously (x fastest within the brick), the
+ * bricks follow each other x-fastest, then y, z and t. So all neighbours of a
+ * voxel in y- and z-direction are close in memory, which keeps neighbourhood
+ * operations on large volumes within the cache. The volume is padded to whole
+ * bricks, padding voxels are 0.
+ *
+ * index(), index_1to4() and CoordsToIndex() have the same meaning as in
+ * my_regular_grid, but the index refers to the bricked storage. The physical
+ * coordinates (coords(), pixdim(), origin()) are the same as for the linear
+ * layout. The steps between neighbours of my_regular_grid (d(), dx ... dt)
+ * and slice_size() only exist for the linear layout and are not accessible.
+ *
+ \verbatim
+	mymatrix<short> vol(512, 512, 400);
+	...
+	mybrickmatrix<short> bricked(vol);			// linear -> bricked
+	for (size_t b = 0; b < bricked.bricks(); b++){
+		size_t x0, y0, z0, t;
+		bricked.brick_origin(b, x0, y0, z0, t);
+		short *p = bricked.brick(b);			// B^3 voxels, x fastest
+		...
+	}
+	bricked.copy_to(vol);						// bricked -> linear
+ \endverbatim
+ **/
+template <class Type>
+class mybrickmatrix: public my_regular_grid{
+
+	private:
+		vector<Type> storage;
+		int    shift;		//!< B = 2^shift voxels per brick edge
+		size_t B, mask;		//!< brick edge and B-1
+		size_t nb[4];		//!< number of bricks per axis (nb[3] = frames)
+
+		// linear layout only, hidden
+		using my_regular_grid::d;
+		using my_regular_grid::slice_size;
+
+		void init_bricks(int brick_shift){
+			shift = brick_shift;
+			B     = (size_t) 1 << shift;
+			mask  = B - 1;
+			for (int a = 0; a < 3; a++) nb[a] = (dimensions[a] + B - 1) >> shift;
+			nb[3] = dimensions[3];
+			storage.assign(nb[0] * nb[1] * nb[2] * nb[3] * B * B * B, (Type) 0);
+		}
+
+	public:
+		mybrickmatrix(int dimx, int dimy=1, int dimz=1, int dimt=1, int brick_shift=3) :
+		  my_regular_grid(dimx, dimy, dimz, dimt) {
+			init_bricks(brick_shift);
+		}
+
+		/// converts a matrix in linear layout (grid and values are copied)
+		mybrickmatrix(mymatrix<Type> &source, int brick_shift=3) :
+		  my_regular_grid(source.dims(0), source.dims(1), source.dims(2), source.dims(3)) {
+			pixdim(source.pixdim(0), source.pixdim(1), source.pixdim(2), source.pixdim(3));
+			for (int i = 0; i < 4; i++) v_origin[i] = source.origin(i);
+			init_bricks(brick_shift);
+			assign(source.data());
+		}
+
+		size_t brick_size() const {return B;}						//!< voxels per brick edge
+		size_t brick_items() const {return B * B * B;}				//!< voxels per brick
+		size_t bricks() const {return nb[0] * nb[1] * nb[2] * nb[3];}	//!< number of bricks
+		size_t bricks(int axis) const {return nb[axis];}			//!< number of bricks along an axis
+		size_t storage_size() const {return storage.size();}		//!< items including the padding
+
+		/// index of voxel (i,j,k,l) in the bricked storage
+		size_t index(size_t i, size_t j, size_t k, size_t l=0) const {
+			const size_t b = (((l * nb[2] + (k >> shift)) * nb[1] + (j >> shift)) * nb[0] + (i >> shift));
+			return (b << (3 * shift)) + ((((k & mask) << shift) + (j & mask)) << shift) + (i & mask);
+		}
+
+		/// voxel (x,y,z,t) of an index of the bricked storage
+		void index_1to4(size_t index, size_t &x, size_t &y, size_t &z, size_t &t) const {
+			size_t b = index >> (3 * shift);
+			x = ((b % nb[0]) << shift) + (index & mask);
+			y = (((b / nb[0]) % nb[1]) << shift) + ((index >> shift) & mask);
+			z = (((b / (nb[0] * nb[1])) % nb[2]) << shift) + ((index >> (2 * shift)) & mask);
+			t = b / (nb[0] * nb[1] * nb[2]);
+		}
+
+		/// index of the voxel containing a point (see my_regular_grid::CoordsToIndex())
+		size_t CoordsToIndex(Point coords){
+			size_t x, y, z, t;
+			my_regular_grid::index_1to4(my_regular_grid::CoordsToIndex(coords), x, y, z, t);
+			return index(x, y, z, t);
+		}
+
+		Type& operator[](size_t index){return storage[index];}
+		Type& at(size_t i, size_t j, size_t k, size_t l=0){return storage[index(i, j, k, l)];}
+
+		/// voxels of brick b, B^3 items with x fastest
+		Type* brick(size_t b){return &storage[b << (3 * shift)];}
+
+		/// first voxel of brick b
+		void brick_origin(size_t b, size_t &x, size_t &y, size_t &z, size_t &t) const {
+			index_1to4(b << (3 * shift), x, y, z, t);
+		}
+
+		void assign(const Type *linear);
+		void copy_to(Type *linear) const;
+		void copy_to(mymatrix<Type> &target) const;
+		void load_brick(size_t b, size_t halo, vector<Type> &block) const;
+};
+
+/** assign
+ * Copies data in linear layout (x fastest, then y, z and t) into the bricks.
+ * The bricks are filled in parallel, rows of B voxels are copied at once.
+ *
+ * \param linear : dims(0)*dims(1)*dims(2)*dims(3) values
+ */
+template <class Type>
+void mybrickmatrix<Type>::assign(const Type *linear){
+	const long nr_bricks = (long) bricks();
+	const size_t nx = dimensions[0], ny = dimensions[1], nz = dimensions[2];
+
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (long b = 0; b < nr_bricks; b++){
+		size_t x0, y0, z0, t;
+		brick_origin(b, x0, y0, z0, t);
+		Type *out = brick(b);
+		const size_t w = min(B, nx - x0);
+		for (size_t k = 0; k < B and z0 + k < nz; k++)
+			for (size_t j = 0; j < B and y0 + j < ny; j++){
+				const Type *row = linear + ((t * nz + z0 + k) * ny + y0 + j) * nx + x0;
+				copy(row, row + w, out + ((k << shift) + j) * B);
+			}
+	}
+}
+
+/** copy_to
+ * Copies the voxels into an array in linear layout (x fastest).
+ *
+ * \param linear : space for dims(0)*dims(1)*dims(2)*dims(3) values
+ */
+template <class Type>
+void mybrickmatrix<Type>::copy_to(Type *linear) const {
+	const long nr_bricks = (long) bricks();
+	const size_t nx = dimensions[0], ny = dimensions[1], nz = dimensions[2];
+
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (long b = 0; b < nr_bricks; b++){
+		size_t x0, y0, z0, t;
+		brick_origin(b, x0, y0, z0, t);
+		const Type *in = &storage[b << (3 * shift)];
+		const size_t w = min(B, nx - x0);
+		for (size_t k = 0; k < B and z0 + k < nz; k++)
+			for (size_t j = 0; j < B and y0 + j < ny; j++){
+				const Type *row = in + ((k << shift) + j) * B;
+				copy(row, row + w, linear + ((t * nz + z0 + k) * ny + y0 + j) * nx + x0);
+			}
+	}
+}
+
+/** copy_to
+ * Copies the voxels into a matrix in linear layout, e.g. for saving. The
+ * matrix must have the same dimensions.
+ */
+template <class Type>
+void mybrickmatrix<Type>::copy_to(mymatrix<Type> &target) const {
+	for (int a = 0; a < 4; a++)
+		if (target.dims(a) != dimensions[a]) throw mymatrix_exception(DIMENSION_FAILURE);
+	copy_to(target.data());
+}
+
+/** load_brick
+ * Copies brick b together with a halo of neighbouring voxels into a dense
+ * block of (B+2*halo)^3 values (x fastest). Outside of the volume the values
+ * of the border are repeated. With the block, filters can work on one brick
+ * without any index computations.
+ *
+ * \param b     : the brick
+ * \param halo  : width of the halo, at most B
+ * \param block : returns the values
+ */
+template <class Type>
+void mybrickmatrix<Type>::load_brick(size_t b, size_t halo, vector<Type> &block) const {
+	size_t x0, y0, z0, t;
+	brick_origin(b, x0, y0, z0, t);
+	const long e = B + 2 * halo;
+	const long nx = dimensions[0], ny = dimensions[1], nz = dimensions[2];
+	block.resize(e * e * e);
+
+	for (long k = 0; k < e; k++){
+		const size_t z = (size_t) min(max((long) z0 + k - (long) halo, 0L), nz - 1);
+		for (long j = 0; j < e; j++){
+			const size_t y = (size_t) min(max((long) y0 + j - (long) halo, 0L), ny - 1);
+			Type *out = &block[(k * e + j) * e];
+			// the row within the brick is contiguous, only the halo is gathered
+			const Type *run = &storage[index(x0, y, z, t)];
+			copy(run, run + B, out + halo);
+			for (long i = 0; i < (long) halo; i++){
+				const long xl = max((long) x0 - (long) halo + i, 0L);
+				const long xr = min((long) (x0 + B + i), nx - 1);
+				out[i]            = storage[index(xl, y, z, t)];
+				out[halo + B + i] = storage[index(xr, y, z, t)];
+			}
+			for (long i = nx - (long) x0 + (long) halo; i < (long) (halo + B); i++) out[i] = out[i-1]; // padding
+		}
+	}
+}
+
+#endif
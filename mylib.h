@@ -101,12 +101,17 @@ or even simpler, if you installed the library as explained above
 #include "myinifiles.hpp"
 #include "cmdline.hpp"
 #include "gipl.h"
+#include "Isolines.hpp"
 #include "lists.h"
 #include "lookuptable.hpp"
 #include "maps.h"
+#include "mybrickmatrix.hpp"
 #include "mylib.h"
 #include "myline.hpp"
 #include "mymatrix.hpp"
+#include "mymatrix_expr.hpp"
+#include "mymatrix_view.hpp"
+#include "mymatrix_pyramid.hpp"
 #include "mymesh.hpp"
 #include "my_regular_grid.hpp"
 #include "mystack.h"
@@ -26,13 +26,18 @@
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <cstdio>
 #include <limits.h>
+#include <limits>
 #include <map>
 #include <math.h>
 #include <string>
 #include <vector>
 #include <utility>
 #include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "mystring.hpp"
 #include "mystack.h"
 #include "my_regular_grid.hpp"
@@ -42,6 +47,10 @@ using namespace std;
 enum mymatrix_exceptions {PIXDIM_FAILURE, INDEX_OUT_OF_RANGE_FAILURE,
 							DIMENSION_FAILURE, INVALID_SLICE_FAILURE};
 
+enum mymatrix_interpolation {RESAMPLE_NEAREST, RESAMPLE_LINEAR, RESAMPLE_CUBIC};
+
+enum mymatrix_diffusion {DIFFUSION_EXPONENTIAL, DIFFUSION_RATIONAL};
+
 class mymatrix_exception : public exception {
 	mymatrix_exceptions id;
 	public:
@@ -76,6 +85,187 @@ class sPair: public pair<T1, T2>{
 	bool operator() (T1 i,T2 j) { return (i<j);}
 };
 
+/** \class rank_histogram
+ * Histogram over integer bins with an additional coarse level of about
+ * sqrt(bins) bins. Values are added and removed in O(1) and the k-th smallest
+ * value is found in O(sqrt(bins)). Used by the median and percentile filters
+ * of mymatrix.
+ **/
+class rank_histogram {
+	vector<int> fine;
+	vector<int> coarse;
+	int  shift;	//!< fine bins per coarse bin = 2^shift
+	long n;		//!< number of values in the histogram
+
+	public:
+		rank_histogram(size_t bins) : shift(0), n(0) {
+			while (((size_t) 1 << (2 * shift)) < bins) shift++;
+			fine.assign(bins, 0);
+			coarse.assign(((bins - 1) >> shift) + 1, 0);
+		}
+
+		void clear(){
+			fill(fine.begin(), fine.end(), 0);
+			fill(coarse.begin(), coarse.end(), 0);
+			n = 0;
+		}
+
+		/// adds c values to a bin (removes them for c < 0)
+		void add(size_t bin, int c = 1){
+			fine[bin]            += c;
+			coarse[bin >> shift] += c;
+			n                    += c;
+		}
+
+		/// adds (sign = 1) or removes (sign = -1) a plain histogram with the same bins
+		void add(const int *h, int sign){
+			const size_t bins = fine.size();
+			for (size_t c = 0; c < coarse.size(); c++){
+				const size_t b1 = min((c + 1) << shift, bins);
+				int sum = 0;
+				for (size_t b = c << shift; b < b1; b++){
+					fine[b] += sign * h[b];
+					sum     += h[b];
+				}
+				coarse[c] += sign * sum;
+				n         += sign * sum;
+			}
+		}
+
+		long count() const {return n;}	//!< number of values
+
+		/// bin of the k-th smallest value (0 <= k < count())
+		size_t kth(long k) const {
+			size_t c = 0;
+			long acc = 0;
+			while (acc + coarse[c] <= k) acc += coarse[c++];
+			size_t b = c << shift;
+			while (acc + fine[b] <= k) acc += fine[b++];
+			return b;
+		}
+};
+
+/// file name of slice z (and frame t, if there are several) for batch exports
+inline string mymatrix_slice_name(const string &base, size_t z, size_t t, size_t frames, const char *ext){
+	char number[32];
+	if (frames > 1) snprintf(number, sizeof(number), "_%06lu_%06lu", (unsigned long) z, (unsigned long) t);
+	else            snprintf(number, sizeof(number), "_%06lu", (unsigned long) z);
+	return base + number + ext;
+}
+
+/** \class resample_axis
+ * Interpolation taps along one axis for resampling between regular grids.
+ * Voxel i covers [origin + i*pixdim, origin + (i+1)*pixdim), so it is sampled
+ * at its centre. A sample lies inside, if it is within the extent of the
+ * source, taps beyond the border are clamped to the border. A pixdim of 0 is
+ * taken as 1, a source axis with only one voxel is constant.
+ */
+class resample_axis {
+	public:
+		int taps;					//!< taps per sample (1, 2 or 4)
+		vector<size_t> index;		//!< source indices, taps per sample
+		vector<double> weight;		//!< weights, taps per sample
+		vector<char>   inside;		//!< the sample is within the source
+		size_t lo, hi;				//!< range of source indices used [lo, hi)
+
+		void init(size_t n_src, double o_src, double pd_src,
+				  size_t n_dst, double o_dst, double pd_dst, int method){
+			if (pd_src == 0.) pd_src = 1.;
+			if (pd_dst == 0.) pd_dst = 1.;
+			taps = (n_src == 1 or method == RESAMPLE_NEAREST) ? 1 : ((method == RESAMPLE_CUBIC) ? 4 : 2);
+			index.assign(n_dst * taps, 0);
+			weight.assign(n_dst * taps, 0.);
+			inside.assign(n_dst, 1);
+			lo = n_src - 1;
+			hi = 1;
+			const long last = (long) n_src - 1;
+			for (size_t i = 0; i < n_dst; i++){
+				size_t *idx = &index[i * taps];
+				double *w   = &weight[i * taps];
+				if (n_src == 1){
+					idx[0] = 0;
+					w[0]   = 1.;
+					lo = 0;
+					continue;
+				}
+				// continuous source index of the centre of voxel i
+				const double u = (o_dst + (i + 0.5) * pd_dst - o_src) / pd_src - 0.5;
+				inside[i] = (u >= -0.5 and u < n_src - 0.5);
+				const long   u0 = (long) floor(u);
+				const double f  = u - u0;
+				if (taps == 1){
+					idx[0] = (size_t) min(max((long) floor(u + 0.5), 0L), last);
+					w[0]   = 1.;
+				} else if (taps == 2){
+					idx[0] = (size_t) min(max(u0,     0L), last);
+					idx[1] = (size_t) min(max(u0 + 1, 0L), last);
+					w[0] = 1. - f;
+					w[1] = f;
+				} else {
+					for (int t = 0; t < 4; t++) idx[t] = (size_t) min(max(u0 - 1 + t, 0L), last);
+					// Catmull-Rom spline
+					w[0] = 0.5 * ((-f + 2.) * f - 1.) * f;
+					w[1] = 0.5 * ((3. * f - 5.) * f * f + 2.);
+					w[2] = 0.5 * ((-3. * f + 4.) * f + 1.) * f;
+					w[3] = 0.5 * (f - 1.) * f * f;
+				}
+				for (int t = 0; t < taps; t++){
+					lo = min(lo, idx[t]);
+					hi = max(hi, idx[t] + 1);
+				}
+			}
+		}
+
+		/** Taps for a reduction by 2: voxel i of the coarse axis covers the
+		 * voxels 2i and 2i+1 and is prefiltered with the binomial kernel
+		 * [1 3 3 1]/8 over 2i-1 .. 2i+2 (clamped at the border). An axis with
+		 * only one voxel is kept.
+		 * \return the number of coarse voxels, (n_src+1)/2
+		 */
+		size_t init_reduce(size_t n_src){
+			const size_t n_dst = (n_src == 1) ? 1 : (n_src + 1) / 2;
+			taps = (n_src == 1) ? 1 : 4;
+			index.assign(n_dst * taps, 0);
+			weight.assign(n_dst * taps, 1.);
+			inside.assign(n_dst, 1);
+			lo = 0;
+			hi = n_src;
+			if (n_src == 1) return n_dst;
+			const double w[4] = {0.125, 0.375, 0.375, 0.125};
+			const long last = (long) n_src - 1;
+			for (size_t i = 0; i < n_dst; i++)
+				for (int t = 0; t < 4; t++){
+					index [i * 4 + t] = (size_t) min(max((long) (2 * i) - 1 + t, 0L), last);
+					weight[i * 4 + t] = w[t];
+				}
+			return n_dst;
+		}
+};
+
+/** \class mymatrix_statistics
+ * Result of mymatrix::statistics(): number of values, minimum, maximum, sum,
+ * mean and variance (divided by count) and optionally a histogram. Bin b
+ * counts the values v with lo + b*width <= v < lo + (b+1)*width, values
+ * outside of all bins are counted in outside.
+ */
+class mymatrix_statistics {
+	public:
+		size_t count;
+		double min, max, sum, mean, variance;
+		vector<size_t> histogram;
+		double lo, width;
+		size_t outside;
+
+		mymatrix_statistics() : count(0), min(0.), max(0.), sum(0.), mean(0.), variance(0.),
+			lo(0.), width(1.), outside(0) {}
+
+		double bin_value(size_t b) const {return lo + b * width;}	//!< lower limit of bin b
+		double stddev() const {return sqrt(variance);}
+};
+
+template <class E> struct mymatrix_expr;
+template <class Type> class mymatrix_view;
+
 /** \class mymatrix
  * Template class for working with pixel data from images (e.g. GIPL)
  **/
@@ -86,6 +276,16 @@ class mymatrix: public my_regular_grid{
 		/* add your private declarations */
 		Type *matrix;
 		void init_mymatrix();
+		void order_filter(int px, int pz, double p, int type);
+		bool value_range(Type &lo, size_t &bins, size_t max_bins);
+		size_t component_labels(vector<unsigned int> &labels, int connectivity, bool use_background, Type background);
+		void distance_kernel(float *d2, int *feature, bool use_pixdim);
+		/// flux g(|d|)*d of the anisotropic diffusion, q = 1/kappa^2
+		static float diffusion_flux(float d, float q, bool rational){
+			return rational ? d / (1.f + d * d * q) : d * expf(-d * d * q);
+		}
+		template <class Out>
+		void resample_lines(const resample_axis *ax, mymatrix<Out> &target, double outside);
 
 	public:
 		mymatrix(int dimx, int dimy=1, int dimz=1, int dimt=1) :
@@ -178,12 +378,32 @@ class mymatrix: public my_regular_grid{
 		bool adjust_contrast(Type new_min, Type new_max);
 
 		double mean_value();
+		mymatrix_statistics statistics(mymatrix<char> *mask=0);
+		mymatrix_statistics statistics(size_t bins, double lo, double hi, mymatrix<char> *mask=0);
+		mymatrix_statistics histogram(mymatrix<char> *mask=0);
 		mymatrix<double>* gradientd(unsigned int dx=1, unsigned int dy=0, unsigned int dz=0, unsigned int dt=0);
 		void gradient(unsigned int dx=1, unsigned int dy=0, unsigned int dz=0, unsigned int dt=0);
-		void median(int px, int type=0);
-		void rank(int px);
+		template <class Out>
+		void gradients(unsigned int axes, Out *magnitude, Out *gx=0, Out *gy=0, Out *gz=0, Out *gt=0, bool use_pixdim=false);
+		void gradient_magnitude(unsigned int axes=7, bool use_pixdim=false);
+		void median(int px, int type=0, int pz=0);
+		void percentile(double p, int px, int pz=0);
+		void rank(int px, int pz=0);
 		void binarize(Type threshold);
 		void average(int px);
+		void smooth_box(int px, int axis=-1);
+		void smooth_gaussian(double sigma, int axis=-1);
+		void bilateral(double sigma_s, double sigma_r, int axis=-1);
+		int anisotropic_diffusion(int iterations, double kappa, double tolerance=0.,
+								  int conduction=DIFFUSION_EXPONENTIAL, double dt=0., bool use_pixdim=false);
+		void erode(int px, int axis=-1);
+		void dilate(int px, int axis=-1);
+		void opening(int px, int axis=-1);
+		void closing(int px, int axis=-1);
+		void erode_sphere(double radius, Type background=0, bool use_pixdim=true);
+		void dilate_sphere(double radius, Type background=0, bool use_pixdim=true);
+		void opening_sphere(double radius, Type background=0, bool use_pixdim=true);
+		void closing_sphere(double radius, Type background=0, bool use_pixdim=true);
 		void detect_edgesXY(Type epsilon= (Type)0.);
 		void detect_HIGH_edgesXY(Type epsilon= (Type)0.);
 
@@ -193,12 +413,40 @@ class mymatrix: public my_regular_grid{
 
 		void minmax(Type &min, Type &max);
 		bool save_histogram(string fn, bool inc_null = true);
-		void save_to_pm3dmap(string fn, unsigned int which_slice, bool redblue=false, bool png=false);
+		void save_to_pm3dmap(string fn, unsigned int which_slice, bool redblue=false, bool png=false, bool binary=false);
+		bool save_gnuplot_binary(string fn, size_t which_slice, size_t t=0);
+		size_t save_slices_gnuplot_binary(string fn);
 		void flood_fill(Type color, size_t idx);
 		void flood_fill_recursive(Type color, size_t idx, bool first);
+		size_t region_fill(Type color, size_t seed, int connectivity=6);
+		mymatrix<int>* label_components(size_t &nr_labels, int connectivity=6, Type background=0);
+		size_t remove_components(size_t min_size, int connectivity=6, Type background=0);
+		mymatrix<float>* distance_map(Type background=0, bool use_pixdim=true, bool squared=false);
+		mymatrix<float>* signed_distance_map(Type background=0, bool use_pixdim=true);
+		mymatrix<int>* feature_transform(Type background=0, bool use_pixdim=true);
 		void resolution2x();
+		mymatrix<Type>* downsample2x();
+		mymatrix<Type>* upsample2x(int method=RESAMPLE_LINEAR);
+		template <class Out>
+		void resample_to(mymatrix<Out> &target, int method=RESAMPLE_LINEAR, double outside=0.);
+		mymatrix<Type>* resample(my_regular_grid &grid, int method=RESAMPLE_LINEAR, Type outside=0);
 		void info();
 		Type* data(){return matrix;};
+
+		// views into the data without copying, see mymatrix_view.hpp
+		mymatrix(const mymatrix_view<Type> &source);
+		mymatrix_view<Type> view();
+		mymatrix_view<Type> crop(size_t x0, size_t y0, size_t z0, size_t t0,
+								 size_t nx, size_t ny, size_t nz, size_t nt);
+		mymatrix_view<Type> slice(size_t z, size_t t=0);
+		mymatrix_view<Type> frame(size_t t);
+		mymatrix_view<Type> subsample(size_t sx, size_t sy=1, size_t sz=1, size_t st=1);
+
+		// element-wise expressions, see mymatrix_expr.hpp
+		template <class E> mymatrix<Type>& operator=(const mymatrix_expr<E> &expr);
+		template <class E> mymatrix<Type>& operator+=(const E &e);
+		template <class E> mymatrix<Type>& operator-=(const E &e);
+		template <class E> mymatrix<Type>& operator*=(const E &e);
 };
 
 /**
@@ -550,25 +798,23 @@ bool mymatrix<Type>::extend_t(mymatrix<Type> &matrix2){
 template <class Type>
 mymatrix<double>* mymatrix<Type>::gradientd(unsigned int dx, unsigned int dy, unsigned int dz, unsigned int dt){
 
-	//mymatrix<double> *grad_intern = new mymatrix<double>(dims(0), dims(1), dims(2), dims(3));
-	mymatrix<double> *grad_intern = new mymatrix<double>(*this);
-	//! compute the gradient
-	for (unsigned int t = dt; t < NT-dt; t++){
-	 for (unsigned int k = dz; k < NZ-dz; k++){
-	  for (unsigned int j = dy; j < NY-dy; j++){
-	   for (unsigned int i = dx; i < NX-dx; i++){
-
-		 unsigned int id1 = index(i-dx,j-dy,k-dz, t-dt);
-		 unsigned int idx = index(i   ,j   ,k   , t   );
-		 unsigned int id3 = index(i+dx,j+dy,k+dz, t+dt);
-
-		 double d1 = (double) matrix[idx] - (double)matrix[id1];
-		 double d2 = (double) matrix[id3] - (double)matrix[idx];
+	my_regular_grid grid(*this);
+	mymatrix<double> *grad_intern = new mymatrix<double>(grid);
+	double *out = grad_intern->data();
+	const long ofs = (long) (dx * this->dx + dy * this->dy + dz * this->dz + dt * this->dt);
 
-		 grad_intern->operator[](idx) = d1 + d2 / 2.; 		// mid-point gradient
-	   }
-	  }
-	 }
+	//! compute the gradient, the borders stay 0
+	const long rows = NY * NZ * NT;
+	#pragma omp parallel for
+	for (long r = 0; r < rows; r++){
+		const long j = r % NY, k = (r / NY) % NZ, t = r / (NY * NZ);
+		if (j < (long) dy or j >= (long) (NY-dy) or k < (long) dz or k >= (long) (NZ-dz) or
+		    t < (long) dt or t >= (long) (NT-dt)) continue;
+		const long row = r * NX;
+		for (long i = dx; i < (long) (NX-dx); i++){
+			const long idx = row + i;
+			out[idx] = ((double) matrix[idx + ofs] - (double) matrix[idx - ofs]) / 2.; // mid-point gradient
+		}
 	}
 	return grad_intern;
 }
@@ -591,7 +837,6 @@ mymatrix<double>* mymatrix<Type>::gradientd(unsigned int dx, unsigned int dy, un
 template <class Type>
 void mymatrix<Type>::gradient(unsigned int dx, unsigned int dy, unsigned int dz, unsigned int dt){
 
-	mymatrix<Type> 		temp(*this);
 	mymatrix<double> 	*grad_intern = this->gradientd(dx,dy,dz,dt);
 	const int max_range = 255;
 	grad_intern->adjust_contrast(0, max_range);
@@ -609,10 +854,246 @@ void mymatrix<Type>::gradient(unsigned int dx, unsigned int dy, unsigned int dz,
 	delete grad_intern;
 }
 
+/** mymatrix_cast
+ *
+ * Converts a filtered value back to the type of the matrix, integer values
+ * are rounded and clamped to the range of the type.
+ */
+template <class Type>
+inline Type mymatrix_cast(double v){
+	if (not numeric_limits<Type>::is_integer) return (Type) v;
+	if (v <= (double) numeric_limits<Type>::min()) return numeric_limits<Type>::min();
+	if (v >= (double) numeric_limits<Type>::max()) return numeric_limits<Type>::max();
+	return (Type) floor(v + 0.5);
+}
+
+/**
+ * name: mymatrix::gradients
+ *
+ * Fused gradient kernel: computes the derivatives along any subset of the
+ * axes and the magnitude of the gradient in one parallel pass over the
+ * matrix, without temporary matrices (see mymatrix_view::gradients()).
+ *
+ * All outputs are optional (NULL) and must have items() elements, they may
+ * have any arithmetic type, e.g.
+ * \verbatim
+	vector<float> gx(m.items()), mag(m.items());
+	m.gradients(7, &mag[0], &gx[0]);	// |grad| in 3D and d/dx
+ \endverbatim
+ *
+ * \param axes       : bit mask of the axes (1: x, 2: y, 4: z, 8: t) which
+ * 					   make up the magnitude
+ * \param magnitude  : output for the magnitude of the gradient
+ * \param gx,gy,gz,gt: outputs for the derivatives along x, y, z and t (they
+ * 					   are computed even if the axis is not in \a axes)
+ * \param use_pixdim : divide by the pixel dimensions (physical units)
+ */
+template <class Type> template <class Out>
+void mymatrix<Type>::gradients(unsigned int axes, Out *magnitude, Out *gx, Out *gy, Out *gz, Out *gt, bool use_pixdim){
+	view().gradients(axes, magnitude, gx, gy, gz, gt, use_pixdim);
+}
+
+/**
+ * name: mymatrix::gradient_magnitude
+ *
+ * Replaces the matrix by the magnitude of its gradient (see gradients()). The
+ * result is written into a new buffer, which replaces the old one, so no
+ * copy is made.
+ *
+ * \param axes       : bit mask of the axes (1: x, 2: y, 4: z, 8: t)
+ * \param use_pixdim : divide by the pixel dimensions (physical units)
+ */
+template <class Type>
+void mymatrix<Type>::gradient_magnitude(unsigned int axes, bool use_pixdim){
+	if (numeric_limits<Type>::is_integer){ // round instead of truncating
+		vector<double> mag(items_val);
+		gradients(axes, &mag[0], (double*) 0, (double*) 0, (double*) 0, (double*) 0, use_pixdim);
+		#pragma omp parallel for
+		for (long i = 0; i < (long) items_val; i++) matrix[i] = mymatrix_cast<Type>(mag[i]);
+		return;
+	}
+	Type *result = new Type[items_val];
+	gradients(axes, result, (Type*) 0, (Type*) 0, (Type*) 0, (Type*) 0, use_pixdim);
+	delete[] matrix;
+	matrix = result;
+}
+
+/** value_range
+ *
+ * Checks whether all values fit into a histogram of at most max_bins integer
+ * bins (only for integer types).
+ *
+ * \param lo       : returns the smallest value (bin 0)
+ * \param bins     : returns the number of bins needed (max - min + 1)
+ * \param max_bins : the maximum number of bins
+ * \return true if Type is an integer type and the range is small enough
+ */
+template <class Type>
+bool mymatrix<Type>::value_range(Type &lo, size_t &bins, size_t max_bins){
+	if (not numeric_limits<Type>::is_integer or items_val == 0) return false;
+	Type hi;
+	minmax(lo, hi);
+	const double range = (double) hi - (double) lo + 1.;
+	if (range > (double) max_bins) return false;
+	bins = (size_t) range;
+	return true;
+}
+
+/** order_select
+ *
+ * Combines the order statistics of a window for mymatrix::median().
+ */
+template <class Type>
+inline Type order_select(Type value, Type lo, Type hi, int type){
+	switch (type){
+		case 1:  return lo;
+		case 2:  return hi;
+		case 3:  return value - lo;
+		case 4:  return hi - lo;
+		default: return value;
+	}
+}
+
+/** add_to_columns
+ *
+ * Adds (sign = 1) or removes (sign = -1) one row of an image to/from the
+ * column histograms of order_filter().
+ */
+template <class Type>
+inline void add_to_columns(int *cols, size_t bins, const Type *row, long nx, Type lo, int sign){
+	for (long x = 0; x < nx; x++) cols[x * bins + (size_t) (row[x] - lo)] += sign;
+}
+
+/** order_filter
+ *
+ * Sliding window order statistics filter, the work horse of median() and
+ * percentile(). The window has (2*px+1)^2*(2*pz+1) pixels and is clipped at
+ * the borders of the image. Frames (t) are filtered independently, every
+ * slice is computed by one thread.
+ *
+ * Depending on the data one of three methods is used:
+ * - integer data with at most 256 different values: column histograms
+ *   (Perreault and Hebert), the cost per pixel does not depend on the window
+ * - integer data with at most 65536 different values: one histogram which is
+ *   moved along x (Huang), the cost per pixel grows with (2*px+1)*(2*pz+1)
+ * - small windows, floating point data and large ranges: selection
+ *   (nth_element) within the window
+ *
+ * \param px   : window radius in x and y
+ * \param pz   : window radius in z
+ * \param p    : percentile in [0:1], 0.5 is the median
+ * \param type : how the result is composed (see median())
+ */
+template <class Type>
+void mymatrix<Type>::order_filter(int px, int pz, double p, int type){
+	if (items_val == 0) return;
+	px = max(px, 0);
+	pz = max(pz, 0);
+	p  = min(max(p, 0.), 1.);
+
+	const long nx = NX, ny = NY, nz = NZ, nt = NT;
+	const long slice = nx * ny;
+	const long window = (2*px+1) * (2*px+1) * (2*pz+1);
+
+	Type   lo   = 0;
+	size_t bins = 0;
+	int method  = 0; // selection
+	if (window > 27 and value_range(lo, bins, 65536)) method = (bins <= 256) ? 2 : 1;
+
+	Type *result = new Type[items_val];
+	long s = 0;
+
+	#pragma omp parallel for private(s) schedule(dynamic)
+	for (s = 0; s < nz * nt; s++){
+		const long z   = s % nz;
+		const long t0  = (s / nz) * nz * slice; // first item of the frame
+		const long z0  = max(z - pz, 0L), z1 = min(z + pz, nz - 1);
+		Type *out      = result + s * slice;
+
+		if (method == 2){ // column histograms
+			vector<int> cols(nx * bins, 0);
+			rank_histogram h(bins);
+			for (long y = 0; y < ny; y++){
+				// move the columns to rows y-px ... y+px (at y = 0 the rows 0 ... px are added)
+				for (long yi = (y == 0) ? 0 : y + px; yi <= min(y + px, ny - 1); yi++)
+					for (long zz = z0; zz <= z1; zz++)
+						add_to_columns(&cols[0], bins, matrix + t0 + zz * slice + yi * nx, nx, lo, 1);
+				if (y - px - 1 >= 0)
+					for (long zz = z0; zz <= z1; zz++)
+						add_to_columns(&cols[0], bins, matrix + t0 + zz * slice + (y - px - 1) * nx, nx, lo, -1);
+
+				h.clear();
+				for (long x = 0; x <= min((long) px, nx - 1); x++) h.add(&cols[x * bins], 1);
+				for (long x = 0; x < nx; x++){
+					if (x > 0){
+						if (x + px < nx)      h.add(&cols[(x + px) * bins], 1);
+						if (x - px - 1 >= 0)  h.add(&cols[(x - px - 1) * bins], -1);
+					}
+					const long n = h.count();
+					const Type value = (Type) (lo + h.kth((long) (p * (n - 1) + 0.5)));
+					out[y * nx + x]  = (type == 0) ? value :
+						order_select(value, (Type) (lo + h.kth(0)), (Type) (lo + h.kth(n - 1)), type);
+				}
+			}
+		}
+		else if (method == 1){ // one moving histogram
+			rank_histogram h(bins);
+			for (long y = 0; y < ny; y++){
+				const long y0 = max(y - px, 0L), y1 = min(y + px, ny - 1);
+				h.clear();
+				for (long x = 0; x < nx; x++){
+					// at x = 0 the planes 0 ... px are added, later one plane is added and one removed
+					for (long xi = (x == 0) ? 0 : x + px; xi <= min(x + px, nx - 1); xi++)
+						for (long zz = z0; zz <= z1; zz++)
+							for (long yy = y0; yy <= y1; yy++)
+								h.add((size_t) (matrix[t0 + zz * slice + yy * nx + xi] - lo), 1);
+					if (x - px - 1 >= 0)
+						for (long zz = z0; zz <= z1; zz++)
+							for (long yy = y0; yy <= y1; yy++)
+								h.add((size_t) (matrix[t0 + zz * slice + yy * nx + x - px - 1] - lo), -1);
+					const long n = h.count();
+					const Type value = (Type) (lo + h.kth((long) (p * (n - 1) + 0.5)));
+					out[y * nx + x]  = (type == 0) ? value :
+						order_select(value, (Type) (lo + h.kth(0)), (Type) (lo + h.kth(n - 1)), type);
+				}
+			}
+		}
+		else { // selection
+			vector<Type> buf;
+			buf.reserve(window);
+			for (long y = 0; y < ny; y++){
+				const long y0 = max(y - px, 0L), y1 = min(y + px, ny - 1);
+				for (long x = 0; x < nx; x++){
+					const long x0 = max(x - px, 0L), x1 = min(x + px, nx - 1);
+					buf.clear();
+					for (long zz = z0; zz <= z1; zz++)
+						for (long yy = y0; yy <= y1; yy++){
+							const Type *row = matrix + t0 + zz * slice + yy * nx;
+							buf.insert(buf.end(), row + x0, row + x1 + 1);
+						}
+					const long k = (long) (p * (buf.size() - 1) + 0.5);
+					nth_element(buf.begin(), buf.begin() + k, buf.end());
+					const Type value = buf[k];
+					out[y * nx + x]  = (type == 0) ? value :
+						order_select(value, *min_element(buf.begin(), buf.begin() + k + 1),
+						                    *max_element(buf.begin() + k, buf.end()), type);
+				}
+			}
+		}
+	}
+
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++) matrix[i] = result[i];
+	delete[] result;
+}
+
 /** median
  *
  * A median filter: computes the median color in the window of
  * egde length 2*px+1, and sets this color for the central pixel.
+ * All slices and frames are filtered, at the borders the window is clipped.
+ * For integer data the median is taken from histograms, so large windows
+ * are cheap (see order_filter()).
  *
  * \param px   : pixel size of the window
  * \param type : which type of median shall be computed
@@ -621,97 +1102,81 @@ void mymatrix<Type>::gradient(unsigned int dx, unsigned int dy, unsigned int dz,
  * 				 2: max
  *				 3: mid - zero value
  *				 4: max - zero value
+ * \param pz   : pixel size of the window in z-direction, 0 filters every
+ * 				 slice on its own (2D), pz = px gives a cubic window
  */
 template <class Type>
-void mymatrix<Type>::median(int px, int type){
-
-	my_regular_grid grid = *this;
-	mymatrix<Type> result(grid);
-	int items = (2*px+1)*(2*px+1);
-	Type *colors = new Type[(2*px+1)*(2*px+1)];
-	for (unsigned int j = px; j < dims(1)-px; j++){
-	for (unsigned int i = px; i < dims(0)-px; i++){
-		int c = 0;
-		for (unsigned int y = j-px; y < j+px+1 ; y++)
-		for (unsigned int x = i-px; x < i+px+1 ; x++){
-			unsigned int idx = index(x,y,0,0);
-			colors[c++] = this->operator[](idx);
-		}
-
-		// sortieren
-		for (int c1 = 0; c1 < items -1 ; c1++)
-			for (int c2 = c1+1; c2 < items ; c2++){
-				if ( colors[c1] > colors[c2] ) {
-					unsigned short tmp = colors[c1];
-					colors[c1] = colors[c2];
-					colors[c2] = tmp;
-				}
-		}
-		unsigned int idx = index(i,j,0,0);
-		//median_out[idx] = colors[8]-colors[0] ;
-		switch (type){
-		case 0:
-			result[idx] = colors[items/2];
-			break;
-		case 1:
-			result[idx] = colors[0] ;
-			break;
-		case 2:
-			result[idx] = colors[items];
-			break;
-		case 3:
-			result[idx] = colors[items/2]-colors[0] ;
-			break;
-		case 4:
-			result[idx] = colors[items-1]-colors[0] ;
-			break;
-		}
-
-
-		//median_out[idx] = colors[items] ;
-		//cout << colors[8] << endl;
-		}
-	}
-
-	// copy all entries
-	for (unsigned int i = 0; i < this->items() ; i++)
-		this->operator[](i) = result[i];
-
+void mymatrix<Type>::median(int px, int type, int pz){
+	order_filter(px, pz, 0.5, type);
+}
 
-	delete[] colors;
+/** percentile
+ *
+ * Percentile filter: every pixel gets the value at the fraction p of the
+ * sorted values within its window (p = 0: minimum, 0.5: median, 1: maximum).
+ *
+ * \param p    : percentile in [0:1]
+ * \param px   : pixel size of the window in x and y
+ * \param pz   : pixel size of the window in z (see median())
+ */
+template <class Type>
+void mymatrix<Type>::percentile(double p, int px, int pz){
+	order_filter(px, pz, p, 0);
 }
 
 
 /** rank
  *
- * Rangbildberechnung
+ * Rangbildberechnung: The image is divided into blocks of edge length 2*px+1
+ * (and 2*pz+1 in z-direction). Every pixel gets the rank of its value within
+ * its block, i.e. the number of smaller values in the block. Blocks at the
+ * borders may be smaller, all slices and frames are processed. The blocks are
+ * computed in parallel. Integer data with at most 256 values are ranked by
+ * counting, other data by sorting.
  *
  * \param px   : (1/2 pixel size of the window) - 1
+ * \param pz   : same as px in z-direction (0: blocks within one slice)
  */
 template <class Type>
-void mymatrix<Type>::rank(int px){
-	for (unsigned int j = px; j < dims(1)-px+1; j += 2*px+1)
-	for (unsigned int i = px; i < dims(0)-px+1; i += 2*px+1){
-		vector< sPair<Type, int> > colors;
-		for (unsigned int y = j-px; y < j+px+1 ; y++)
-		for (unsigned int x = i-px; x < i+px+1 ; x++){
-			unsigned int idx = index(x,y,0,0);
-			sPair<Type, int> p;
-			p.first  = this->operator[](idx);
-			p.second = idx;
-			colors.push_back(p);
-		}
+void mymatrix<Type>::rank(int px, int pz){
+	if (items_val == 0) return;
+	const long wx = 2 * max(px, 0) + 1, wz = 2 * max(pz, 0) + 1;
+	const long nx = NX, ny = NY, nz = NZ, nt = NT;
+	const long bx = (nx + wx - 1) / wx, by = (ny + wx - 1) / wx, bz = (nz + wz - 1) / wz;
+
+	Type   lo   = 0;
+	size_t bins = 0;
+	const bool counting = value_range(lo, bins, 256);
+	long b = 0;
+
+	#pragma omp parallel for private(b) schedule(dynamic)
+	for (b = 0; b < bx * by * bz * nt; b++){
+		const long x0 = (b % bx) * wx,        x1 = min(x0 + wx, nx);
+		const long y0 = ((b / bx) % by) * wx, y1 = min(y0 + wx, ny);
+		const long z0 = ((b / (bx * by)) % bz) * wz, z1 = min(z0 + wz, nz);
+		const long t  = b / (bx * by * bz);
+
+		vector< pair<Type, long> > colors;
+		for (long z = z0; z < z1; z++)
+			for (long y = y0; y < y1; y++)
+				for (long x = x0; x < x1; x++){
+					const long idx = x + nx * (y + ny * (z + nz * t));
+					colors.push_back(make_pair(matrix[idx], idx));
+				}
 
-		sort(colors.begin(), colors.end());
-		Type last_valid_rank = 0;
-		for (unsigned int it = 0; it < colors.size() ; it++){
-			int idx = colors[it].second;
-			if (it > 0 and  colors[it].first == colors[it-1].first){
-				this->operator[](idx) = last_valid_rank;
-			}
-			else {
-				this->operator[](idx) = (Type) it;
-				last_valid_rank = (Type) it;
+		if (counting){
+			vector<long> below(bins + 1, 0); // below[v+1] counts v, then prefix sums
+			for (size_t i = 0; i < colors.size(); i++) below[(size_t) (colors[i].first - lo) + 1]++;
+			for (size_t v = 1; v <= bins; v++) below[v] += below[v-1];
+			for (size_t i = 0; i < colors.size(); i++)
+				matrix[colors[i].second] = (Type) below[(size_t) (colors[i].first - lo)];
+		}
+		else {
+			sort(colors.begin(), colors.end());
+			long last_valid_rank = 0;
+			for (size_t it = 0; it < colors.size(); it++){
+				if (it == 0 or colors[it].first != colors[it-1].first) last_valid_rank = it;
+				matrix[colors[it].second] = (Type) last_valid_rank;
 			}
 		}
 	}
@@ -725,9 +1190,7 @@ void mymatrix<Type>::rank(int px){
  */
 template <class Type>
 void mymatrix<Type>::binarize(Type threshold){
-	for (unsigned int i = 0; i < items(); i++){
-		matrix[i] =  (matrix[i] < threshold) ? 0 :1;
-	}
+	*this = (*this >= threshold);
 }
 
 /**
@@ -792,73 +1255,278 @@ template <class Type>
 mymatrix<char>* mymatrix<Type>::mask(const Type threshold){
 	my_regular_grid grid(*this);
 	mymatrix<char> *mask = new mymatrix<char>(grid);
-	for (unsigned long i = 0; i < items_val; i++){
-		mask->operator[](i) = (matrix[i] > threshold ) ? (char) 1 : (char) 0;
-	}
+	*mask = (*this > threshold);
 	return mask;
 }
 
-/** average
+/** smooth_box
  *
- * Averages all pixel values within a window of edge length 2*px+1.
+ * Box filter (moving average) with a window of 2*px+1 pixels along one axis
+ * or along x, y and z (axis = -1). The window is clipped at the borders. It is
+ * computed with running sums, so the cost does not depend on px.
  *
  * \param px   : half of the pixel size of the window
+ * \param axis : 0..3 for x, y, z or t, -1 for all spatial axes
  */
 template <class Type>
-void mymatrix<Type>::average(int px){
+void mymatrix<Type>::smooth_box(int px, int axis){
+	view().smooth_box(px, axis);
+}
 
-	my_regular_grid grid = *this;
-	mymatrix<Type> result(grid);
-	int items = (2*px+1)*(2*px+1);
-
-	// get global minimum and maximum
-	Type gmin, gmax;
-	minmax(gmin, gmax);
-
-	for (unsigned int j = px; j < dims(1)-px; j++)
-	for (unsigned int i = px; i < dims(0)-px; i++){
-		double color = 0;
-		Type mean ;
-		Type min, max;
-		int cnt = 0;
-		for (unsigned int y = j-px; y < j+px+1 ; y++)
-		for (unsigned int x = i-px; x < i+px+1 ; x++){
-			unsigned int idx = index(x,y,0,0);
-			if (cnt++ == 0){
-				min = this->operator[](idx);
-				max = this->operator[](idx);
-			}
-			else{
-				min = (this->operator[](idx) < min ) ? this->operator[](idx): min;
-				max = (this->operator[](idx) > max ) ? this->operator[](idx): max;
+/** smooth_gaussian
+ *
+ * Gaussian smoothing along one axis or along x, y and z (axis = -1). The
+ * Gaussian is approximated by the recursive filter of Young and van Vliet
+ * (third order, forward and backward, with their published q(sigma)), so the
+ * cost does not depend on sigma. The result is an approximation: the impulse
+ * response differs from the Gaussian by up to about 5% of its peak for
+ * sigma = 2, 3% for sigma = 5 and less for larger sigma, and is somewhat
+ * wider than sigma. Sigma must be >= 0.5, smaller values leave the matrix
+ * unchanged. At the borders the image is continued with its border values.
+ *
+ * \param sigma : standard deviation in pixels
+ * \param axis  : 0..3 for x, y, z or t, -1 for all spatial axes
+ */
+template <class Type>
+void mymatrix<Type>::smooth_gaussian(double sigma, int axis){
+	view().smooth_gaussian(sigma, axis);
+}
+
+/** bilateral
+ *
+ * Edge preserving smoothing: each pixel becomes a mean of its neighbours
+ * weighted with their distance (Gaussian, sigma_s) and with the difference
+ * of their values (Gaussian, sigma_r), so intensity steps much larger than
+ * sigma_r are kept. The filter is approximated separably, one bilateral pass
+ * along x, y and z (Pham and van Vliet, 2005), so the cost is 3*(6*sigma_s+1)
+ * weights per pixel instead of (6*sigma_s+1)^3.
+ *
+ * \param sigma_s : spatial standard deviation in pixels
+ * \param sigma_r : standard deviation of the values (same unit as the data)
+ * \param axis    : 0..3 for x, y, z or t, -1 for all spatial axes
+ */
+template <class Type>
+void mymatrix<Type>::bilateral(double sigma_s, double sigma_r, int axis){
+	view().bilateral(sigma_s, sigma_r, axis);
+}
+
+/** anisotropic_diffusion
+ *
+ * Perona-Malik diffusion: an explicit solver of du/dt = div(g(|grad u|) grad u)
+ * with the conduction g = exp(-(d/kappa)^2) (DIFFUSION_EXPONENTIAL, keeps
+ * high-contrast edges) or g = 1/(1+(d/kappa)^2) (DIFFUSION_RATIONAL, prefers
+ * wide regions). Differences much smaller than kappa are smoothed, larger
+ * ones are preserved. The flux is computed to the 6 (4 in 2D) neighbours, no
+ * flux leaves the image. Frames are diffused independently.
+ *
+ * The values are computed as float in two buffers, which are swapped after
+ * each iteration. An iteration runs in parallel over the slices (z, t), the
+ * flux through a face in x and y is computed once for both pixels.
+ *
+ * \param iterations : maximal number of iterations
+ * \param kappa      : edge threshold (same unit as the data)
+ * \param tolerance  : stop, if the root mean square change of an iteration
+ *                     is below (0: run all iterations)
+ * \param conduction : DIFFUSION_EXPONENTIAL or DIFFUSION_RATIONAL
+ * \param dt         : time step, at most (and by default) the stable
+ *                     1/(2*sum(1/h^2))
+ * \param use_pixdim : distances in pixdim units, otherwise in pixels
+ * \return the number of iterations done
+ */
+template <class Type>
+int mymatrix<Type>::anisotropic_diffusion(int iterations, double kappa, double tolerance,
+										  int conduction, double dt, bool use_pixdim){
+	if (items_val == 0 or iterations <= 0 or kappa <= 0.) return 0;
+	const long nx = NX, ny = NY, nz = NZ, slabs = NZ * NT, plane = nx * ny;
+
+	float c[3];							// 1/h^2, 0 for axes with one pixel
+	double dt_max = 0.;
+	for (int a = 0; a < 3; a++){
+		const double h = (use_pixdim and v_pixdim[a] > 0.) ? v_pixdim[a] : 1.;
+		c[a] = (dimensions[a] > 1) ? 1. / (h * h) : 0.;
+		dt_max += 2. * c[a];
+	}
+	if (dt_max == 0.) return 0;
+	dt_max = 1. / dt_max;
+	if (dt <= 0. or dt > dt_max) dt = dt_max;
+
+	vector<float> buffer_a(matrix, matrix + items_val), buffer_b(items_val);
+	float *u = &buffer_a[0], *v = &buffer_b[0];
+	const float inv_k2 = 1. / (kappa * kappa), tau = dt;
+	const bool  rational = (conduction == DIFFUSION_RATIONAL);
+
+	int it = 0;
+	while (it < iterations){
+		double change = 0.;
+		#pragma omp parallel reduction(+:change)
+		{
+			// fluxes through the faces to the next pixel in x, y, z and to the
+			// previous slice; the y fluxes of the previous row are kept
+			vector<float> fx(nx, 0.f), fy(nx, 0.f), fy_prev(nx), fz(nx), fz_prev(nx);
+
+			#pragma omp for schedule(static)
+			for (long s = 0; s < slabs; s++){
+				const long k = s % nz;
+				std::fill(fy.begin(), fy.end(), 0.f);
+				for (long j = 0; j < ny; j++){
+					const float *row = u + s * plane + j * nx;
+					float *out = v + s * plane + j * nx;
+					fy_prev.swap(fy);
+					for (long i = 0; i < nx - 1; i++) fx[i] = c[0] * diffusion_flux(row[i + 1] - row[i], inv_k2, rational);
+					for (long i = 0; i < nx; i++){
+						fy[i]      = (j < ny - 1) ? c[1] * diffusion_flux(row[i + nx]    - row[i], inv_k2, rational) : 0.f;
+						fz[i]      = (k < nz - 1) ? c[2] * diffusion_flux(row[i + plane] - row[i], inv_k2, rational) : 0.f;
+						fz_prev[i] = (k > 0)      ? c[2] * diffusion_flux(row[i] - row[i - plane], inv_k2, rational) : 0.f;
+					}
+					for (long i = 0; i < nx; i++){
+						const float flux = ((i < nx - 1) ? fx[i] : 0.f) - ((i > 0) ? fx[i - 1] : 0.f)
+										 + fy[i] - fy_prev[i] + fz[i] - fz_prev[i];
+						out[i]  = row[i] + tau * flux;
+						change += (double) (tau * flux) * (tau * flux);
+					}
+				}
 			}
-			color += (double) this->operator[](idx);
 		}
+		swap(u, v);
+		it++;
+		if (tolerance > 0. and sqrt(change / items_val) < tolerance) break;
+	}
+
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++) matrix[i] = mymatrix_cast<Type>(u[i]);
+	return it;
+}
 
-		unsigned int idx = index(i,j,0,0);
-		mean = (Type) color/ items;
-		result[idx] = mean;
-
-		//unsigned int idx = index(i,j,0,0);
-		//Type gmean =  (Type) (((double) gmin + (double) gmax) / 2.);
-		//cout << this->operator[](idx) << " " << gmean << " " << mean << endl;
-		////if (this->operator[](idx) > mean) result[idx] = mean;
-
-		//if (this->operator[](idx) > mean and mean < gmean) result[idx] = 0;
-		////else
-		////if (this->operator[](idx) < mean and mean > gmean) result[idx] = 255;
-		//else
-			//result[idx] = mean;
-
-		//if (this->operator[](idx) > mean) result[idx] = mean;
-		//else
-		//result[idx] = this->operator[](idx);
-		//result[idx] = 0;
+/** erode
+ *
+ * Grey-scale erosion (minimum) with a box of 2*px+1 pixels along one axis
+ * or along x, y and z (axis = -1). For binary masks the objects shrink. The
+ * cost does not depend on px (see mymatrix_view::minmax_lines()).
+ *
+ * \param px   : half of the edge length of the box
+ * \param axis : 0..3 for x, y, z or t, -1 for all spatial axes
+ */
+template <class Type>
+void mymatrix<Type>::erode(int px, int axis){
+	view().erode(px, axis);
+}
+
+/** dilate
+ *
+ * Grey-scale dilation (maximum) with a box, see erode().
+ */
+template <class Type>
+void mymatrix<Type>::dilate(int px, int axis){
+	view().dilate(px, axis);
+}
+
+/** opening
+ *
+ * Erosion followed by dilation with a box: removes objects and spikes
+ * smaller than the box.
+ */
+template <class Type>
+void mymatrix<Type>::opening(int px, int axis){
+	erode(px, axis);
+	dilate(px, axis);
+}
+
+/** closing
+ *
+ * Dilation followed by erosion with a box: closes holes and gaps smaller
+ * than the box.
+ */
+template <class Type>
+void mymatrix<Type>::closing(int px, int axis){
+	dilate(px, axis);
+	erode(px, axis);
+}
+
+/** erode_sphere
+ *
+ * Binary erosion with a sphere: all object pixels (not background) within
+ * the radius of a background pixel become background. Uses the distance
+ * transform, so the cost does not depend on the radius. Pixels outside of
+ * the matrix do not count as background.
+ *
+ * \param radius     : radius of the sphere
+ * \param background : the value of the background
+ * \param use_pixdim : radius in units of pixdim(), else in pixels
+ */
+template <class Type>
+void mymatrix<Type>::erode_sphere(double radius, Type background, bool use_pixdim){
+	const float inf = numeric_limits<float>::infinity();
+	const double r2 = radius * radius * (1. + 1e-6);
+	vector<float> d2(items_val);
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++) d2[i] = (matrix[i] == background) ? 0.f : inf;
+	distance_kernel(&d2[0], 0, use_pixdim);
+
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++) if (d2[i] <= r2) matrix[i] = background;
+}
+
+/** dilate_sphere
+ *
+ * Binary dilation with a sphere: background pixels within the radius of an
+ * object pixel get the value of the nearest object pixel, so labels are
+ * kept. Uses the feature transform, the cost does not depend on the radius.
+ *
+ * \param radius     : radius of the sphere
+ * \param background : the value of the background
+ * \param use_pixdim : radius in units of pixdim(), else in pixels
+ */
+template <class Type>
+void mymatrix<Type>::dilate_sphere(double radius, Type background, bool use_pixdim){
+	const float inf = numeric_limits<float>::infinity();
+	const double r2 = radius * radius * (1. + 1e-6);
+	vector<float> d2(items_val);
+	vector<int>   feature(items_val);
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++){
+		const bool site = (matrix[i] != background);
+		d2[i]      = site ? 0.f : inf;
+		feature[i] = site ? (int) i : -1;
 	}
+	distance_kernel(&d2[0], &feature[0], use_pixdim);
 
-	// copy all entries
-	for (unsigned int i = 0; i < this->items() ; i++)
-		this->operator[](i) = result[i];
+	// only background pixels are written, the features are object pixels
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++)
+		if (d2[i] > 0.f and d2[i] <= r2) matrix[i] = matrix[feature[i]];
+}
+
+/** opening_sphere
+ *
+ * Binary opening with a sphere (erode_sphere() and dilate_sphere()).
+ */
+template <class Type>
+void mymatrix<Type>::opening_sphere(double radius, Type background, bool use_pixdim){
+	erode_sphere(radius, background, use_pixdim);
+	dilate_sphere(radius, background, use_pixdim);
+}
+
+/** closing_sphere
+ *
+ * Binary closing with a sphere (dilate_sphere() and erode_sphere()).
+ */
+template <class Type>
+void mymatrix<Type>::closing_sphere(double radius, Type background, bool use_pixdim){
+	dilate_sphere(radius, background, use_pixdim);
+	erode_sphere(radius, background, use_pixdim);
+}
+
+/** average
+ *
+ * Averages all pixel values within a window of edge length 2*px+1 in the
+ * xy-plane of every slice (see smooth_box()).
+ *
+ * \param px   : half of the pixel size of the window
+ */
+template <class Type>
+void mymatrix<Type>::average(int px){
+	smooth_box(px, 0);
+	smooth_box(px, 1);
 }
 
 /** name:mymatrix::get_slice()
@@ -919,12 +1587,7 @@ bool mymatrix<Type>::adjust_contrast(Type new_min, Type new_max){
 	Type new_diff = new_max - new_min;
 
 	double ratio =  ((double) new_diff/ (double )diff);
-	#pragma omp parallel for
-	for (long i = 0; i < (long) items_val; i++){
-		matrix[i] -= mini;
-		matrix[i] = (Type) (matrix[i]  * ratio);
-		matrix[i] += new_min;
-		}
+	*this = (*this - mini) * ratio + new_min;
 	#ifdef DEBUG
 		print("...ready.");
 	#endif
@@ -933,13 +1596,45 @@ bool mymatrix<Type>::adjust_contrast(Type new_min, Type new_max){
 
 template <class Type>
 double mymatrix<Type>::mean_value(){
-	double value;
-	for (unsigned long i = 0;i < items_val ;i++ ) value += (double)matrix[i];
+	return statistics().mean;
+}
 
-	value /= (double) items_val;
-	return value;
+/**
+ * name: mymatrix::statistics
+ * Computes count, minimum, maximum, sum, mean and variance in one pass
+ * (see mymatrix_view::compute_statistics()).
+ * \param mask : only items where the mask is not 0 are used (optional)
+ */
+template <class Type>
+mymatrix_statistics mymatrix<Type>::statistics(mymatrix<char> *mask){
+	if (not mask) return view().statistics();
+	mymatrix_view<char> m = mask->view();
+	return view().statistics(&m);
+}
+
+/**
+ * name: mymatrix::statistics
+ * Like statistics(), but also counts the values in a histogram with a fixed
+ * number of bins in [lo, hi).
+ */
+template <class Type>
+mymatrix_statistics mymatrix<Type>::statistics(size_t bins, double lo, double hi, mymatrix<char> *mask){
+	if (not mask) return view().statistics(bins, lo, hi);
+	mymatrix_view<char> m = mask->view();
+	return view().statistics(bins, lo, hi, &m);
 }
 
+/**
+ * name: mymatrix::histogram
+ * Statistics with an exact histogram: one bin for each value between the
+ * minimum and the maximum (see mymatrix_view::histogram()).
+ */
+template <class Type>
+mymatrix_statistics mymatrix<Type>::histogram(mymatrix<char> *mask){
+	if (not mask) return view().histogram();
+	mymatrix_view<char> m = mask->view();
+	return view().histogram(&m);
+}
 
 template <class Type>
 void mymatrix<Type>::detect_edgesXY(Type epsilon){
@@ -1033,13 +1728,9 @@ void mymatrix<Type>::detect_HIGH_edgesXY(Type epsilon){
 
 template <class Type>
 void mymatrix<Type>::minmax(Type &min, Type &max){
-	min = this->matrix[0];
-	max = this->matrix[0];
-
-	for (unsigned long i = 0; i < items_val; i++){
-		min = ( this->matrix[i] < min ) ? this->matrix[i] : min;
-		max = ( this->matrix[i] > max ) ? this->matrix[i] : max;
-	}
+	mymatrix_statistics stats = statistics();
+	min = (Type) stats.min;
+	max = (Type) stats.max;
 	return;
 }
 
@@ -1064,7 +1755,14 @@ bool mymatrix<Type>::save_histogram(string fn, bool inc_null){
 	map<Type, int> Histogram;
 
 	//compute the histogram
-	for (unsigned long j = 0; j < items_val; j++) Histogram[matrix[j]]++;
+	mymatrix_statistics stats;
+	if (numeric_limits<Type>::is_integer) stats = histogram();
+	if (not stats.histogram.empty()){
+		for (size_t b = 0; b < stats.histogram.size(); b++)
+			if (stats.histogram[b]) Histogram[(Type) stats.bin_value(b)] = stats.histogram[b];
+	} else {	// floating point values or a very wide range
+		for (unsigned long j = 0; j < items_val; j++) Histogram[matrix[j]]++;
+	}
 
 	/** save the histogram */
 	ofstream outfile;
@@ -1097,10 +1795,12 @@ bool mymatrix<Type>::save_histogram(string fn, bool inc_null){
  * @param which_slice	: which slice
  * @param redblue		: force color scale from red to blue
  * @param png 			: forces png output instead of x11
+ * @param binary		: write the data as gnuplot binary matrix (see
+ * 						  save_gnuplot_binary()) into file_base(fn).bin
  * @return Nothing.
  */
 template <class Type>
-void mymatrix<Type>::save_to_pm3dmap(string fn, unsigned int which_slice, bool redblue, bool png){
+void mymatrix<Type>::save_to_pm3dmap(string fn, unsigned int which_slice, bool redblue, bool png, bool binary){
 
 	switch (dim()){
 	case 2:
@@ -1117,17 +1817,24 @@ void mymatrix<Type>::save_to_pm3dmap(string fn, unsigned int which_slice, bool r
 		}
 	}
 
-	// write file containing data values as matrix (in gnuplot style)
-	ofstream out;
-	out.open(fn.c_str());
-	for (unsigned int j = 0; j < dims(1); j++){ // y = columns
-		for (unsigned int i = 0; i < dims(0); i++){ // x = rows
-			unsigned int idx = index(i,j,which_slice);
-			out << this->at(idx) << " ";
+	mystring fn2(fn);
+	if (binary){ // float values, no formatting
+		fn2 = fn2.file_base(true) + ".bin";
+		save_gnuplot_binary(mystring(fn).file_base() + ".bin", which_slice);
+	} else {
+		// write file containing data values as matrix (in gnuplot style)
+		fn2 = fn2.file_base(true) + ".dat";
+		ofstream out;
+		out.open(fn.c_str());
+		for (unsigned int j = 0; j < dims(1); j++){ // y = columns
+			for (unsigned int i = 0; i < dims(0); i++){ // x = rows
+				unsigned int idx = index(i,j,which_slice);
+				out << this->at(idx) << " ";
+			}
+		out << endl;
 		}
-	out << endl;
+		out.close();
 	}
-	out.close();
 
 	// gnuplot command file
 	ofstream gnu;
@@ -1135,8 +1842,6 @@ void mymatrix<Type>::save_to_pm3dmap(string fn, unsigned int which_slice, bool r
 	gnufile = gnufile.file_base() + ".gnu";
 	mystring pngfile(fn);
 	pngfile = pngfile.file_base(true) + ".png";
-	mystring fn2(fn);
-	fn2 = fn2.file_base(true) + ".dat";
 
 	gnu.open(gnufile.c_str());
 	gnu << "set terminal x11" << endl;
@@ -1147,14 +1852,14 @@ void mymatrix<Type>::save_to_pm3dmap(string fn, unsigned int which_slice, bool r
 	gnu << "set pm3d map"<< endl;
 
 	gnu << "set xtics (" ;
-	int xstep = dims(0)/4;
+	int xstep = max(dims(0)/4, (size_t) 1);
 	for (unsigned int i = 0; i < dims(0); i+=xstep){
 		gnu << "\""<< origin(0) + i * pixdim(0) << "\"" << " " << i <<", ";
 	}
 	gnu << "\""<< origin(0) + dims(0) * pixdim(0) <<"\"" << " " << dims(0) <<" )" << endl;
 
 	gnu << "set ytics (" ;
-	int ystep = dims(1)/4;
+	int ystep = max(dims(1)/4, (size_t) 1);
 	for (unsigned int i = 0; i < dims(1); i+=ystep){
 		gnu << "\""<< origin(1) + i * pixdim(1) <<"\"" << " " << i <<", ";
 	}
@@ -1168,7 +1873,7 @@ void mymatrix<Type>::save_to_pm3dmap(string fn, unsigned int which_slice, bool r
 	if (not redblue) gnu << "#";
 	gnu << "set palette defined ("<< minimum <<" \"blue\", 0 \"white\", "<< maximum  << " \"red\") " << endl;
 
-	gnu << "splot \""<< fn2 << "\" matrix" << endl;
+	gnu << "splot \""<< fn2 << "\"" << (binary ? " binary" : "") << " matrix" << endl;
 
 	if (png) gnu << "#";
 	gnu << "pause -1" << endl;
@@ -1185,129 +1890,635 @@ void mymatrix<Type>::save_to_pm3dmap(string fn, unsigned int which_slice, bool r
 	return;
 }
 
-/** name: flood_fill
- * Fills a matrix with a certain color value unless a order is found.
- *  - avoiding recursion, which increases stability
- *  - implemented for xy planes for the moment.
- * 	- threshhold can be imlemented by adding a range to color_start check
- * \param color	: The color value to fill the data
- * \param itm	: The index of the pixel which should be coloured first
+/**
+ * name: mymatrix::save_gnuplot_binary
+ *
+ * Saves the slice (z, t) in the binary matrix format of gnuplot, which is
+ * plotted with: splot "file" binary matrix
+ * All values are 32 bit floats: the first row holds the number of columns
+ * and the x-indices, every further row the y-index and the values of one
+ * line. No value is formatted as text.
+ *
+ * @param fn			: name of the file
+ * @param which_slice	: index in z
+ * @param t				: index in t
+ * @return false, if the file could not be written
  */
 template <class Type>
-void mymatrix<Type>::flood_fill(Type color, size_t itm){
-	if (itm >= items()) return;  // index was out of range
+bool mymatrix<Type>::save_gnuplot_binary(string fn, size_t which_slice, size_t t){
+	if (which_slice >= NZ or t >= NT) throw mymatrix_exception(INVALID_SLICE_FAILURE);
+	FILE *ou = fopen(fn.c_str(), "wb");
+	if (not ou){
+		cerr << "Could not open " << fn << endl;
+		return false;
+	}
+	vector<float> row(NX + 1);
+	row[0] = (float) NX;
+	for (size_t i = 0; i < NX; i++) row[i + 1] = (float) i;
+	bool ok = (fwrite(&row[0], sizeof(float), NX + 1, ou) == NX + 1);
+	for (size_t j = 0; ok and j < NY; j++){
+		const Type *in = matrix + index(0, j, which_slice, t);
+		row[0] = (float) j;
+		for (size_t i = 0; i < NX; i++) row[i + 1] = (float) in[i];
+		ok = (fwrite(&row[0], sizeof(float), NX + 1, ou) == NX + 1);
+	}
+	fclose(ou);
+	return ok;
+}
 
-	if (dim() != 2 ){
-		cerr << "Error: The function flood fill is implemented for 2d only" << endl;
+/**
+ * name: mymatrix::save_slices_gnuplot_binary
+ *
+ * Saves all slices with save_gnuplot_binary() in parallel, one file per
+ * slice: file_base(fn)_zzzzzz.bin, for 4D data file_base(fn)_zzzzzz_tttttt.bin
+ *
+ * @return the number of files written
+ */
+template <class Type>
+size_t mymatrix<Type>::save_slices_gnuplot_binary(string fn){
+	const string base = mystring(fn).file_base();
+	const long slices = NZ * NT;
+	long written = 0;
+	#pragma omp parallel for reduction(+:written) schedule(dynamic)
+	for (long s = 0; s < slices; s++)
+		if (save_gnuplot_binary(mymatrix_slice_name(base, s % NZ, s / NZ, NT, ".bin"), s % NZ, s / NZ)) written++;
+	return written;
+}
+
+/** union_find_root
+ * Root of the tree of i in a union-find forest, the path is halved on the
+ * way.
+ */
+inline unsigned int union_find_root(unsigned int *parent, unsigned int i){
+	while (parent[i] != i) {parent[i] = parent[parent[i]]; i = parent[i];}
+	return i;
+}
+
+/** union_find_link
+ * Joins the tree of i with the tree of root r and returns the new root (the
+ * smaller of both roots).
+ */
+inline unsigned int union_find_link(unsigned int *parent, unsigned int r, unsigned int i){
+	i = union_find_root(parent, i);
+	if (i == r) return r;
+	if (i < r) {parent[r] = i; return i;}
+	parent[i] = r;
+	return r;
+}
+
+/** name: mymatrix::component_labels
+ * Connected component labelling with union-find. Two neighbouring pixels
+ * belong to the same component if they have the same value. Components never
+ * extend over different frames (t).
+ *
+ * The slices are divided into slabs which are labelled in parallel, the
+ * components are linked across the slab borders afterwards. Every component
+ * is represented by its first pixel (in memory order), so the labels are
+ * numbered in the order of their first pixel and do not depend on the
+ * number of threads.
+ *
+ * \param labels       : returns one label per pixel (1, 2, ...) and 0 for
+ * 						 the background
+ * \param connectivity : 6 (faces), 18 (faces and edges) or 26 (faces, edges and
+ * 						 corners), in 2D this is 4, 8 and 8 neighbours
+ * \param use_background: if false, there is no background
+ * \param background   : pixels with this value are not labelled
+ * \return the number of components
+ */
+template <class Type>
+size_t mymatrix<Type>::component_labels(vector<unsigned int> &labels, int connectivity,
+                                        bool use_background, Type background){
+	if (connectivity != 6 and connectivity != 18 and connectivity != 26)
 		throw mymatrix_exception(DIMENSION_FAILURE);
+	if (items_val >= (size_t) UINT_MAX) throw mymatrix_exception(INDEX_OUT_OF_RANGE_FAILURE);
+
+	const unsigned int none = UINT_MAX;
+	const long nx = NX, ny = NY, nz = NZ;
+	const long slice  = nx * ny;
+	const long layers = items_val / slice; // z-slices of all frames
+
+	// neighbours which come before a pixel in memory (dx,dy,dz)
+	int nb[13][3], nr_nb = 0;
+	for (int z = -1; z <= 0; z++)
+		for (int y = -1; y <= 1; y++)
+			for (int x = -1; x <= 1; x++){
+				if (z == 0 and (y > 0 or (y == 0 and x >= 0))) continue;
+				const int d = abs(x) + abs(y) + abs(z);
+				if (d > 1 and connectivity == 6)  continue;
+				if (d > 2 and connectivity == 18) continue;
+				nb[nr_nb][0] = x; nb[nr_nb][1] = y; nb[nr_nb][2] = z; nr_nb++;
+			}
+
+	vector<unsigned int> parent(items_val);
+
+	// links pixel v = (x,y,z) with root r to its k-th neighbour, if both have the same value
+	#define MYMATRIX_LINK(v, r, x, y, k) { \
+		const long xn = (x) + nb[k][0], yn = (y) + nb[k][1]; \
+		if (xn >= 0 and xn < nx and yn >= 0 and yn < ny) { \
+			const unsigned int u = (unsigned int) ((v) + nb[k][0] + nb[k][1] * nx + nb[k][2] * slice); \
+			if (parent[u] != none and matrix[u] == matrix[v]) r = union_find_link(&parent[0], r, u); } }
+
+	const long chunk     = 8; // slices per slab
+	const long nr_chunks = (layers + chunk - 1) / chunk;
+	long c = 0;
+
+	#pragma omp parallel for private(c) schedule(dynamic)
+	for (c = 0; c < nr_chunks; c++){
+		const long l0 = c * chunk, l1 = min(l0 + chunk, layers);
+		for (long l = l0; l < l1; l++){
+			const long z = l % nz; // no links below the slab or the frame
+			for (long y = 0; y < ny; y++)
+				for (long x = 0; x < nx; x++){
+					const unsigned int v = (unsigned int) (l * slice + y * nx + x);
+					if (use_background and matrix[v] == background){ parent[v] = none; continue;}
+					parent[v] = v;
+					unsigned int r = v;
+					// with 26 neighbours, all neighbours of v with dx <= 0 are also
+					// neighbours of v-1, so if v-1 is linked only dx = 1 is left
+					const bool run = (connectivity == 26 and x > 0 and parent[v-1] != none and matrix[v-1] == matrix[v]);
+					if (run) r = union_find_link(&parent[0], r, v - 1);
+					for (int k = 0; k < nr_nb; k++){
+						if (nb[k][2] < 0 and (l == l0 or z == 0)) continue;
+						if (run and nb[k][0] < 1) continue;
+						MYMATRIX_LINK(v, r, x, y, k);
+					}
+				}
+		}
+	}
+
+	// merge: link the first slice of every slab to the slice below
+	for (c = 1; c < nr_chunks; c++){
+		const long l = c * chunk, z = l % nz;
+		if (z == 0) continue; // new frame
+		for (long y = 0; y < ny; y++)
+			for (long x = 0; x < nx; x++){
+				const unsigned int v = (unsigned int) (l * slice + y * nx + x);
+				if (parent[v] == none) continue;
+				unsigned int r = union_find_root(&parent[0], v);
+				for (int k = 0; k < nr_nb; k++)
+					if (nb[k][2] < 0) MYMATRIX_LINK(v, r, x, y, k);
+			}
+	}
+
+	#undef MYMATRIX_LINK
+
+	// find the roots, number them in memory order and assign the numbers
+	labels.resize(items_val);
+	long i = 0;
+	#pragma omp parallel for private(i)
+	for (i = 0; i < (long) items_val; i++){
+		if (parent[i] == none) {labels[i] = none; continue;}
+		unsigned int r = parent[i];
+		while (parent[r] != r) r = parent[r];
+		labels[i] = r;
+	}
+
+	const long blocks = (items_val + 65535) / 65536;
+	vector<unsigned int> first(blocks + 1, 0);
+	#pragma omp parallel for private(i)
+	for (i = 0; i < blocks; i++){
+		const long last = min((i + 1) * 65536, (long) items_val);
+		for (long j = i * 65536; j < last; j++) if (labels[j] == (unsigned int) j) first[i+1]++;
+	}
+	for (i = 0; i < blocks; i++) first[i+1] += first[i];
+
+	#pragma omp parallel for private(i)
+	for (i = 0; i < blocks; i++){
+		unsigned int id = first[i];
+		const long last = min((i + 1) * 65536, (long) items_val);
+		for (long j = i * 65536; j < last; j++) if (labels[j] == (unsigned int) j) parent[j] = ++id;
 	}
 
-	Type color_start = matrix[itm];		// start pixel: save it's color
+	#pragma omp parallel for private(i)
+	for (i = 0; i < (long) items_val; i++)
+		labels[i] = (labels[i] == none) ? 0 : parent[labels[i]];
 
-	if (color_start == color) return; // color is already set
+	return first[blocks];
+}
+
+/** name: mymatrix::label_components
+ * Labels the connected regions of equal value (background excluded), so
+ * each label of a multi-label segmentation gives separate components (see
+ * component_labels()).
+ *
+ * \param nr_labels    : returns the number of components
+ * \param connectivity : 6, 18 or 26
+ * \param background   : the value of the background
+ * \return a new matrix with the labels 1...nr_labels and 0 for the background
+ */
+template <class Type>
+mymatrix<int>* mymatrix<Type>::label_components(size_t &nr_labels, int connectivity, Type background){
+	vector<unsigned int> labels;
+	nr_labels = component_labels(labels, connectivity, true, background);
+
+	my_regular_grid grid(*this);
+	mymatrix<int> *result = new mymatrix<int>(grid);
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++) result->operator[](i) = (int) labels[i];
+	return result;
+}
 
-	myStack<size_t> stack;
-	stack.push(itm); // put the start element on the stack
+/** name: mymatrix::remove_components
+ * Sets all connected regions of equal value (background excluded) with less
+ * than min_size pixels to the background value, e.g. to remove islands of
+ * each label from a segmentation.
+ *
+ * \param min_size     : smallest number of pixels of a component to keep
+ * \param connectivity : 6, 18 or 26
+ * \param background   : the value of the background
+ * \return the number of removed components
+ */
+template <class Type>
+size_t mymatrix<Type>::remove_components(size_t min_size, int connectivity, Type background){
+	vector<unsigned int> labels;
+	const size_t nr_labels = component_labels(labels, connectivity, true, background);
 
-	while ( not stack.empty() ) {
-		size_t idx = stack.takeout();
-//		print(stack.size());
-		if ( matrix[idx] == color_start) { // ckeck the color
-			matrix[idx] = color;		// change the color
+	vector<size_t> size(nr_labels + 1, 0);
+	for (size_t i = 0; i < items_val; i++) size[labels[i]]++;
 
-			stack.push(idx + dx);		// put the neigbours into the stack
-			stack.push(idx - dx);		//! \attention movement is only in xy plane
-			stack.push(idx + dy);
-			stack.push(idx - dy);
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++)
+		if (labels[i] > 0 and size[labels[i]] < min_size) matrix[i] = background;
+
+	size_t removed = 0;
+	for (size_t l = 1; l <= nr_labels; l++) if (size[l] < min_size) removed++;
+	return removed;
+}
+
+/** distance_kernel
+ *
+ * Exact squared Euclidean distance transform (Felzenszwalb and Huttenlocher,
+ * separable like the algorithm of Maurer et al.). The 1D transform is
+ * applied to all lines along x, y and z in turn, each in linear time by
+ * computing the lower envelope of the parabolas of all sites of the line.
+ * The lines of an axis are processed in parallel. The frames of 4D data
+ * are transformed independently.
+ *
+ * \param d2         : 0 at the sites, infinity elsewhere, returns the squared
+ *                     distance to the nearest site
+ * \param feature    : the index of each site at the sites (optional),
+ *                     returns the index of the nearest site or -1
+ * \param use_pixdim : distances in units of pixdim(), else in voxels
+ */
+template <class Type>
+void mymatrix<Type>::distance_kernel(float *d2, int *feature, bool use_pixdim){
+	const float inf = numeric_limits<float>::infinity();
+	const size_t slice = NX * NY, volume = slice * NZ;
+
+	for (int axis = 0; axis < 3; axis++){
+		const size_t n = dimensions[axis];
+		if (n < 2) continue;
+		const double h  = (use_pixdim and v_pixdim[axis] != 0.) ? v_pixdim[axis] : 1.;
+		const double h2 = h * h;
+		const size_t stride = (axis == 0) ? 1 : ((axis == 1) ? NX : slice);
+		const long   lines  = (long) (items_val / n);
+
+		#pragma omp parallel
+		{
+			vector<float>  f(n), out(n);
+			vector<int>    feat(n), feat_out(n);
+			vector<size_t> v(n);		// sites of the lower envelope
+			vector<double> z(n + 1);	// borders between the parabolas
+
+			#pragma omp for schedule(static)
+			for (long L = 0; L < lines; L++){
+				size_t base;
+				if (axis == 0)      base = L * NX;
+				else if (axis == 1) base = (L / NX) * slice + L % NX;
+				else                base = (L / slice) * volume + L % slice;
+
+				for (size_t q = 0; q < n; q++) f[q] = d2[base + q * stride];
+				if (feature) for (size_t q = 0; q < n; q++) feat[q] = feature[base + q * stride];
+
+				// lower envelope of the parabolas h2*(q-p)^2 + f(p), only finite sites
+				long k = -1;
+				for (size_t q = 0; q < n; q++){
+					if (f[q] == inf) continue;
+					double s = -numeric_limits<double>::infinity();
+					while (k >= 0){
+						const size_t p = v[k];
+						s = ((f[q] + h2 * q * q) - (f[p] + h2 * p * p)) / (2. * h2 * ((double) q - (double) p));
+						if (s > z[k]) break;
+						k--;
+					}
+					if (k < 0) s = -numeric_limits<double>::infinity();
+					v[++k] = q;
+					z[k]   = s;
+				}
+				if (k < 0) continue;		// no site on this line
+				z[k + 1] = numeric_limits<double>::infinity();
+
+				long j = 0;
+				for (size_t q = 0; q < n; q++){
+					while (z[j + 1] < (double) q) j++;
+					const double dq = (double) q - (double) v[j];
+					out[q] = (float) (h2 * dq * dq + f[v[j]]);
+					if (feature) feat_out[q] = feat[v[j]];
+				}
+				for (size_t q = 0; q < n; q++) d2[base + q * stride] = out[q];
+				if (feature) for (size_t q = 0; q < n; q++) feature[base + q * stride] = feat_out[q];
+			}
 		}
 	}
-	return;
 }
 
- /** name: flood_fill_recursive
- * Fills a matrix with a certain color value unless a order is found.
- *  - recursive algorithm
- *  - implemented for xy planes for thr moment.
- * 	- threshhold can be imlemented by adding a range to color_start check
- * \todo Test for iteration depth > segfaults when depth is to high
- * \param color	: The color value to fille the data
- * \param itm	: The index of the pixel which should be coloured
- * \param first : Should be true if called from outside. Recursive calls shall
- * 				  call flood_fill with first=false)
+/** name: mymatrix::distance_map
+ * Euclidean distance of each pixel to the nearest pixel which is not
+ * background (0 for those pixels). Pixels of a frame without any object get
+ * infinity. See distance_kernel().
+ *
+ * \param background : the value of the background
+ * \param use_pixdim : distances in units of pixdim(), else in pixels
+ * \param squared    : return the squared distances
+ * \return a new matrix with the distances
  */
 template <class Type>
-void mymatrix<Type>::flood_fill_recursive(Type color, size_t itm, bool first){
+mymatrix<float>* mymatrix<Type>::distance_map(Type background, bool use_pixdim, bool squared){
+	my_regular_grid grid(*this);
+	mymatrix<float> *result = new mymatrix<float>(grid);
+	float *d = result->data();
+	const float inf = numeric_limits<float>::infinity();
 
-	static Type color_start;
-	static int iter = 0;
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++) d[i] = (matrix[i] == background) ? inf : 0.f;
+	distance_kernel(d, 0, use_pixdim);
+	if (not squared){
+		#pragma omp parallel for
+		for (long i = 0; i < (long) items_val; i++) d[i] = sqrt(d[i]);
+	}
+	return result;
+}
 
-	if (first) iter = 0;
-	iter++;
-//	print(itm << " " << items());
-	print(iter);
-	if ((itm < 0) || (itm >= items())) return;  // index was out of range
+/** name: mymatrix::signed_distance_map
+ * Signed distance to the border of the objects: outside of the objects the
+ * distance to the nearest object pixel, inside the negative distance to the
+ * nearest background pixel.
+ *
+ * \param background : the value of the background
+ * \param use_pixdim : distances in units of pixdim(), else in pixels
+ * \return a new matrix with the signed distances
+ */
+template <class Type>
+mymatrix<float>* mymatrix<Type>::signed_distance_map(Type background, bool use_pixdim){
+	mymatrix<float> *result = distance_map(background, use_pixdim);
+	float *d = result->data();
+	const float inf = numeric_limits<float>::infinity();
 
-	if ( first ) color_start = matrix[itm];		// if startign pixel then save it's color
+	vector<float> inside(items_val);
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++) inside[i] = (matrix[i] == background) ? 0.f : inf;
+	distance_kernel(&inside[0], 0, use_pixdim);
 
-	if ( matrix[itm] != color_start) return; 	// stop if color doesn't match
-	else matrix[itm] = color;					// else set the color
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++)
+		if (matrix[i] != background) d[i] = -sqrt(inside[i]);
+	return result;
+}
 
-	// fill the neighbouring pixels
-	flood_fill(color, itm + dx, false);
-	flood_fill(color, itm - dx, false);
-	flood_fill(color, itm + dy, false);
-	flood_fill(color, itm - dy, false);
-	return;
+/** name: mymatrix::feature_transform
+ * Index of the nearest pixel which is not background for each pixel (the
+ * pixel itself for object pixels), -1 in frames without any object.
+ *
+ * \param background : the value of the background
+ * \param use_pixdim : distances in units of pixdim(), else in pixels
+ * \return a new matrix with the indices
+ */
+template <class Type>
+mymatrix<int>* mymatrix<Type>::feature_transform(Type background, bool use_pixdim){
+	my_regular_grid grid(*this);
+	mymatrix<int> *result = new mymatrix<int>(grid);
+	int *feature = result->data();
+	const float inf = numeric_limits<float>::infinity();
+
+	vector<float> d2(items_val);
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++){
+		const bool site = (matrix[i] != background);
+		d2[i]      = site ? 0.f : inf;
+		feature[i] = site ? (int) i : -1;
+	}
+	distance_kernel(&d2[0], feature, use_pixdim);
+	return result;
 }
 
+/** name: mymatrix::region_fill
+ * Fills the connected region of pixels with the same value as the seed
+ * pixel with a new value. Works in 2D and 3D, frames are filled separately.
+ *
+ * \param color        : the new value
+ * \param seed         : index of the seed pixel
+ * \param connectivity : 6, 18 or 26
+ * \return the number of pixels which were filled
+ */
+template <class Type>
+size_t mymatrix<Type>::region_fill(Type color, size_t seed, int connectivity){
+	if (seed >= items_val or matrix[seed] == color) return 0;
+
+	vector<unsigned int> labels;
+	component_labels(labels, connectivity, false, color);
+	const unsigned int region = labels[seed];
 
+	size_t filled = 0;
+	#pragma omp parallel for reduction(+:filled)
+	for (long i = 0; i < (long) items_val; i++)
+		if (labels[i] == region) {matrix[i] = color; filled++;}
+	return filled;
+}
+
+/** name: flood_fill
+ * Fills a matrix with a certain color value unless a order is found.
+ * The region of pixels with the color of the start pixel is filled, direct
+ * neighbours (6-connectivity, 4 in 2D) are used (see region_fill()).
+ * \param color	: The color value to fill the data
+ * \param itm	: The index of the pixel which should be coloured first
+ */
+template <class Type>
+void mymatrix<Type>::flood_fill(Type color, size_t itm){
+	region_fill(color, itm, 6);
+}
+
+ /** name: flood_fill_recursive
+ * Fills a matrix with a certain color value unless a order is found.
+ * Kept for compatibility, the fill is done without recursion by flood_fill().
+ * \param color	: The color value to fille the data
+ * \param itm	: The index of the pixel which should be coloured
+ * \param first : ignored
+ */
 template <class Type>
+void mymatrix<Type>::flood_fill_recursive(Type color, size_t itm, bool first){
+	(void) first;
+	flood_fill(color, itm);
+}
+
+
 /** name: mymatrix::resolution2x
- * Increases the resolution by the factor 2.
+ * Increases the resolution by the factor 2 in x, y and z, each voxel is
+ * replaced by 2x2x2 copies. The pixel dimensions are halved (a pixdim of 0
+ * is taken as 1), the origin stays the same. See upsample2x() for an
+ * interpolated version, which returns a new matrix.
 **/
+template <class Type>
 void mymatrix<Type>::resolution2x(){
-	my_regular_grid grid = *this;
-	grid.dims(grid.dims(0) * 2,grid.dims(1) * 2,grid.dims(2) * 2, grid.dims(3));
-	mymatrix<Type> result(grid);
-
-
-	for (unsigned int t = 0; t < dims(3) ; t++){
-	for (unsigned int k = 0; k < dims(2); k++){
-	for (unsigned int j = 0; j < dims(1); j++){
-	for (unsigned int i = 0; i < dims(0); i++){
-		unsigned int idx   = index(i,j,k,t);
-		result[result.index(2*i  ,2*j  ,2*k  ,t  )] = this->operator[](idx);
-		result[result.index(2*i+1,2*j  ,2*k  ,t  )] = this->operator[](idx);
-		result[result.index(2*i  ,2*j+1,2*k  ,t  )] = this->operator[](idx);
-		result[result.index(2*i+1,2*j  ,2*k  ,t  )] = this->operator[](idx);
-		result[result.index(2*i+1,2*j+1,2*k  ,t  )] = this->operator[](idx);
-		result[result.index(2*i  ,2*j  ,2*k+1,t  )] = this->operator[](idx);
-		result[result.index(2*i  ,2*j+1,2*k+1,t  )] = this->operator[](idx);
-		result[result.index(2*i+1,2*j  ,2*k+1,t  )] = this->operator[](idx);
-		result[result.index(2*i+1,2*j+1,2*k+1,t  )] = this->operator[](idx);
-	}
-	}
+	const long nx = NX, ny = NY, nz = NZ;
+	const long lines = 4 * ny * nz * NT;
+	Type *result = new Type[8 * items_val];
+
+	#pragma omp parallel for schedule(static)
+	for (long n = 0; n < lines; n++){
+		const long j = n % (2 * ny), k = (n / (2 * ny)) % (2 * nz), l = n / (4 * ny * nz);
+		const Type *in = matrix + ((l * nz + k / 2) * ny + j / 2) * nx;
+		Type *out = result + n * 2 * nx;
+		for (long i = 0; i < nx; i++) out[2 * i] = out[2 * i + 1] = in[i];
 	}
-	}
-
-	this->dims(grid.dims(0),grid.dims(1),grid.dims(2), grid.dims(3));
-	this->pixdim(grid.pixdim(0)*0.5 ,grid.pixdim(1)*0.5,grid.pixdim(2)*0.5, grid.pixdim(3));
 
+	double pd[3];
+	for (int a = 0; a < 3; a++) pd[a] = ((v_pixdim[a] == 0.) ? 1. : v_pixdim[a]) * 0.5;
+	this->dims(2 * nx, 2 * ny, 2 * nz, NT);
+	this->pixdim(pd[0], pd[1], pd[2], v_pixdim[3]);
 
-	if (dims(0) > 1 and pixdim(0) == 0.) this->pixdim(1.		, pixdim(1)	,pixdim(2)	,pixdim(3) );
-	if (dims(1) > 1 and pixdim(1) == 0.) this->pixdim(pixdim(0)	, 1.		,pixdim(2)	,pixdim(3) );
-	if (dims(2) > 1 and pixdim(2) == 0.) this->pixdim(pixdim(0)	, pixdim(1)	,1.			,pixdim(3) );
-	if (dims(3) > 1 and pixdim(3) == 0.) this->pixdim(pixdim(0)	, pixdim(1)	,pixdim(2)	,1.		   );
+	delete[] this->matrix;
+	this->matrix = result;
+}
 
+/** name: mymatrix::downsample2x
+ * Halves the resolution along x, y and z (axes with only one voxel are kept,
+ * time is never reduced), e.g. for one level of an image pyramid (see
+ * mymatrix_pyramid). Coarse voxel i covers the voxels 2i and 2i+1, the values
+ * are prefiltered with the separable binomial kernel [1 3 3 1]/8, so the
+ * coarse image is smooth and free of aliasing. The pixel dimensions are
+ * doubled (a pixdim of 0 is taken as 1), the origin stays the same, so the
+ * physical coordinates of both matrices agree. An odd number of voxels is
+ * rounded up.
+ *
+ * The lines of the result are computed in parallel.
+ * \return a new matrix, delete it after use
+ */
+template <class Type>
+mymatrix<Type>* mymatrix<Type>::downsample2x(){
+	resample_axis ax[4];
+	size_t n[3];
+	double pd[3];
+	for (int a = 0; a < 3; a++){
+		n[a]  = ax[a].init_reduce(dimensions[a]);
+		pd[a] = (dimensions[a] == 1) ? v_pixdim[a] : ((v_pixdim[a] == 0.) ? 1. : v_pixdim[a]) * 2.;
+	}
+	ax[3].init(dimensions[3], 0., 1., dimensions[3], 0., 1., RESAMPLE_NEAREST);
 
+	mymatrix<Type> *result = new mymatrix<Type>(n[0], n[1], n[2], dimensions[3]);
+	result->pixdim(pd[0], pd[1], pd[2], v_pixdim[3]);
+	result->origin(v_origin[0], v_origin[1], v_origin[2], v_origin[3]);
+	resample_lines(ax, *result, 0.);
+	return result;
+}
 
+/** name: mymatrix::upsample2x
+ * Doubles the resolution along x, y and z (axes with only one voxel are
+ * kept), the inverse of downsample2x() for coarse-to-fine processing. The
+ * pixel dimensions are halved, the origin stays the same. Use
+ * RESAMPLE_NEAREST for labels and masks. To get back exactly onto the grid
+ * of a finer level (odd dimensions), use resample() with that grid.
+ * \return a new matrix, delete it after use
+ */
+template <class Type>
+mymatrix<Type>* mymatrix<Type>::upsample2x(int method){
+	my_regular_grid grid(*this);
+	double pd[3];
+	for (int a = 0; a < 3; a++)
+		pd[a] = (dimensions[a] == 1) ? v_pixdim[a] : ((v_pixdim[a] == 0.) ? 1. : v_pixdim[a]) * 0.5;
+	grid.dims(dimensions[0] == 1 ? 1 : 2 * dimensions[0],
+			  dimensions[1] == 1 ? 1 : 2 * dimensions[1],
+			  dimensions[2] == 1 ? 1 : 2 * dimensions[2], dimensions[3]);
+	grid.pixdim(pd[0], pd[1], pd[2], v_pixdim[3]);
+	return resample(grid, method, 0);
+}
 
-	delete[] this->matrix;
-	this->matrix = new Type[items_val]; // init with NULL
-	for (unsigned int i = 0; i < items(); i++)
-		this->operator[](i) = result[i];
+/** name: mymatrix::resample_to
+ * Resamples the matrix onto the grid of another matrix (dimensions, pixdim
+ * and origin of the target), e.g. to align a segmentation with a simulation
+ * grid. All four axes are interpolated independently, so 4D data is
+ * resampled in time as well.
+ *
+ * \param target  : the matrix to fill, its grid defines the sample points
+ * \param method  : RESAMPLE_NEAREST, RESAMPLE_LINEAR or RESAMPLE_CUBIC
+ * \param outside : value of samples outside of this matrix
+ */
+template <class Type> template <class Out>
+void mymatrix<Type>::resample_to(mymatrix<Out> &target, int method, double outside){
+	resample_axis ax[4];
+	for (int a = 0; a < 4; a++)
+		ax[a].init(dimensions[a], v_origin[a], v_pixdim[a],
+				   target.dims(a), target.origin(a), target.pixdim(a), method);
+	resample_lines(ax, target, outside);
+}
 
+/** name: mymatrix::resample_lines
+ * Fills the target with the taps of four axes (see resample_axis), used by
+ * resample_to() and downsample2x().
+ *
+ * The target is filled line by line in parallel. For each line the source
+ * lines involved are first combined along y, z and t into one buffer (a
+ * plain vectorised loop), then the buffer is interpolated along x.
+ */
+template <class Type> template <class Out>
+void mymatrix<Type>::resample_lines(const resample_axis *ax, mymatrix<Out> &target, double outside){
+	const resample_axis &X = ax[0], &Y = ax[1], &Z = ax[2], &T = ax[3];
+
+	const long nxo = target.dims(0), nyo = target.dims(1), nzo = target.dims(2);
+	const long lines = nyo * nzo * target.dims(3);
+	const size_t width = X.hi - X.lo;
+	const Out out_value = mymatrix_cast<Out>(outside);
+	Out *out = target.data();
+
+	#pragma omp parallel
+	{
+		vector<double> buffer(width);
+		double *line = &buffer[0];
+
+		#pragma omp for schedule(static)
+		for (long n = 0; n < lines; n++){
+			const size_t j = n % nyo, k = (n / nyo) % nzo, l = n / (nyo * nzo);
+			Out *o = out + n * nxo;
+			if (not (Y.inside[j] and Z.inside[k] and T.inside[l])){
+				fill(o, o + nxo, out_value);
+				continue;
+			}
+			// combine the source lines along y, z and t
+			fill(line, line + width, 0.);
+			for (int tl = 0; tl < T.taps; tl++)
+			for (int tk = 0; tk < Z.taps; tk++)
+			for (int tj = 0; tj < Y.taps; tj++){
+				const double w = T.weight[l * T.taps + tl] * Z.weight[k * Z.taps + tk] * Y.weight[j * Y.taps + tj];
+				if (w == 0.) continue;
+				const Type *row = matrix + ((T.index[l * T.taps + tl] * NZ
+										  + Z.index[k * Z.taps + tk]) * NY
+										  + Y.index[j * Y.taps + tj]) * NX + X.lo;
+				for (size_t i = 0; i < width; i++) line[i] += w * (double) row[i];
+			}
+			// interpolate along x
+			for (long i = 0; i < nxo; i++){
+				if (not X.inside[i]){
+					o[i] = out_value;
+					continue;
+				}
+				const size_t *idx = &X.index[i * X.taps];
+				const double *w   = &X.weight[i * X.taps];
+				double v = 0.;
+				for (int t = 0; t < X.taps; t++) v += w[t] * line[idx[t] - X.lo];
+				o[i] = mymatrix_cast<Out>(v);
+			}
+		}
+	}
+}
 
+/** name: mymatrix::resample
+ * Resamples the matrix onto another grid, see resample_to().
+ * \return a new matrix with the given grid, delete it after use
+ */
+template <class Type>
+mymatrix<Type>* mymatrix<Type>::resample(my_regular_grid &grid, int method, Type outside){
+	mymatrix<Type> *result = new mymatrix<Type>(grid);
+	resample_to(*result, method, (double) outside);
+	return result;
 }
 
 template <class Type>
@@ -1336,6 +2547,9 @@ void mymatrix<Type>::info(){
 		cout << "dt            :\t" << this->dt             << endl;
 }
 
+#include "mymatrix_expr.hpp"
+#include "mymatrix_view.hpp"
+
 #undef absolute
 #undef print
 #undef NX
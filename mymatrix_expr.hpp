@@ -0,0 +1,297 @@
+/*
+ *      mymatrix_expr.hpp
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef MYMATRIX_EXPR_H
+#define MYMATRIX_EXPR_H
+
+#include "mymatrix.hpp"
+
+/** \file mymatrix_expr.hpp
+ * Expression templates for element-wise arithmetic with mymatrix.
+ *
+ * Arithmetic (+ - * /), comparisons (< <= > >= == !=), logical operators
+ * (&& || !) and the functions clamp(), where() and convert() build an
+ * expression instead of a new matrix. Only the assignment to a mymatrix
+ * evaluates the expression, in one parallel loop over all items without any
+ * temporary matrices:
+ *
+ \verbatim
+	mymatrix<short> a(grid), b(grid);
+	mymatrix<unsigned char> out(grid);
+	out = clamp((a - b) * 0.5, 0, 255);
+	out = where(a > 100 && b > 100, a, 0);
+ \endverbatim
+ *
+ * All values are computed as double. Comparisons give 1 or 0. When the
+ * result is stored, integer types are rounded and clamped to their range
+ * (see mymatrix_cast()), so converting between types is just an assignment.
+ * Matrices within one expression must have the same number of items,
+ * otherwise a mymatrix_exception(DIMENSION_FAILURE) is thrown.
+ */
+
+/** \class mymatrix_expr
+ * Base of all expressions (CRTP), E is the actual expression type.
+ */
+template <class E>
+struct mymatrix_expr {
+	const E& self() const {return static_cast<const E&>(*this);}
+};
+
+/// size of a node, leaves without size (scalars) have size 0
+inline size_t mx_size(size_t a, size_t b){
+	if (a and b and a != b) throw mymatrix_exception(DIMENSION_FAILURE);
+	return (a > b) ? a : b;
+}
+
+/// a matrix within an expression
+template <class T>
+struct mx_ref : public mymatrix_expr< mx_ref<T> > {
+	const T *p;
+	size_t   n;
+	mx_ref(const mymatrix<T> &m) :
+		p(const_cast<mymatrix<T>&>(m).data()), n(const_cast<mymatrix<T>&>(m).items()) {}
+	double operator[](size_t i) const {return (double) p[i];}
+	size_t size() const {return n;}
+};
+
+/// a constant within an expression
+struct mx_scalar : public mymatrix_expr<mx_scalar> {
+	double v;
+	mx_scalar(double value) : v(value) {}
+	double operator[](size_t) const {return v;}
+	size_t size() const {return 0;}
+};
+
+template <class A, class Op>
+struct mx_unary : public mymatrix_expr< mx_unary<A, Op> > {
+	A a;
+	mx_unary(const A &x) : a(x) {}
+	double operator[](size_t i) const {return Op::apply(a[i]);}
+	size_t size() const {return a.size();}
+};
+
+template <class A, class B, class Op>
+struct mx_binary : public mymatrix_expr< mx_binary<A, B, Op> > {
+	A a;
+	B b;
+	size_t n;
+	mx_binary(const A &x, const B &y) : a(x), b(y), n(mx_size(x.size(), y.size())) {}
+	double operator[](size_t i) const {return Op::apply(a[i], b[i]);}
+	size_t size() const {return n;}
+};
+
+template <class C, class A, class B>
+struct mx_where : public mymatrix_expr< mx_where<C, A, B> > {
+	C c;
+	A a;
+	B b;
+	size_t n;
+	mx_where(const C &x, const A &y, const B &z) : c(x), a(y), b(z),
+		n(mx_size(x.size(), mx_size(y.size(), z.size()))) {}
+	double operator[](size_t i) const {return (c[i] != 0.) ? a[i] : b[i];}
+	size_t size() const {return n;}
+};
+
+template <class A>
+struct mx_clamp : public mymatrix_expr< mx_clamp<A> > {
+	A a;
+	double lo, hi;
+	mx_clamp(const A &x, double l, double h) : a(x), lo(l), hi(h) {}
+	double operator[](size_t i) const {
+		const double v = a[i];
+		return (v < lo) ? lo : ((v > hi) ? hi : v);
+	}
+	size_t size() const {return a.size();}
+};
+
+/// converts the values to type T within an expression (rounding, clamping)
+template <class T, class A>
+struct mx_convert : public mymatrix_expr< mx_convert<T, A> > {
+	A a;
+	mx_convert(const A &x) : a(x) {}
+	double operator[](size_t i) const {return (double) mymatrix_cast<T>(a[i]);}
+	size_t size() const {return a.size();}
+};
+
+/** \class mx_leaf
+ * Maps the operands of the operators to expression nodes. Only matrices,
+ * expressions and numbers have a node type, so the operators do not apply to
+ * any other type.
+ */
+template <class T> struct mx_leaf {};
+
+template <class T> struct mx_leaf< mymatrix<T> > {
+	typedef mx_ref<T> type;
+	static type make(const mymatrix<T> &m) {return type(m);}
+};
+
+#define MX_LEAF_EXPR(TEMPLATE_ARGS, NODE) \
+	template <TEMPLATE_ARGS> struct mx_leaf< NODE > { \
+		typedef NODE type; \
+		static const type& make(const type &e) {return e;} \
+	};
+#define MX_COMMA ,
+MX_LEAF_EXPR(class T, mx_ref<T>)
+MX_LEAF_EXPR(class A MX_COMMA class Op, mx_unary<A MX_COMMA Op>)
+MX_LEAF_EXPR(class A MX_COMMA class B MX_COMMA class Op, mx_binary<A MX_COMMA B MX_COMMA Op>)
+MX_LEAF_EXPR(class C MX_COMMA class A MX_COMMA class B, mx_where<C MX_COMMA A MX_COMMA B>)
+MX_LEAF_EXPR(class A, mx_clamp<A>)
+MX_LEAF_EXPR(class T MX_COMMA class A, mx_convert<T MX_COMMA A>)
+#undef MX_COMMA
+#undef MX_LEAF_EXPR
+
+template <> struct mx_leaf<mx_scalar> {
+	typedef mx_scalar type;
+	static const type& make(const type &e) {return e;}
+};
+
+#define MX_LEAF_SCALAR(T) \
+	template <> struct mx_leaf<T> { \
+		typedef mx_scalar type; \
+		static type make(T v) {return type((double) v);} \
+	};
+MX_LEAF_SCALAR(double)
+MX_LEAF_SCALAR(float)
+MX_LEAF_SCALAR(int)
+MX_LEAF_SCALAR(unsigned int)
+MX_LEAF_SCALAR(long)
+MX_LEAF_SCALAR(unsigned long)
+MX_LEAF_SCALAR(short)
+MX_LEAF_SCALAR(unsigned short)
+MX_LEAF_SCALAR(char)
+MX_LEAF_SCALAR(unsigned char)
+MX_LEAF_SCALAR(signed char)
+MX_LEAF_SCALAR(bool)
+MX_LEAF_SCALAR(long long)
+MX_LEAF_SCALAR(unsigned long long)
+#undef MX_LEAF_SCALAR
+
+// ----- operators -----
+#define MX_BINARY_OP(NAME, OP, EXPR) \
+	struct NAME { static double apply(double a, double b) {return EXPR;} }; \
+	template <class A, class B> \
+	inline mx_binary<typename mx_leaf<A>::type, typename mx_leaf<B>::type, NAME> \
+	OP(const A &a, const B &b){ \
+		return mx_binary<typename mx_leaf<A>::type, typename mx_leaf<B>::type, NAME> \
+			(mx_leaf<A>::make(a), mx_leaf<B>::make(b)); \
+	}
+
+MX_BINARY_OP(mx_add, operator+,  a + b)
+MX_BINARY_OP(mx_sub, operator-,  a - b)
+MX_BINARY_OP(mx_mul, operator*,  a * b)
+MX_BINARY_OP(mx_div, operator/,  a / b)
+MX_BINARY_OP(mx_lt,  operator<,  (a <  b) ? 1. : 0.)
+MX_BINARY_OP(mx_le,  operator<=, (a <= b) ? 1. : 0.)
+MX_BINARY_OP(mx_gt,  operator>,  (a >  b) ? 1. : 0.)
+MX_BINARY_OP(mx_ge,  operator>=, (a >= b) ? 1. : 0.)
+MX_BINARY_OP(mx_eq,  operator==, (a == b) ? 1. : 0.)
+MX_BINARY_OP(mx_ne,  operator!=, (a != b) ? 1. : 0.)
+MX_BINARY_OP(mx_and, operator&&, (a != 0. and b != 0.) ? 1. : 0.)
+MX_BINARY_OP(mx_or,  operator||, (a != 0. or  b != 0.) ? 1. : 0.)
+#undef MX_BINARY_OP
+
+struct mx_neg { static double apply(double a) {return -a;} };
+struct mx_not { static double apply(double a) {return (a == 0.) ? 1. : 0.;} };
+
+template <class A>
+inline mx_unary<typename mx_leaf<A>::type, mx_neg> operator-(const A &a){
+	return mx_unary<typename mx_leaf<A>::type, mx_neg>(mx_leaf<A>::make(a));
+}
+
+template <class A>
+inline mx_unary<typename mx_leaf<A>::type, mx_not> operator!(const A &a){
+	return mx_unary<typename mx_leaf<A>::type, mx_not>(mx_leaf<A>::make(a));
+}
+
+/** \class mx_is_expr
+ * value is false for numbers, true for matrices and expressions. The
+ * functions below are only defined if at least one operand is a matrix or an
+ * expression, so they do not compete with std::clamp() etc. for numbers.
+ */
+template <class L> struct mx_is_expr { static const bool value = true; };
+template <> struct mx_is_expr<mx_scalar> { static const bool value = false; };
+
+template <bool B, class R> struct mx_enable_if {};
+template <class R> struct mx_enable_if<true, R> { typedef R type; };
+
+/// limits the values of an expression to [lo, hi]
+template <class A>
+inline typename mx_enable_if<mx_is_expr<typename mx_leaf<A>::type>::value,
+							 mx_clamp<typename mx_leaf<A>::type> >::type
+clamp(const A &a, double lo, double hi){
+	return mx_clamp<typename mx_leaf<A>::type>(mx_leaf<A>::make(a), lo, hi);
+}
+
+/// element-wise selection: a where c is not 0, b otherwise
+template <class C, class A, class B>
+inline typename mx_enable_if<mx_is_expr<typename mx_leaf<C>::type>::value or
+							 mx_is_expr<typename mx_leaf<A>::type>::value or
+							 mx_is_expr<typename mx_leaf<B>::type>::value,
+		mx_where<typename mx_leaf<C>::type, typename mx_leaf<A>::type, typename mx_leaf<B>::type> >::type
+where(const C &c, const A &a, const B &b){
+	return mx_where<typename mx_leaf<C>::type, typename mx_leaf<A>::type, typename mx_leaf<B>::type>
+		(mx_leaf<C>::make(c), mx_leaf<A>::make(a), mx_leaf<B>::make(b));
+}
+
+/// converts the values to type T (rounded and clamped like an assignment)
+template <class T, class A>
+inline typename mx_enable_if<mx_is_expr<typename mx_leaf<A>::type>::value,
+							 mx_convert<T, typename mx_leaf<A>::type> >::type
+convert(const A &a){
+	return mx_convert<T, typename mx_leaf<A>::type>(mx_leaf<A>::make(a));
+}
+
+/** name: mymatrix::operator=
+ * Evaluates an expression into the matrix in one parallel loop. The matrix
+ * may be part of the expression itself.
+ */
+template <class Type> template <class E>
+mymatrix<Type>& mymatrix<Type>::operator=(const mymatrix_expr<E> &expr){
+	const E &e = expr.self();
+	if (e.size() != 0 and e.size() != items_val) throw mymatrix_exception(DIMENSION_FAILURE);
+	#pragma omp parallel for
+	for (long i = 0; i < (long) items_val; i++) matrix[i] = mymatrix_cast<Type>(e[i]);
+	return *this;
+}
+
+/** name: mymatrix::operator+=
+ * Adds an expression, a matrix or a number to all items.
+ */
+template <class Type> template <class E>
+mymatrix<Type>& mymatrix<Type>::operator+=(const E &e){
+	return this->operator=(*this + e);
+}
+
+/** name: mymatrix::operator-=
+ * Subtracts an expression, a matrix or a number from all items.
+ */
+template <class Type> template <class E>
+mymatrix<Type>& mymatrix<Type>::operator-=(const E &e){
+	return this->operator=(*this - e);
+}
+
+/** name: mymatrix::operator*=
+ * Multiplies all items by an expression, a matrix or a number.
+ */
+template <class Type> template <class E>
+mymatrix<Type>& mymatrix<Type>::operator*=(const E &e){
+	return this->operator=(*this * e);
+}
+
+#endif
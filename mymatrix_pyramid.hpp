@@ -0,0 +1,115 @@
+/*
+ *      mymatrix_pyramid.hpp
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+
+#ifndef MYMATRIX_PYRAMID_H
+#define MYMATRIX_PYRAMID_H
+
+#include <vector>
+#include "mymatrix.hpp"
+
+using namespace std;
+
+/** \class mymatrix_pyramid
+ * Multi-resolution pyramid of a matrix for coarse-to-fine processing.
+ *
+ * Level 0 is the matrix itself (not copied, it must live as long as the
+ * pyramid), every further level halves the resolution with
+ * mymatrix::downsample2x(), until the largest axis has at most min_size
+ * voxels. All levels share the physical coordinates of level 0, so results
+ * on a coarse level can be brought onto a finer grid with upsample():
+ *
+ \verbatim
+	mymatrix<short> vol(512, 512, 512);
+	...
+	mymatrix_pyramid<short> pyramid(vol);			// 512, 256, 128, 64, 32
+	mymatrix<short> &coarse = pyramid.level(pyramid.level_for(64));
+	size_t nr_labels;
+	mymatrix<int> *labels = coarse.label_components(nr_labels);
+	mymatrix<int> *fine = pyramid.upsample(*labels, 0, RESAMPLE_NEAREST);
+ \endverbatim
+ **/
+template <class Type>
+class mymatrix_pyramid {
+
+	private:
+		vector<mymatrix<Type>*> v_levels;	//!< v_levels[0] is not owned
+
+		mymatrix_pyramid(const mymatrix_pyramid &);				// not copyable
+		mymatrix_pyramid& operator=(const mymatrix_pyramid &);
+
+		static size_t largest(mymatrix<Type> &m){
+			return max(max(m.dims(0), m.dims(1)), m.dims(2));
+		}
+
+	public:
+		mymatrix_pyramid(mymatrix<Type> &finest, size_t min_size=32, size_t max_levels=0);
+		~mymatrix_pyramid(){
+			for (size_t i = 1; i < v_levels.size(); i++) delete v_levels[i];
+		}
+
+		size_t levels() const {return v_levels.size();}				//!< number of levels including level 0
+		mymatrix<Type>& level(size_t i){return *v_levels.at(i);}	//!< level i, 0 is the finest
+		mymatrix<Type>& coarsest(){return *v_levels.back();}		//!< the last level
+
+		size_t level_for(size_t max_size);
+		template <class Out>
+		mymatrix<Out>* upsample(mymatrix<Out> &coarse, size_t to_level, int method=RESAMPLE_LINEAR);
+};
+
+/** name: mymatrix_pyramid::mymatrix_pyramid
+ * Builds the levels, each one from the previous level.
+ * \param finest     : level 0
+ * \param min_size   : no further level is built, once the largest axis has
+ *                     at most min_size voxels
+ * \param max_levels : maximal number of levels including level 0 (0: no limit)
+ */
+template <class Type>
+mymatrix_pyramid<Type>::mymatrix_pyramid(mymatrix<Type> &finest, size_t min_size, size_t max_levels){
+	if (min_size < 1) min_size = 1;
+	v_levels.push_back(&finest);
+	while ((max_levels == 0 or v_levels.size() < max_levels) and largest(*v_levels.back()) > min_size)
+		v_levels.push_back(v_levels.back()->downsample2x());
+}
+
+/** name: mymatrix_pyramid::level_for
+ * \return the finest level whose largest axis has at most max_size voxels,
+ *         the coarsest level if there is none
+ */
+template <class Type>
+size_t mymatrix_pyramid<Type>::level_for(size_t max_size){
+	for (size_t i = 0; i < v_levels.size(); i++)
+		if (largest(*v_levels[i]) <= max_size) return i;
+	return v_levels.size() - 1;
+}
+
+/** name: mymatrix_pyramid::upsample
+ * Brings a result computed on a coarser level (same grid as that level, any
+ * type) onto the grid of a finer level, e.g. as the start of the next
+ * refinement step. Use RESAMPLE_NEAREST for labels and masks.
+ * \param coarse   : matrix on the grid of a coarser level
+ * \param to_level : the target level
+ * \return a new matrix with the grid of level to_level, delete it after use
+ */
+template <class Type> template <class Out>
+mymatrix<Out>* mymatrix_pyramid<Type>::upsample(mymatrix<Out> &coarse, size_t to_level, int method){
+	return coarse.resample(level(to_level), method, 0);
+}
+
+#endif
@@ -0,0 +1,942 @@
+/*
+ *      mymatrix_view.hpp
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef MYMATRIX_VIEW_H
+#define MYMATRIX_VIEW_H
+
+#include "mymatrix.hpp"
+
+/** \class mymatrix_view
+ * A strided window into the data of a mymatrix, nothing is copied.
+ *
+ * A view has its own extent (dims()) and pixdim()/origin(), which are those
+ * of the part of the matrix it shows, and a stride per axis. Views are made
+ * by mymatrix::view(), crop(), slice(), frame() and subsample() and can be
+ * narrowed further in the same way. Filters, statistics, gradients and
+ * saving work on views exactly as on matrices, and cost in proportion to the
+ * size of the view:
+ \verbatim
+	mymatrix<short> vol(grid);						// 4D data
+	mymatrix_view<short> roi = vol.crop(100, 80, 20, 0, 200, 200, 40, vol.dims(3));
+	roi.smooth_gaussian(1.5);						// only the ROI changes
+	mymatrix_statistics s = roi.frame(3).statistics();
+	vol.slice(50).subsample(2, 2).save_to_file("thumb.raw");
+ \endverbatim
+ *
+ * The view must not outlive the matrix, and changes of the matrix size
+ * (append(), extend(), resolution2x(), ...) invalidate it.
+ **/
+template <class Type>
+class mymatrix_view: public my_regular_grid{
+
+	private:
+		Type *base;			//!< first pixel
+		long  step[4];		//!< distance of neighbouring pixels along x, y, z and t
+
+		mymatrix_view<Type> sub(const size_t first[4], const size_t count[4], const size_t every[4]);
+		long bundles(int axis, long width);
+		Type* bundle(int axis, long task, long width, long &w);
+		void filter_lines(int axis, int kind, double param);
+		void minmax_lines(int axis, int r, bool maximum);
+		void bilateral_lines(int axis, double sigma_s, double sigma_r);
+		void compute_statistics(mymatrix_statistics &stats, mymatrix_view<char> *mask);
+
+	public:
+		mymatrix_view(Type *data, const size_t count[4], const long stride[4],
+					  const double pixdim[4], const double origin[4]);
+
+		Type* data() {return base;}												//!< the first pixel
+		long stride(int axis) const {return step[axis];}						//!< distance of neighbours along an axis
+		size_t extent(int axis) const {return dimensions[axis];}				//!< like dims(), but const
+		bool contiguous() const;
+
+		/// offset of pixel (i,j,k,l) from data()
+		size_t index(size_t i, size_t j=0, size_t k=0, size_t l=0) const {
+			return i * step[0] + j * step[1] + k * step[2] + l * step[3];
+		}
+		Type& operator()(size_t i, size_t j=0, size_t k=0, size_t l=0) {return base[index(i, j, k, l)];}
+		Type& at(size_t i, size_t j=0, size_t k=0, size_t l=0) {return base[index(i, j, k, l)];}
+		Type* row(size_t j, size_t k=0, size_t l=0) {return base + index(0, j, k, l);}	//!< first pixel of a row along x
+
+		mymatrix_view<Type> crop(size_t x0, size_t y0, size_t z0, size_t t0,
+								 size_t nx, size_t ny, size_t nz, size_t nt);
+		mymatrix_view<Type> slice(size_t z, size_t t=0);
+		mymatrix_view<Type> frame(size_t t);
+		mymatrix_view<Type> subsample(size_t sx, size_t sy=1, size_t sz=1, size_t st=1);
+
+		void copy_to(Type *dense) const;
+		void assign(const Type *dense);
+		void fill(Type value);
+
+		mymatrix_statistics statistics(mymatrix_view<char> *mask=0);
+		mymatrix_statistics statistics(size_t bins, double lo, double hi, mymatrix_view<char> *mask=0);
+		mymatrix_statistics histogram(mymatrix_view<char> *mask=0);
+
+		void smooth_box(int px, int axis=-1);
+		void smooth_gaussian(double sigma, int axis=-1);
+		void bilateral(double sigma_s, double sigma_r, int axis=-1);
+		void erode(int px, int axis=-1);
+		void dilate(int px, int axis=-1);
+		void opening(int px, int axis=-1);
+		void closing(int px, int axis=-1);
+
+		template <class Out>
+		void gradients(unsigned int axes, Out *magnitude, Out *gx=0, Out *gy=0, Out *gz=0, Out *gt=0, bool use_pixdim=false);
+		void gradient_magnitude(unsigned int axes=7, bool use_pixdim=false);
+
+		bool save_to_file(FILE* ou);
+		bool save_to_file(string fn);
+};
+
+/** name: mymatrix_view::mymatrix_view
+ * \param data   : the first pixel
+ * \param count  : pixels along x, y, z and t
+ * \param stride : distance of neighbouring pixels along x, y, z and t
+ * \param pixdim, origin : geometry of the view
+ */
+template <class Type>
+mymatrix_view<Type>::mymatrix_view(Type *data, const size_t count[4], const long stride[4],
+								   const double pixdim[4], const double origin[4]) :
+  my_regular_grid(count[0], count[1], count[2], count[3]), base(data) {
+	for (int a = 0; a < 4; a++){
+		step[a]     = stride[a];
+		v_pixdim[a] = pixdim[a];
+		v_origin[a] = origin[a];
+	}
+	pixdim_set = true;
+}
+
+/** name: mymatrix_view::contiguous
+ * True, if the pixels of the view follow each other in memory without gaps.
+ */
+template <class Type>
+bool mymatrix_view<Type>::contiguous() const {
+	long expect = 1;
+	for (int a = 0; a < 4; a++){
+		if (dimensions[a] > 1 and step[a] != expect) return false;
+		expect *= dimensions[a];
+	}
+	return true;
+}
+
+/** sub
+ * A part of this view: count[a] pixels from first[a] on, every every[a]-th.
+ */
+template <class Type>
+mymatrix_view<Type> mymatrix_view<Type>::sub(const size_t first[4], const size_t count[4], const size_t every[4]){
+	long   stride[4];
+	double pd[4], org[4];
+	for (int a = 0; a < 4; a++){
+		if (every[a] == 0 or count[a] == 0 or first[a] + (count[a] - 1) * every[a] >= dimensions[a])
+			throw mymatrix_exception(INDEX_OUT_OF_RANGE_FAILURE);
+		stride[a] = step[a] * (long) every[a];
+		pd[a]     = v_pixdim[a] * every[a];
+		org[a]    = v_origin[a] + first[a] * v_pixdim[a];
+	}
+	return mymatrix_view<Type>(base + index(first[0], first[1], first[2], first[3]), count, stride, pd, org);
+}
+
+/** name: mymatrix_view::crop
+ * A box of nx*ny*nz*nt pixels starting at (x0,y0,z0,t0).
+ */
+template <class Type>
+mymatrix_view<Type> mymatrix_view<Type>::crop(size_t x0, size_t y0, size_t z0, size_t t0,
+											  size_t nx, size_t ny, size_t nz, size_t nt){
+	const size_t first[4] = {x0, y0, z0, t0}, count[4] = {nx, ny, nz, nt}, every[4] = {1, 1, 1, 1};
+	return sub(first, count, every);
+}
+
+/** name: mymatrix_view::slice
+ * The xy-plane at z in frame t.
+ */
+template <class Type>
+mymatrix_view<Type> mymatrix_view<Type>::slice(size_t z, size_t t){
+	return crop(0, 0, z, t, dimensions[0], dimensions[1], 1, 1);
+}
+
+/** name: mymatrix_view::frame
+ * The volume of time step t.
+ */
+template <class Type>
+mymatrix_view<Type> mymatrix_view<Type>::frame(size_t t){
+	return crop(0, 0, 0, t, dimensions[0], dimensions[1], dimensions[2], 1);
+}
+
+/** name: mymatrix_view::subsample
+ * Every sx-th pixel along x, every sy-th along y etc., pixdim() grows
+ * accordingly.
+ */
+template <class Type>
+mymatrix_view<Type> mymatrix_view<Type>::subsample(size_t sx, size_t sy, size_t sz, size_t st){
+	const size_t first[4] = {0, 0, 0, 0}, every[4] = {sx, sy, sz, st};
+	size_t count[4];
+	for (int a = 0; a < 4; a++) count[a] = (every[a] == 0) ? 0 : (dimensions[a] + every[a] - 1) / every[a];
+	return sub(first, count, every);
+}
+
+/** name: mymatrix_view::copy_to
+ * Copies the pixels into a dense array (x fastest).
+ */
+template <class Type>
+void mymatrix_view<Type>::copy_to(Type *dense) const {
+	const long nx = dimensions[0], rows = dimensions[1] * dimensions[2] * dimensions[3];
+	#pragma omp parallel for
+	for (long r = 0; r < rows; r++){
+		const Type *in = base + index(0, r % dimensions[1], (r / dimensions[1]) % dimensions[2], r / (dimensions[1] * dimensions[2]));
+		Type *out = dense + r * nx;
+		for (long i = 0; i < nx; i++) out[i] = in[i * step[0]];
+	}
+}
+
+/** name: mymatrix_view::assign
+ * Copies the pixels from a dense array (x fastest) into the view.
+ */
+template <class Type>
+void mymatrix_view<Type>::assign(const Type *dense){
+	const long nx = dimensions[0], rows = dimensions[1] * dimensions[2] * dimensions[3];
+	#pragma omp parallel for
+	for (long r = 0; r < rows; r++){
+		Type *out = row(r % dimensions[1], (r / dimensions[1]) % dimensions[2], r / (dimensions[1] * dimensions[2]));
+		const Type *in = dense + r * nx;
+		for (long i = 0; i < nx; i++) out[i * step[0]] = in[i];
+	}
+}
+
+/** name: mymatrix_view::fill
+ * Sets all pixels of the view to a value.
+ */
+template <class Type>
+void mymatrix_view<Type>::fill(Type value){
+	const long nx = dimensions[0], rows = dimensions[1] * dimensions[2] * dimensions[3];
+	#pragma omp parallel for
+	for (long r = 0; r < rows; r++){
+		Type *out = row(r % dimensions[1], (r / dimensions[1]) % dimensions[2], r / (dimensions[1] * dimensions[2]));
+		for (long i = 0; i < nx; i++) out[i * step[0]] = value;
+	}
+}
+
+/** bundles
+ * Number of line bundles for a filter along an axis. For axis > 0 up to
+ * width neighbouring lines (along x) are filtered together, so the inner
+ * loops run over x.
+ */
+template <class Type>
+long mymatrix_view<Type>::bundles(int axis, long width){
+	const long across = (axis == 0) ? 1 : (long) dimensions[0];
+	const long per    = (across + width - 1) / width;
+	return (long) (items_val / (dimensions[axis] * across)) * per;
+}
+
+/** bundle
+ * First pixel of bundle task, w returns the number of lines in the bundle.
+ * Pixel k of line j is at [k * stride(axis) + j * stride(0)].
+ */
+template <class Type>
+Type* mymatrix_view<Type>::bundle(int axis, long task, long width, long &w){
+	const long across = (axis == 0) ? 1 : (long) dimensions[0];
+	const long per    = (across + width - 1) / width;
+	long o = task / per;
+	const long c = task % per;
+	w = min(width, across - c * width);
+
+	long offset = c * width * step[0];
+	for (int a = (axis == 0) ? 1 : 0; a < 4; a++){
+		if (a == axis or (axis > 0 and a == 0)) continue;
+		offset += (o % (long) dimensions[a]) * step[a];
+		o /= (long) dimensions[a];
+	}
+	return base + offset;
+}
+
+/** filter_lines
+ *
+ * Applies a one dimensional filter to all lines of the view along an axis.
+ * Neighbouring lines are filtered together, so for axis > 0 the innermost
+ * loop runs over x and is vectorised by the compiler. Bundles of lines are
+ * distributed over the threads. The cost per pixel does not depend on the
+ * size of the kernel.
+ *
+ * \param axis  : 0..3 for x, y, z and t
+ * \param kind  : 0 box filter, 1 recursive Gaussian
+ * \param param : half window size of the box or sigma of the Gaussian (pixel)
+ */
+template <class Type>
+void mymatrix_view<Type>::filter_lines(int axis, int kind, double param){
+	if (axis < 0 or axis > 3 or items_val == 0) return;
+	const long n = dimensions[axis];
+	if (n < 2) return;
+
+	const long width = 256;					// lines per bundle
+	const long tasks = bundles(axis, width);
+	const long s0 = step[0], sa = step[axis];
+	const long r  = (long) param;
+
+	// coefficients of the recursive Gaussian (Young and van Vliet, 1995)
+	const double sigma = max(param, 0.5);
+	const double q  = (sigma >= 2.5) ? 0.98711 * sigma - 0.96330
+									 : 3.97156 - 4.14554 * sqrt(1. - 0.26891 * sigma);
+	const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q*q + 0.422205 * q*q*q;
+	const double b1 = (2.44413 * q + 2.85619 * q*q + 1.26661 * q*q*q) / b0;
+	const double b2 = -(1.4281 * q*q + 1.26661 * q*q*q) / b0;
+	const double b3 = (0.422205 * q*q*q) / b0;
+	const double B  = 1. - (b1 + b2 + b3);
+	long task = 0;
+	#pragma omp parallel for private(task) schedule(dynamic)
+	for (task = 0; task < tasks; task++){
+		long w;
+		Type *first = bundle(axis, task, width, w);
+
+		vector<double> in(n * w), out(n * w);
+		for (long k = 0; k < n; k++)
+			for (long j = 0; j < w; j++) in[k * w + j] = (double) first[k * sa + j * s0];
+
+		if (kind == 0){ // running sum, the window is clipped at the borders
+			vector<double> acc(w, 0.);
+			for (long k = 0; k <= min(r, n - 1); k++)
+				for (long j = 0; j < w; j++) acc[j] += in[k * w + j];
+			for (long k = 0; k < n; k++){
+				const double inv = 1. / (double) (min(k + r, n - 1) - max(k - r, 0L) + 1);
+				double *o_k = &out[k * w];
+				for (long j = 0; j < w; j++) o_k[j] = acc[j] * inv;
+				if (k + r + 1 < n){
+					const double *add = &in[(k + r + 1) * w];
+					for (long j = 0; j < w; j++) acc[j] += add[j];
+				}
+				if (k - r >= 0){
+					const double *sub = &in[(k - r) * w];
+					for (long j = 0; j < w; j++) acc[j] -= sub[j];
+				}
+			}
+		}
+		else { // causal and anti-causal pass, constant continuation at the borders
+			for (long k = 0; k < n; k++){
+				const double *x  = &in[k * w];
+				const double *w1 = &out[max(k - 1, 0L) * w];
+				const double *w2 = &out[max(k - 2, 0L) * w];
+				const double *w3 = &out[max(k - 3, 0L) * w];
+				double *y        = &out[k * w];
+				if (k < 3)
+					for (long j = 0; j < w; j++){
+						const double c = in[j]; // value before the first pixel
+						y[j] = B * x[j] + b1 * ((k >= 1) ? w1[j] : c) + b2 * ((k >= 2) ? w2[j] : c) + b3 * c;
+					}
+				else
+					for (long j = 0; j < w; j++) y[j] = B * x[j] + b1 * w1[j] + b2 * w2[j] + b3 * w3[j];
+			}
+			for (long k = n - 1; k >= 0; k--){
+				const double *y1 = &in[min(k + 1, n - 1) * w];
+				const double *y2 = &in[min(k + 2, n - 1) * w];
+				const double *y3 = &in[min(k + 3, n - 1) * w];
+				const double *x  = &out[k * w];
+				double *y        = &in[k * w];	// the input is not needed anymore
+				if (k > n - 4)
+					for (long j = 0; j < w; j++){
+						const double c = out[(n - 1) * w + j]; // value after the last pixel
+						y[j] = B * x[j] + b1 * ((k <= n - 2) ? y1[j] : c) + b2 * ((k <= n - 3) ? y2[j] : c) + b3 * c;
+					}
+				else
+					for (long j = 0; j < w; j++) y[j] = B * x[j] + b1 * y1[j] + b2 * y2[j] + b3 * y3[j];
+			}
+			in.swap(out);
+		}
+
+		for (long k = 0; k < n; k++)
+			for (long j = 0; j < w; j++) first[k * sa + j * s0] = mymatrix_cast<Type>(out[k * w + j]);
+	}
+}
+
+/** minmax_lines
+ *
+ * Running minimum or maximum over a window of 2*r+1 pixels along all lines
+ * of an axis (van Herk / Gil and Werman). The padded line is divided into
+ * blocks of the window size; with the running extrema from the start (g) and
+ * from the end (h) of each block, the extremum of any window is op(h, g) of
+ * its first and last pixel. So three comparisons per pixel are needed,
+ * independent of r. The window is clipped at the borders. Lines are bundled
+ * as in filter_lines().
+ *
+ * \param axis    : 0..3 for x, y, z and t
+ * \param r       : half window size (pixel)
+ * \param maximum : maximum (dilation) instead of minimum (erosion)
+ */
+template <class Type>
+void mymatrix_view<Type>::minmax_lines(int axis, int r, bool maximum){
+	if (axis < 0 or axis > 3 or items_val == 0 or r <= 0) return;
+	const long n = dimensions[axis];
+	if (n < 2) return;
+
+	const long width = 256;								// lines per bundle
+	const long tasks = bundles(axis, width);
+	const long s0 = step[0], sa = step[axis];
+	const long s     = 2 * r + 1;						// block size = window size
+	const long m     = ((n + 2 * r + s - 1) / s) * s;	// padded length
+	const Type identity = maximum ? numeric_limits<Type>::lowest() : numeric_limits<Type>::max();
+
+	long task = 0;
+	#pragma omp parallel for private(task) schedule(dynamic)
+	for (task = 0; task < tasks; task++){
+		long w;
+		Type *first = bundle(axis, task, width, w);
+
+		Type *g = new Type[m * w], *h = new Type[m * w];	// no vector<bool>
+		std::fill(g, g + m * w, identity);
+		std::fill(h, h + m * w, identity);
+		for (long k = 0; k < n; k++)
+			for (long j = 0; j < w; j++) g[(k + r) * w + j] = h[(k + r) * w + j] = first[k * sa + j * s0];
+
+		for (long b = 0; b < m; b += s){
+			for (long k = b + 1; k < b + s; k++){		// prefix within the block
+				Type *gk = &g[k * w];
+				const Type *gp = &g[(k - 1) * w];
+				if (maximum) for (long j = 0; j < w; j++) gk[j] = max(gk[j], gp[j]);
+				else         for (long j = 0; j < w; j++) gk[j] = min(gk[j], gp[j]);
+			}
+			for (long k = b + s - 2; k >= b; k--){		// suffix within the block
+				Type *hk = &h[k * w];
+				const Type *hn = &h[(k + 1) * w];
+				if (maximum) for (long j = 0; j < w; j++) hk[j] = max(hk[j], hn[j]);
+				else         for (long j = 0; j < w; j++) hk[j] = min(hk[j], hn[j]);
+			}
+		}
+		// the window of pixel k is [k, k+2r] in padded coordinates
+		for (long k = 0; k < n; k++){
+			const Type *hk = &h[k * w], *gk = &g[(k + 2 * r) * w];
+			Type *out = first + k * sa;
+			if (maximum) for (long j = 0; j < w; j++) out[j * s0] = max(hk[j], gk[j]);
+			else         for (long j = 0; j < w; j++) out[j * s0] = min(hk[j], gk[j]);
+		}
+		delete[] g;
+		delete[] h;
+	}
+}
+
+/** bilateral_lines
+ *
+ * One dimensional bilateral filter along all lines of an axis: each pixel
+ * becomes the mean of the pixels within 3*sigma_s, weighted with the spatial
+ * Gaussian and with a Gaussian of the difference of the values (sigma_r).
+ * The window is clipped at the borders. The range weights are taken from a
+ * table, lines are bundled as in filter_lines().
+ */
+template <class Type>
+void mymatrix_view<Type>::bilateral_lines(int axis, double sigma_s, double sigma_r){
+	if (axis < 0 or axis > 3 or items_val == 0) return;
+	const long n = dimensions[axis];
+	if (n < 2) return;
+
+	const long width = 256;
+	const long tasks = bundles(axis, width);
+	const long s0 = step[0], sa = step[axis];
+	const long r  = max((long) ceil(3. * sigma_s), 1L);
+
+	vector<double> spatial(2 * r + 1);
+	for (long d = -r; d <= r; d++) spatial[d + r] = exp(-0.5 * d * d / (sigma_s * sigma_s));
+	const int    table_size = 4096;						// range weights up to 4 sigma_r
+	const double to_table   = table_size / (4. * sigma_r);
+	vector<double> range(table_size + 1);
+	for (int i = 0; i <= table_size; i++){
+		const double x = i / to_table / sigma_r;
+		range[i] = (i == table_size) ? 0. : exp(-0.5 * x * x);
+	}
+
+	long task = 0;
+	#pragma omp parallel for private(task) schedule(dynamic)
+	for (task = 0; task < tasks; task++){
+		long w;
+		Type *first = bundle(axis, task, width, w);
+
+		vector<double> in(n * w), sum(w), norm(w);
+		for (long k = 0; k < n; k++)
+			for (long j = 0; j < w; j++) in[k * w + j] = (double) first[k * sa + j * s0];
+
+		for (long k = 0; k < n; k++){
+			const double *centre = &in[k * w];
+			std::fill(sum.begin(), sum.end(), 0.);
+			std::fill(norm.begin(), norm.end(), 0.);
+			for (long d = max(-r, -k); d <= min(r, n - 1 - k); d++){
+				const double *v = &in[(k + d) * w];
+				const double  s = spatial[d + r];
+				for (long j = 0; j < w; j++){
+					const double t  = fabs(v[j] - centre[j]) * to_table;
+					const double wr = s * range[(t < table_size) ? (int) t : table_size];
+					sum[j]  += wr * v[j];
+					norm[j] += wr;
+				}
+			}
+			// the centre has weight 1, so norm > 0
+			for (long j = 0; j < w; j++) first[k * sa + j * s0] = mymatrix_cast<Type>(sum[j] / norm[j]);
+		}
+	}
+}
+
+/** name: mymatrix_view::smooth_box
+ * Box filter along one axis or x, y and z, see mymatrix::smooth_box().
+ */
+template <class Type>
+void mymatrix_view<Type>::smooth_box(int px, int axis){
+	if (px <= 0) return;
+	if (axis >= 0) filter_lines(axis, 0, px);
+	else for (int a = 0; a < 3; a++) filter_lines(a, 0, px);
+}
+
+/** name: mymatrix_view::smooth_gaussian
+ * Recursive Gaussian along one axis or x, y and z, see
+ * mymatrix::smooth_gaussian().
+ */
+template <class Type>
+void mymatrix_view<Type>::smooth_gaussian(double sigma, int axis){
+	if (sigma < 0.5) return;
+	if (axis >= 0) filter_lines(axis, 1, sigma);
+	else for (int a = 0; a < 3; a++) filter_lines(a, 1, sigma);
+}
+
+/** name: mymatrix_view::bilateral
+ * Separable bilateral filter along one axis or x, y and z, see
+ * mymatrix::bilateral().
+ */
+template <class Type>
+void mymatrix_view<Type>::bilateral(double sigma_s, double sigma_r, int axis){
+	if (sigma_s <= 0. or sigma_r <= 0.) return;
+	if (axis >= 0) bilateral_lines(axis, sigma_s, sigma_r);
+	else for (int a = 0; a < 3; a++) bilateral_lines(a, sigma_s, sigma_r);
+}
+
+/** name: mymatrix_view::erode
+ * Erosion with a box, see mymatrix::erode().
+ */
+template <class Type>
+void mymatrix_view<Type>::erode(int px, int axis){
+	if (axis >= 0) minmax_lines(axis, px, false);
+	else for (int a = 0; a < 3; a++) minmax_lines(a, px, false);
+}
+
+/** name: mymatrix_view::dilate
+ * Dilation with a box, see mymatrix::dilate().
+ */
+template <class Type>
+void mymatrix_view<Type>::dilate(int px, int axis){
+	if (axis >= 0) minmax_lines(axis, px, true);
+	else for (int a = 0; a < 3; a++) minmax_lines(a, px, true);
+}
+
+/** name: mymatrix_view::opening
+ * Erosion followed by dilation with a box.
+ */
+template <class Type>
+void mymatrix_view<Type>::opening(int px, int axis){
+	erode(px, axis);
+	dilate(px, axis);
+}
+
+/** name: mymatrix_view::closing
+ * Dilation followed by erosion with a box.
+ */
+template <class Type>
+void mymatrix_view<Type>::closing(int px, int axis){
+	dilate(px, axis);
+	erode(px, axis);
+}
+
+/** compute_statistics
+ *
+ * The statistics kernel: count, minimum, maximum, sum, mean, variance and
+ * the histogram (if stats.histogram has bins) in one parallel pass.
+ *
+ * The view is processed in chunks of up to 4096 pixels of a row (a
+ * contiguous view is one long row). Sum and squared deviations of a chunk
+ * are computed while the chunk is in the cache, the chunks are combined
+ * with the pairwise formula of Chan et al., the total sum with Kahan
+ * summation. The partial results of the threads are merged in a fixed
+ * order, so the result does not depend on the scheduling.
+ *
+ * \param stats : histogram, lo and width define the bins, the rest is set
+ * \param mask  : only pixels where mask is not 0 are counted (optional)
+ */
+template <class Type>
+void mymatrix_view<Type>::compute_statistics(mymatrix_statistics &stats, mymatrix_view<char> *mask){
+	if (mask)
+		for (int a = 0; a < 4; a++)
+			if (mask->extent(a) != dimensions[a]) throw mymatrix_exception(DIMENSION_FAILURE);
+
+	// rows of pixels, a contiguous view (and mask) is one row
+	const bool one_row = contiguous() and (mask == 0 or mask->contiguous());
+	const long row_len = one_row ? (long) items_val : (long) dimensions[0];
+	const long rows    = one_row ? 1 : (long) (items_val / dimensions[0]);
+	const long chunk   = 4096;
+	const long per_row = (row_len + chunk - 1) / chunk;
+	const long nr_chunks = rows * per_row;
+	const size_t bins = stats.histogram.size();
+	const double lo = stats.lo, inv_width = 1. / stats.width;
+
+	struct partial {
+		size_t n, outside;
+		double mean, m2, sum, carry;
+		Type   lo, hi;
+	};
+	vector<partial> parts;
+	vector< vector<size_t> > hists;
+
+	#pragma omp parallel
+	{
+		#ifdef _OPENMP
+			const int thread = omp_get_thread_num(), threads = omp_get_num_threads();
+		#else
+			const int thread = 0, threads = 1;
+		#endif
+		#pragma omp single
+		{
+			parts.resize(threads);
+			hists.resize(threads);
+		}
+		partial p = {0, 0, 0., 0., 0., 0., numeric_limits<Type>::max(), numeric_limits<Type>::lowest()};
+		vector<size_t> &hist = hists[thread];
+		hist.assign(bins, 0);
+		Type *values = new Type[chunk];
+
+		#pragma omp for schedule(static)
+		for (long c = 0; c < nr_chunks; c++){
+			const long r = c / per_row, i0 = (c % per_row) * chunk;
+			long n = min(chunk, row_len - i0);
+			const size_t j = r % dimensions[1], k = (r / dimensions[1]) % dimensions[2], l = r / (dimensions[1] * dimensions[2]);
+			const Type *v  = base + (one_row ? i0 : (long) index(i0, j, k, l));
+			const long  sv = one_row ? 1 : step[0];
+			if (mask or sv != 1){	// gather the selected values
+				const char *mc = mask ? mask->data() + (one_row ? i0 : (long) mask->index(i0, j, k, l)) : 0;
+				const long  sm = mask ? (one_row ? 1 : mask->stride(0)) : 0;
+				long sel = 0;
+				for (long i = 0; i < n; i++) if (not mc or mc[i * sm]) values[sel++] = v[i * sv];
+				v = values;
+				n = sel;
+			}
+			if (n == 0) continue;
+
+			double s = 0.;
+			Type cmin = v[0], cmax = v[0];
+			for (long i = 0; i < n; i++){
+				s += (double) v[i];
+				cmin = (v[i] < cmin) ? v[i] : cmin;
+				cmax = (v[i] > cmax) ? v[i] : cmax;
+			}
+			const double cmean = s / n;
+			double m2 = 0.;
+			for (long i = 0; i < n; i++) m2 += ((double) v[i] - cmean) * ((double) v[i] - cmean);
+			for (long i = 0; bins and i < n; i++){
+				const double b = floor(((double) v[i] - lo) * inv_width);
+				if (b >= 0. and b < (double) bins) hist[(size_t) b]++;
+				else p.outside++;
+			}
+
+			// combine with the previous chunks
+			const double delta = cmean - p.mean;
+			const size_t total = p.n + n;
+			p.mean += delta * n / total;
+			p.m2   += m2 + delta * delta * ((double) p.n * n / total);
+			p.n     = total;
+			const double y = s - p.carry, t = p.sum + y;	// Kahan summation
+			p.carry = (t - p.sum) - y;
+			p.sum   = t;
+			p.lo = min(p.lo, cmin);
+			p.hi = max(p.hi, cmax);
+		}
+		parts[thread] = p;
+		delete[] values;
+	}
+
+	partial r = parts[0];
+	for (size_t i = 1; i < parts.size(); i++){
+		const partial &p = parts[i];
+		if (p.n == 0) continue;
+		if (r.n == 0){
+			r = p;
+			continue;
+		}
+		const double delta = p.mean - r.mean;
+		const size_t total = r.n + p.n;
+		r.mean += delta * p.n / total;
+		r.m2   += p.m2 + delta * delta * ((double) r.n * p.n / total);
+		r.n     = total;
+		const double y = (p.sum - p.carry) - r.carry, t = r.sum + y;
+		r.carry = (t - r.sum) - y;
+		r.sum   = t;
+		r.outside += p.outside;
+		r.lo = min(r.lo, p.lo);
+		r.hi = max(r.hi, p.hi);
+	}
+	for (size_t i = 0; i < hists.size(); i++)
+		for (size_t b = 0; b < bins; b++) stats.histogram[b] += hists[i][b];
+
+	stats.count    = r.n;
+	stats.outside  = r.outside;
+	stats.sum      = r.sum;
+	stats.mean     = r.n ? r.mean : 0.;
+	stats.variance = r.n ? r.m2 / r.n : 0.;
+	stats.min      = r.n ? (double) r.lo : 0.;
+	stats.max      = r.n ? (double) r.hi : 0.;
+}
+
+/**
+ * name: mymatrix_view::statistics
+ * Computes count, minimum, maximum, sum, mean and variance in one pass.
+ * \param mask : only pixels where the mask is not 0 are used (optional)
+ */
+template <class Type>
+mymatrix_statistics mymatrix_view<Type>::statistics(mymatrix_view<char> *mask){
+	mymatrix_statistics stats;
+	compute_statistics(stats, mask);
+	return stats;
+}
+
+/**
+ * name: mymatrix_view::statistics
+ * Like statistics(), but also counts the values in a histogram with a fixed
+ * number of bins in [lo, hi).
+ */
+template <class Type>
+mymatrix_statistics mymatrix_view<Type>::statistics(size_t bins, double lo, double hi, mymatrix_view<char> *mask){
+	mymatrix_statistics stats;
+	if (bins == 0 or hi <= lo) throw mymatrix_exception(DIMENSION_FAILURE);
+	stats.histogram.assign(bins, 0);
+	stats.lo    = lo;
+	stats.width = (hi - lo) / bins;
+	compute_statistics(stats, mask);
+	return stats;
+}
+
+/**
+ * name: mymatrix_view::histogram
+ * Statistics with an exact histogram: one bin for each value between the
+ * minimum and the maximum. For integer types of up to 16 bit the histogram
+ * covers the whole range of the type and all is done in one pass, wider
+ * types need a pass for the range first. Floating point values are counted
+ * in bins of width 1. An empty histogram is returned if the range exceeds
+ * 2^24 bins.
+ */
+template <class Type>
+mymatrix_statistics mymatrix_view<Type>::histogram(mymatrix_view<char> *mask){
+	mymatrix_statistics stats;
+	double lo, hi;
+	if (numeric_limits<Type>::is_integer and sizeof(Type) <= 2){
+		lo = (double) numeric_limits<Type>::min();
+		hi = (double) numeric_limits<Type>::max();
+	} else {
+		stats = statistics(mask);
+		lo = floor(stats.min);
+		hi = floor(stats.max);
+	}
+	if (hi - lo >= (double) (1 << 24)) return stats;
+	stats.histogram.assign((size_t) (hi - lo) + 1, 0);
+	stats.lo    = lo;
+	stats.width = 1.;
+	compute_statistics(stats, mask);
+
+	// trim to [min, max]
+	if (stats.count){
+		const size_t first = (size_t) (floor(stats.min) - lo), last = (size_t) (floor(stats.max) - lo);
+		stats.histogram.erase(stats.histogram.begin() + last + 1, stats.histogram.end());
+		stats.histogram.erase(stats.histogram.begin(), stats.histogram.begin() + first);
+		stats.lo += first;
+	}
+	return stats;
+}
+
+/**
+ * name: mymatrix_view::gradients
+ *
+ * Fused gradient kernel: computes the derivatives along any subset of the
+ * axes and the magnitude of the gradient in one parallel pass over the
+ * view, without temporary matrices. Central differences are used in the
+ * interior and one-sided differences at the borders of the view (0 if an
+ * axis has only one pixel). The loop over x is vectorised by the compiler.
+ *
+ * All outputs are optional (NULL) and must have items() elements (dense,
+ * x fastest), they may have any arithmetic type.
+ *
+ * \param axes       : bit mask of the axes (1: x, 2: y, 4: z, 8: t) which
+ * 					   make up the magnitude
+ * \param magnitude  : output for the magnitude of the gradient
+ * \param gx,gy,gz,gt: outputs for the derivatives along x, y, z and t (they
+ * 					   are computed even if the axis is not in \a axes)
+ * \param use_pixdim : divide by the pixel dimensions (physical units)
+ */
+template <class Type> template <class Out>
+void mymatrix_view<Type>::gradients(unsigned int axes, Out *magnitude, Out *gx, Out *gy, Out *gz, Out *gt, bool use_pixdim){
+	Out *d_out[4] = {gx, gy, gz, gt};
+	bool need[4];
+	double h[4]; // 1/(pixel size)
+	for (int a = 0; a < 4; a++){
+		need[a] = (d_out[a] != 0) or (magnitude and (axes & (1u << a)));
+		h[a]    = (use_pixdim and pixdim(a) > 0.) ? 1. / pixdim(a) : 1.;
+	}
+	const long nx = dimensions[0], ny = dimensions[1], nz = dimensions[2];
+	const long rows = ny * nz * dimensions[3];
+	const long sx = step[0];
+
+	#pragma omp parallel for
+	for (long r = 0; r < rows; r++){
+		const long pos[4] = {0, r % ny, (r / ny) % nz, r / (ny * nz)};
+		const long out_row = r * nx;
+		const Type *c = base + index(0, pos[1], pos[2], pos[3]);
+
+		// rows before and after this row along y, z and t, and the weights
+		const Type *lo[4], *hi[4];
+		double w[4] = {0., 0., 0., 0.};
+		for (int a = 1; a < 4; a++){
+			const long n = dimensions[a];
+			if (not need[a] or n < 2) {lo[a] = hi[a] = c; continue;}
+			const long p0 = (pos[a] > 0)     ? pos[a] - 1 : pos[a];
+			const long p1 = (pos[a] < n - 1) ? pos[a] + 1 : pos[a];
+			lo[a] = c + (p0 - pos[a]) * step[a];
+			hi[a] = c + (p1 - pos[a]) * step[a];
+			w[a]  = h[a] / (double) (p1 - p0);
+		}
+
+		for (long i = 0; i < nx; i++){
+			double d[4];
+			if (nx < 2) d[0] = 0.;
+			else {
+				const long i0 = (i > 0) ? i - 1 : i, i1 = (i < nx - 1) ? i + 1 : i;
+				d[0] = ((double) c[i1 * sx] - (double) c[i0 * sx]) * h[0] / (double) (i1 - i0);
+			}
+			for (int a = 1; a < 4; a++) d[a] = ((double) hi[a][i * sx] - (double) lo[a][i * sx]) * w[a];
+
+			double sq = 0.;
+			for (int a = 0; a < 4; a++){
+				if (d_out[a]) d_out[a][out_row + i] = (Out) d[a];
+				if (axes & (1u << a)) sq += d[a] * d[a];
+			}
+			if (magnitude) magnitude[out_row + i] = (Out) sqrt(sq);
+		}
+	}
+}
+
+/**
+ * name: mymatrix_view::gradient_magnitude
+ * Replaces the pixels of the view by the magnitude of the gradient (see
+ * gradients()), integer values are rounded.
+ */
+template <class Type>
+void mymatrix_view<Type>::gradient_magnitude(unsigned int axes, bool use_pixdim){
+	vector<double> mag(items_val);
+	gradients(axes, &mag[0], (double*) 0, (double*) 0, (double*) 0, (double*) 0, use_pixdim);
+	const long nx = dimensions[0], rows = items_val / dimensions[0];
+	#pragma omp parallel for
+	for (long r = 0; r < rows; r++){
+		Type *out = row(r % dimensions[1], (r / dimensions[1]) % dimensions[2], r / (dimensions[1] * dimensions[2]));
+		for (long i = 0; i < nx; i++) out[i * step[0]] = mymatrix_cast<Type>(mag[r * nx + i]);
+	}
+}
+
+/** name: mymatrix_view::save_to_file
+ *
+ *	Writes the pixels of the view (x fastest) to a file, as
+ *	mymatrix::save_to_file(). After writing the file is closed.
+ *
+ *	\param ou : pointer to an (open) file
+ *	\return True or False if writing was successful
+ */
+template <class Type>
+bool mymatrix_view<Type>::save_to_file(FILE* ou){
+	if (!ou) {
+		cerr << "Warning: Abort because empty file pointer !" << endl;
+		return false; // if a NULL file pointer was given
+	}
+	size_t items_written = 0;
+	if (contiguous())
+		items_written = fwrite(base, sizeof(Type), items_val, ou);
+	else {
+		Type *buffer = new Type[dimensions[0]];
+		const long rows = items_val / dimensions[0];
+		for (long r = 0; r < rows; r++){
+			const Type *in = row(r % dimensions[1], (r / dimensions[1]) % dimensions[2], r / (dimensions[1] * dimensions[2]));
+			for (size_t i = 0; i < dimensions[0]; i++) buffer[i] = in[i * step[0]];
+			items_written += fwrite(buffer, sizeof(Type), dimensions[0], ou);
+		}
+		delete[] buffer;
+	}
+	fclose(ou);
+	if (items_written != items_val)
+		cerr << " Warning : Items written (" << items_written << ") not equals the items to be written: "<< items_val << endl;
+	return (items_written == items_val);
+}
+
+template <class Type>
+bool mymatrix_view<Type>::save_to_file(string fn){
+	return save_to_file(fopen(fn.c_str(), "wb"));
+}
+
+/** name: mymatrix::mymatrix
+ * Copies the pixels of a view into a new matrix with the geometry of the
+ * view.
+ */
+template <class Type>
+mymatrix<Type>::mymatrix(const mymatrix_view<Type> &source) :
+  my_regular_grid(source.extent(0), source.extent(1), source.extent(2), source.extent(3)),
+  matrix(0) {
+	init_mymatrix();
+	for (int i = 0; i < 4; i++) v_pixdim[i] = source.pixdim(i);
+	for (int i = 0; i < 4; i++) v_origin[i] = source.origin(i);
+	pixdim_set = true;
+	source.copy_to(matrix);
+}
+
+/** name: mymatrix::view
+ * A view of the whole matrix.
+ */
+template <class Type>
+mymatrix_view<Type> mymatrix<Type>::view(){
+	const long stride[4] = {1, (long) dimensions[0], (long) (dimensions[0] * dimensions[1]),
+							 (long) (dimensions[0] * dimensions[1] * dimensions[2])};
+	return mymatrix_view<Type>(matrix, dimensions, stride, v_pixdim, v_origin);
+}
+
+/** name: mymatrix::crop
+ * A view of a box of nx*ny*nz*nt pixels starting at (x0,y0,z0,t0), e.g. a
+ * region of interest.
+ */
+template <class Type>
+mymatrix_view<Type> mymatrix<Type>::crop(size_t x0, size_t y0, size_t z0, size_t t0,
+										 size_t nx, size_t ny, size_t nz, size_t nt){
+	return view().crop(x0, y0, z0, t0, nx, ny, nz, nt);
+}
+
+/** name: mymatrix::slice
+ * A view of the xy-plane at z in frame t.
+ */
+template <class Type>
+mymatrix_view<Type> mymatrix<Type>::slice(size_t z, size_t t){
+	return view().slice(z, t);
+}
+
+/** name: mymatrix::frame
+ * A view of the volume of time step t.
+ */
+template <class Type>
+mymatrix_view<Type> mymatrix<Type>::frame(size_t t){
+	return view().frame(t);
+}
+
+/** name: mymatrix::subsample
+ * A view of every sx-th pixel along x, every sy-th along y etc.
+ */
+template <class Type>
+mymatrix_view<Type> mymatrix<Type>::subsample(size_t sx, size_t sy, size_t sz, size_t st){
+	return view().subsample(sx, sy, sz, st);
+}
+
+#endif
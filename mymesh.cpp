@@ -106,6 +106,7 @@ SurfaceMesh::Deformation::~Deformation(){
 void SurfaceMesh::pclear(){
 	delete pSearch; pSearch = NULL;
 	p.clear();				// pts
+	point_hash.clear();
 }
 
 /** name: SurfaceMesh::clear
@@ -377,16 +378,61 @@ size_t SurfaceMesh::append_point_uniquely(const Point &point){
 	nb.clear(); // clear neighbour lists
 	delete pSearch; pSearch = NULL;
 
-	pair<map<Point,size_t>::iterator,bool> res;   // this pair is the result of an insert operation
+	sync_point_hash();
+	size_t idx = point_hash.insert_uniquely(point, points());
 
-	// now we call the insert function
-	res=point_rbtree.insert (pair<Point,size_t>(point, points()) );
-
-	if (res.second==true){ // element must be new
+	if (idx == points()){ // element must be new
 		p.push_back(point); // append it to the list of points
 	}
 
-	return res.first->second; // return the index of the element
+	return idx; // return the index of the element
+}
+
+/**
+ * name: SurfaceMesh::append_triangle_soup
+ * Appends a list of independent triangles, three consecutive points per
+ * triangle, as they are produced by marching cubes. Identical points within
+ * the soup are merged in parallel (see mylibs::PointHash::weld()), which is
+ * much faster than calling append_point_uniquely() for every vertex.
+ * \attention The points of the soup are not merged with points that are
+ * 			   already part of the mesh.
+ * @param soup	: 3*n points of n triangles
+ * @param remap	: if given, it receives the index of every point of the soup
+ * 				  in the list of points of the mesh
+ * @return The number of points appended.
+ */
+size_t SurfaceMesh::append_triangle_soup(const vector<Point> &soup, vector<size_t> *remap){
+	nb.clear(); // clear neighbour lists
+	delete pSearch; pSearch = NULL;
+
+	vector<Point>  unique;
+	vector<size_t> idx;
+	mylibs::PointHash::weld(soup, unique, idx, point_hash.tolerance());
+
+	const size_t offset = points();
+	p.insert(p.end(), unique.begin(), unique.end());
+	for (size_t i = 0; i < idx.size(); i++) idx[i] += offset;
+
+	for (size_t i = 0; i+2 < idx.size(); i += 3){
+		if (idx[i] == idx[i+1] or idx[i] == idx[i+2] or idx[i+1] == idx[i+2])
+			continue; // degenerated triangle
+		f.push_back(Face(idx[i], idx[i+1], idx[i+2]));
+	}
+
+	if (remap) remap->swap(idx);
+	return unique.size();
+}
+
+/**
+ * name: SurfaceMesh::sync_point_hash
+ * The list of points is public and may be changed from outside. Before the
+ * hash is used, all points that are missing in it are added.
+ */
+void SurfaceMesh::sync_point_hash(){
+	if (point_hash.size() > points()) point_hash.clear();
+	point_hash.reserve(points());
+	for (size_t i = point_hash.size(); i < points(); i++)
+		point_hash.insert(p[i], i);
 }
 
 
@@ -1472,14 +1518,21 @@ bool SurfaceMesh::save_mesh(const char *basename){
 }
 
 /** name: SurfaceMesh::index_of_point
- *  Determines the index to a point given.
+ *  Determines the index to a point given. A spatial hash is used for the
+ *  lookup, which is built on first use.
  * \param pt: a point
  * \return index of that point in the list
  */
 size_t SurfaceMesh::index_of_point(Point pt){
-	for (size_t i = 0; i < points(); i++){
-		if (p[i] == pt) return i;
-	}
+	sync_point_hash();
+	size_t idx = point_hash.find(pt);
+	if (idx != mylibs::PointHash::npos and p[idx] == pt) return idx;
+
+	// points may have been moved since the hash was built
+	point_hash.clear();
+	sync_point_hash();
+	idx = point_hash.find(pt);
+	if (idx != mylibs::PointHash::npos) return idx;
 	throw myexception(EXCEPTION_ID+"Error : Point was not found");
 }
 
@@ -47,6 +47,7 @@
 #include "maps.h"
 #include "myline.hpp"
 #include "NeighbourSearch.hpp"
+#include "PointHash.hpp"
 #include "Facet.hpp"
 #include "cmdline.hpp"
 #include "BoundingBox.hpp"
@@ -182,7 +183,7 @@ class SurfaceMesh{
 		size_t nr_attributes;
 
 		map<uint,int> 						pointmap;	//!< cf. append_point(Point, idx) red black tree for unified appending
-		map<Point,size_t, PointCompare> point_rbtree;	//!< red black tree for storing Points with an (integer) attribute
+		mylibs::PointHash				  point_hash;	//!< spatial hash for finding identical points
 		myList<Curve> 						 borders;	//!< list of border segments
 		myList<int> 						 regions;	//!< collects all face attributes
 		vector<neighbours> 				 tetlist;	//!< lists all tets each point is part of
@@ -268,6 +269,7 @@ class SurfaceMesh{
 //		int  append_point(Point &point, map<T> &);
 		size_t append_point_uniquely(const Point &point);
 		void append_point(const Point &point);
+		size_t append_triangle_soup(const vector<Point> &soup, vector<size_t> *remap = NULL);
 
 		Point * points2array() const;
 
@@ -382,8 +384,8 @@ class SurfaceMesh{
 		void fprintf_barycentric_coordinates(FILE *f, vector<double> D) const;
 
 		void pclear();
-		void clear_rb(){ // clear temporarily used red black trees
-			point_rbtree.clear();
+		void clear_rb(){ // clear temporarily used red black trees and hashes
+			point_hash.clear();
 			pointmap.clear();
 		}
 
@@ -401,6 +403,7 @@ class SurfaceMesh{
 		void compute_tetlist();
 		void compute_face_neighbour_list();
 		void compute_neighbour_list();
+		void sync_point_hash();
 
 };
 